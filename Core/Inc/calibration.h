@@ -0,0 +1,46 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <stdint.h>
+#include "zone_table.h"
+
+// Engineering units held in Zone_t.values[] and used by profile rules:
+//   humidity 0.1 %RH, temperature 0.1 degC, light 10 lux;
+//   channels on CAL_CURVE_RAW keep the 10-bit count
+#define CAL_RH(pct)       ((pct) * 10)
+#define CAL_DEG_C(c)      ((c) * 10)
+#define CAL_LUX(lux)      ((lux) / 10)
+
+// One table entry per 10-bit sample (Zone_t.sensors[] scale)
+#define CAL_LUT_SIZE      1024
+
+// Sensor curves a zone channel can be calibrated with
+typedef enum {
+    CAL_CURVE_DEFAULT = 0,      // Curve of the channel's fixed meaning (below)
+    CAL_CURVE_RAW,              // No conversion
+    CAL_CURVE_HIH4000,          // Humidity: HIH-4000 on 5 V, linear
+    CAL_CURVE_NTC10K,           // Temperature: 10k B3950 NTC high side, 10k to GND
+    CAL_CURVE_LDR,              // Light: GL5528 LDR high side, 1k to GND
+    CAL_CURVE_COUNT
+} CalCurve_t;
+
+// Public API
+void calibration_init(void);
+
+// Resolves each channel's curve and builds any table not built yet, then
+// converts the zone's current snapshot. Run when a profile is assigned;
+// until then values[] mirror the raw counts.
+void calibration_prepare(Zone_t* zone);
+
+// Per-zone override: curve for one channel plus a trim added to its result,
+// applied to the current snapshot. Returns 0 for a bad channel or curve.
+// node_controller_set_calibration() also saves it.
+uint8_t calibration_set(Zone_t* zone, uint8_t channel, uint8_t curve, int16_t offset);
+
+// Hot path: one table read per sample
+static inline int16_t calibration_apply(const Zone_t* zone, uint8_t channel, uint16_t raw) {
+    const int16_t* lut = zone->cal_lut[channel];
+    return (lut != 0) ? (int16_t)(lut[raw & (CAL_LUT_SIZE - 1)] + zone->cal_offset[channel]) : (int16_t)raw;
+}
+
+#endif
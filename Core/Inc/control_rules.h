@@ -0,0 +1,53 @@
+#ifndef CONTROL_RULES_H
+#define CONTROL_RULES_H
+
+#include <stdint.h>
+#include "zone_table.h"
+
+// Comparators. ON_* rules switch their actuator on past the threshold and
+// off once the reading is back beyond the hysteresis band; INHIBIT_* rules
+// are interlocks that hold their actuator off while the condition lasts.
+// PI_* rules modulate a PWM output around the threshold as setpoint, with
+// band as the proportional band (error giving full duty); on a node
+// without PWM on that output they fall back to the matching ON_* rule.
+typedef enum {
+    RULE_ON_BELOW = 0,          // on: v < threshold, off: v > threshold + band
+    RULE_ON_ABOVE,              // on: v > threshold, off: v < threshold - band
+    RULE_INHIBIT_BELOW,         // forced off while v < threshold
+    RULE_INHIBIT_ABOVE,         // forced off while v > threshold
+    RULE_PI_BELOW,              // duty rises while v < threshold (humidifier, light)
+    RULE_PI_ABOVE               // duty rises while v > threshold (fan)
+} RuleCmp_t;
+
+// One row of a profile's rule table (8 bytes, no pointers - storable as is)
+typedef struct {
+    uint8_t  channel;           // Sensor channel, ZONE_CH_* or any extra channel
+    uint8_t  cmp;               // RuleCmp_t
+    int16_t  threshold;         // Engineering units, as Zone_t.values[] (CAL_RH() etc.)
+    uint16_t band;              // Hysteresis / proportional band, same units; ignored by INHIBIT_* rules
+    uint8_t  actuator;          // ACT_* bit(s) driven; PI_* rules drive exactly one
+    uint8_t  ti_sec;            // PI_* integral time, 0 = proportional only
+} ControlRule_t;
+
+// PI loops: integration step is capped so a long data gap cannot kick the output
+#define RULE_PI_MAX_DT_MS  5000
+
+// Hysteresis lanes across all zones (ZONE_MAX x PROFILE_MAX_RULES), even.
+// Lane indices are 16-bit: past 255 lanes once ZONE_MAX exceeds 42.
+#define RULE_LANES_MAX     (ZONE_MAX * 6)
+
+_Static_assert(RULE_LANES_MAX <= UINT16_MAX, "lane indices (lane_count, lane_first) are uint16_t");
+
+// Public API
+// dt_ms is the time since the previous snapshot the rules ran on. PI rows
+// update zone->duty[] and zone->pwm_active; the rest only mask/value.
+void control_rules_eval(const ControlRule_t* rules, uint8_t count, Zone_t* zone,
+                        uint32_t dt_ms, uint8_t* mask, uint8_t* value);
+
+// Compares every zone's hysteresis rows in one SIMD pass; run once per
+// control cycle before control_rules_eval(). Invalidate whenever zones
+// are removed or a zone's profile, channels or PWM outputs change.
+void control_rules_batch(void);
+void control_rules_invalidate(void);
+
+#endif
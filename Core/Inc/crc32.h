@@ -0,0 +1,9 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stdint.h>
+
+// CRC-32 (IEEE 802.3, reflected poly 0xEDB88320), init and final XOR 0xFFFFFFFF
+uint32_t crc32_compute(const uint8_t* data, uint32_t len);
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef CRC8_H
+#define CRC8_H
+
+#include <stdint.h>
+
+// CRC-8, polynomial x^8 + x^2 + x + 1 (0x07), init 0 - the SMBus PEC
+uint8_t crc8_update(uint8_t crc, const uint8_t* data, uint16_t len);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef EEPROM_EMUL_H
+#define EEPROM_EMUL_H
+
+#include <stdint.h>
+#include "main.h"
+
+// Two equal flash sectors (excluded from FLASH in the linker script); one
+// holds the live journal, the other is kept erased for the next transfer
+#define EE_PAGE0_SECTOR     FLASH_SECTOR_5
+#define EE_PAGE0_ADDR       0x08020000UL
+#define EE_PAGE1_SECTOR     FLASH_SECTOR_6
+#define EE_PAGE1_ADDR       0x08040000UL
+#define EE_PAGE_SIZE        (128UL * 1024)
+
+// 8-bit variable ids, 16-bit values
+#define EE_VAR_COUNT        255
+
+typedef struct {
+    uint32_t restore_us;        // Boot scan of the live page
+    uint16_t entries;           // Entries in the live page
+    uint16_t free_slots;        // Writes left before the next page transfer
+    uint16_t bad_entries;       // Torn or corrupt entries skipped at boot
+    uint16_t transfers;         // Page transfers (one sector erase each) since boot
+    uint16_t write_errors;
+} EeStats_t;
+
+// Public API
+// Recovers from a transfer cut short by a reset, then loads the newest
+// value of every variable into RAM. Returns 0 if flash could not be
+// brought into a usable state (writes are then refused).
+uint8_t ee_init(void);
+
+// Returns 0 if the variable was never written
+uint8_t ee_read(uint8_t var, uint16_t* value);
+
+// Appends only when the value changes. A full page is transferred to the
+// other one first: blocks for the sector erase (~1-2 s), once per
+// ~32000 writes. Returns 0 on a flash error (the RAM value still applies).
+uint8_t ee_write(uint8_t var, uint16_t value);
+
+const EeStats_t* ee_get_stats(void);
+
+// The page kept erased for the next transfer, erased now if it is not,
+// as scratch space until then (profile_store.c). Returns its address, or
+// 0 without a live page. A transfer erases it again before use.
+uint32_t ee_borrow_spare(void);
+
+#endif
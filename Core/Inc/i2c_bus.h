@@ -0,0 +1,133 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <stdint.h>
+#include "main.h"
+
+// Buses (I2C1..I2C3), each with its own queue and interrupt chain
+#define I2C_BUS_COUNT            3
+#define I2C_BUS_1                0
+#define I2C_BUS_2                1
+#define I2C_BUS_3                2
+#define I2C_BUS_NONE             0xFF
+
+// Queue sizing per bus (must be a power of two)
+#define I2C_BUS_QUEUE_LEN        32
+#define I2C_BUS_INLINE_BYTES     28   // Holds the largest field-node frame (8 channels + PEC)
+
+// Bus speeds: Fast Mode by default, Standard Mode for devices marked slow
+#define I2C_BUS_SPEED_FAST_HZ    400000
+#define I2C_BUS_SPEED_SLOW_HZ    100000
+
+// Per-transaction limits
+#define I2C_BUS_XFER_TIMEOUT_MS  25
+
+// Longest wait for BUSY to clear before a start: the previous transfer's
+// STOP and bus-free time (~10 us at 100 kHz). Past it the transfer stays
+// queued; a start never spins on BUSY in the ISR or with IRQs masked.
+#define I2C_BUS_START_WAIT_US    20
+#define I2C_BUS_DEFAULT_ATTEMPTS 3
+
+typedef enum {
+    I2C_XFER_WRITE = 0,
+    I2C_XFER_READ,
+    I2C_XFER_MEM_WRITE,
+    I2C_XFER_MEM_READ
+} I2cXferType_t;
+
+typedef enum {
+    I2C_XFER_QUEUED = 0,
+    I2C_XFER_OK,
+    I2C_XFER_NACK,
+    I2C_XFER_BUS_ERROR,
+    I2C_XFER_TIMEOUT
+} I2cXferStatus_t;
+
+// Bus recovery: SCL pulses sent at most, and the bit-bang half period
+#define I2C_BUS_RECOVERY_PULSES  9
+#define I2C_BUS_RECOVERY_HALF_US 5
+
+// Pins the recovery routine takes over as open-drain GPIO
+typedef struct {
+    GPIO_TypeDef* scl_port;
+    uint16_t      scl_pin;
+    GPIO_TypeDef* sda_port;
+    uint16_t      sda_pin;
+} I2cBusPins_t;
+
+typedef struct I2cXfer I2cXfer_t;
+
+// Completion callback - runs from i2c_bus_process() (thread context, never ISR)
+typedef void (*I2cXferCallback_t)(I2cXfer_t* xfer);
+
+struct I2cXfer {
+    uint8_t bus;               // I2C_BUS_n the transfer runs on
+    uint8_t addr;              // 8-bit (shifted) slave address, as HAL expects
+    uint8_t type;              // I2cXferType_t
+    uint8_t mem_addr;          // Register/control byte for MEM_* transfers
+    uint8_t attempts_left;
+    volatile uint8_t status;   // I2cXferStatus_t, written by ISR
+    uint8_t nacks;             // Failed attempts, including retried ones
+    uint8_t bus_errors;        // BERR/ARLO/timeout attempts (each forces a recovery)
+    uint8_t arb_lost;          // ARLO attempts, subset of bus_errors
+    uint8_t timeouts;          // Watchdog expiries, subset of bus_errors
+    uint16_t len;
+    uint8_t* buf;              // Points to data[] unless caller supplied a buffer
+    uint8_t data[I2C_BUS_INLINE_BYTES];
+    uint32_t submit_tick;
+    uint32_t start_tick;
+    uint32_t done_tick;
+    uint32_t start_cycles;     // DWT->CYCCNT when the current attempt started
+    uint32_t bus_cycles;       // Cycles on the wire, summed over attempts
+    I2cXferCallback_t callback;
+    void* ctx;
+};
+
+typedef struct {
+    uint32_t submitted;
+    uint32_t completed;
+    uint32_t failed;
+    uint32_t dropped;          // Queue full at submit time
+    uint32_t timeouts;
+    uint32_t wire_bytes;       // Address + register + data bytes moved (bus time ~ 9 bits each)
+    uint32_t max_latency_ms;   // Worst submit->complete time seen
+    uint32_t speed_switches;   // Peripheral reprogrammed for a device's speed
+    uint32_t busy_deferrals;   // Starts left queued because BUSY stayed set
+    uint32_t recoveries;       // Recovery sequences run
+    uint32_t recovery_failures;// SDA still low after the pulses
+    uint32_t last_recovery_us;
+    uint32_t max_recovery_us;
+    uint8_t  max_depth;        // Deepest queue seen
+} I2cBusStats_t;
+
+// Public API
+void i2c_bus_init(uint8_t bus, I2C_HandleTypeDef* hi2c, const I2cBusPins_t* pins);
+void i2c_bus_process(void);     // Services every initialised bus
+
+// Submit helpers return 0 if the queue is full. Data for writes is copied
+// inline when it fits, otherwise the caller's buffer must stay valid until
+// the callback runs. Reads land in xfer->buf (inline unless buf is given).
+uint8_t i2c_bus_submit_write(uint8_t bus, uint8_t addr, const uint8_t* data, uint16_t len,
+                             I2cXferCallback_t cb, void* ctx);
+uint8_t i2c_bus_submit_read(uint8_t bus, uint8_t addr, uint8_t* buf, uint16_t len,
+                            I2cXferCallback_t cb, void* ctx);
+uint8_t i2c_bus_submit_mem_write(uint8_t bus, uint8_t addr, uint8_t mem_addr, const uint8_t* data,
+                                 uint16_t len, I2cXferCallback_t cb, void* ctx);
+uint8_t i2c_bus_submit_mem_read(uint8_t bus, uint8_t addr, uint8_t mem_addr, uint8_t* buf,
+                                uint16_t len, I2cXferCallback_t cb, void* ctx);
+
+// Address-only ACK check (zero-length write, single attempt)
+uint8_t i2c_bus_submit_probe(uint8_t bus, uint8_t addr, I2cXferCallback_t cb, void* ctx);
+
+// Per-device speed: transfers to a slow device run at I2C_BUS_SPEED_SLOW_HZ,
+// the peripheral is reprogrammed between transfers when the speed changes
+void i2c_bus_set_device_slow(uint8_t bus, uint8_t addr, uint8_t slow);
+uint8_t i2c_bus_device_is_slow(uint8_t bus, uint8_t addr);
+
+uint8_t i2c_bus_is_ready(uint8_t bus);     // Initialised with a handle
+uint8_t i2c_bus_is_idle(uint8_t bus);
+uint8_t i2c_bus_pending(uint8_t bus);
+uint32_t i2c_bus_clock_hz(uint8_t bus);
+const I2cBusStats_t* i2c_bus_get_stats(uint8_t bus);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef IRRIGATION_SCHED_H
+#define IRRIGATION_SCHED_H
+
+#include <stdint.h>
+#include "zone_table.h"
+
+// Public API
+// One pending irrigation event (start or stop) per zone, keyed by address.
+// Ticks are HAL_GetTick() values; ordering is wrap-safe.
+void irrigation_sched_init(void);
+void irrigation_sched_set(uint8_t addr, uint32_t due_tick);     // Insert or move, O(log N)
+void irrigation_sched_cancel(uint8_t addr);                    // Event and queued start, O(log N)
+uint8_t irrigation_sched_pop_due(uint32_t now);                // Address, or ZONE_NONE if nothing is due
+uint8_t irrigation_sched_count(void);
+
+// Starts waiting for a pump slot: lowest priority value first, then the
+// longest waiting. due_tick comes back with the address so the caller can
+// report the delay.
+void irrigation_sched_enqueue(uint8_t addr, uint8_t priority, uint32_t due_tick);
+uint8_t irrigation_sched_dequeue(uint32_t* due_tick);          // ZONE_NONE if empty
+uint8_t irrigation_sched_waiting(void);
+
+#endif
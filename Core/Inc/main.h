@@ -59,6 +59,23 @@ void Error_Handler(void);
 /* Private defines -----------------------------------------------------------*/
 
 /* USER CODE BEGIN Private defines */
+// I2C pins, bit-banged as open-drain GPIO during bus recovery
+#define I2C1_SCL_GPIO_Port GPIOB
+#define I2C1_SCL_Pin GPIO_PIN_6
+#define I2C1_SDA_GPIO_Port GPIOB
+#define I2C1_SDA_Pin GPIO_PIN_7
+#define I2C2_SCL_GPIO_Port GPIOB
+#define I2C2_SCL_Pin GPIO_PIN_10
+#define I2C2_SDA_GPIO_Port GPIOB
+#define I2C2_SDA_Pin GPIO_PIN_3
+#define I2C3_SCL_GPIO_Port GPIOA
+#define I2C3_SCL_Pin GPIO_PIN_8
+#define I2C3_SDA_GPIO_Port GPIOB
+#define I2C3_SDA_Pin GPIO_PIN_4
+
+// Bus the SSD1306 is wired to (I2C_BUS_1..I2C_BUS_3). Zones are found on
+// every bus, so moving the display only needs this and the wiring.
+#define OLED_I2C_BUS I2C_BUS_1
 
 /* USER CODE END Private defines */
 
@@ -6,9 +6,10 @@
 // Public API
 void menu_init(void);
 void menu_process_key(uint8_t key);
-void menu_display(uint16_t adc1[3], uint16_t adc2[3]);
+void menu_display(void);
 uint8_t menu_is_manual_mode(void);
 uint8_t menu_get_last_manual_key(void);  // For main.c to handle manual commands
+uint8_t menu_get_manual_node(void);      // Address of the zone the manual keys act on, 0 if none
 void menu_clear_manual_key(void);
 
 #endif
@@ -3,20 +3,65 @@
 
 #include <stdint.h>
 #include "main.h"
+#include "zone_table.h"
 
-// Node state tracking
+// Full actuator frame resent this often even when nothing changed
+// (re-syncs a node that rebooted and dropped its relays)
+#define ACTUATOR_REFRESH_MS  10000
+
+// Sensor data age limits. Past SENSOR_MAX_AGE_MS the sensor rules stop and
+// outputs hold their last state; past SENSOR_FAILSAFE_AGE_MS the outputs
+// they drive are switched off. Scheduled irrigation runs either way.
+#define SENSOR_MAX_AGE_MS       5000
+#define SENSOR_FAILSAFE_AGE_MS  60000
+
+// An irrigation start that comes due before the zone's descriptor is read
+// is pushed back by this much
+#define IRRIGATION_RETRY_MS     1000
+
+// Pump starts are spaced at least this far apart facility-wide, so
+// pressure and supply current step up one pump at a time
+#define IRRIGATION_STAGGER_MS   2000
+
+typedef struct {
+    uint32_t commands_sent;         // Actuator frames put on the bus
+    uint32_t commands_suppressed;   // Decisions already matching confirmed state
+    uint32_t refreshes;             // Periodic re-sync frames (subset of sent)
+    uint32_t stale_cycles;          // Zone control cycles run without fresh sensor data
+    uint32_t timing_holds;          // Decisions held back by a minimum on/off time
+    uint32_t max_on_trips;          // Outputs switched off for exceeding their maximum on time
+    uint32_t concurrency_holds;     // Switch-ons held back by a facility-wide cap
+    uint32_t irrigation_deferred;   // Irrigation starts that waited for a pump slot
+    uint32_t max_irrigation_delay_ms;
+} ControlStats_t;
+
+// Limits for one actuator type. Times are seconds, 0 = no limit; failsafe
+// switch-offs and manual commands are not limited. max_running caps how
+// many zones may have the output on at once (0 = no cap): pump starts
+// queue for a slot by profile priority, other outputs are held off.
 typedef struct {
-    uint8_t assigned_profile;
-    uint32_t last_irrigation_time;
-    uint8_t irrigation_active;
-    uint32_t irrigation_start_time;
-} NodeState_t;
+    uint16_t min_on_sec;
+    uint16_t min_off_sec;
+    uint16_t max_on_sec;
+    uint8_t  max_running;
+} ActuatorLimits_t;
 
 // Public API
-void node_controller_init(I2C_HandleTypeDef* hi2c);
-void node_controller_update(uint16_t adc_node1[3], uint16_t adc_node2[3]);
-void node_controller_send_manual_command(uint8_t node, uint8_t command);
-NodeState_t* node_controller_get_state(uint8_t node);
-void node_controller_assign_profile(uint8_t node, uint8_t profile_index);
-void node_controller_read_sensors(uint8_t node, uint16_t* result);
+void node_controller_init(void);
+void node_controller_update(void);
+void node_controller_process(void);
+void node_controller_send_manual_command(uint8_t addr, uint8_t command);
+void node_controller_assign_profile(uint8_t addr, uint8_t profile_index);
+// Sensor curve (CalCurve_t) and trim of one zone channel, applied and
+// saved for the next boot. Returns 0 for an unknown zone, a bad channel or
+// curve, or when the override cannot be saved (PERSIST_CAL_SLOTS in use);
+// nothing changes then.
+uint8_t node_controller_set_calibration(uint8_t addr, uint8_t channel, uint8_t curve, int16_t offset);
+void node_controller_zone_added(uint8_t addr);     // After zone_table_add(), restores saved state
+void node_controller_zone_removed(uint8_t addr);   // Before zone_table_remove()
+void node_controller_poll_sensors(void);
+const ControlStats_t* node_controller_get_stats(void);
+uint8_t node_controller_restored_zones(void);
+// No zone has its pump on (flash erases stall the CPU for seconds)
+uint8_t node_controller_is_idle(void);
 #endif
@@ -0,0 +1,66 @@
+#ifndef NODE_PROTOCOL_H
+#define NODE_PROTOCOL_H
+
+// Wire protocol shared with the ATmega32 field nodes (see adcslave.c / slave2.c)
+
+// Single-byte actuator commands
+#define CMD_TOGGLE_PUMP    0x01   // 0x01-0x04: toggle, manual mode
+#define CMD_TOGGLE_LIGHT1  0x04
+#define CMD_PUMP_OFF       0x10   // 0x10-0x17: explicit OFF/ON pairs
+#define CMD_PUMP_ON        0x11
+#define CMD_HUMID_OFF      0x12
+#define CMD_HUMID_ON       0x13
+#define CMD_FAN_OFF        0x14
+#define CMD_FAN_ON         0x15
+#define CMD_LIGHT1_OFF     0x16
+#define CMD_LIGHT1_ON      0x17
+#define CMD_SET_ACTUATORS  0x20   // [cmd, mask, value] - one frame per zone per cycle
+#define CMD_SET_DUTY       0x21   // [cmd, actuator bit, duty] - protocol 3, PWM outputs only
+#define CMD_LATCH_SAMPLES  0x30   // Freeze current averages into the sensor registers
+
+// General call: every node on a bus receives it in the same transaction
+#define I2C_GENERAL_CALL_ADDR  0x00
+
+// Register map: write 0x80+reg, repeated start, read from reg onwards.
+// The fixed status block comes first and one word per sensor channel
+// after it, so the frame is only as long as the node is wide. Every read
+// (register map or descriptor) ends with an SMBus PEC byte, CRC-8 over
+// addr+W, pointer, addr+R and the data bytes.
+#define REG_POINTER_BASE   0x80
+#define REG_ACTUATORS      0x00   // ACT_* bits as driven on the node's pins
+#define REG_FW_VERSION     0x01
+#define REG_SAMPLE_SEQ     0x02   // Bumped each time the node publishes new samples
+#define REG_UPTIME         0x03   // Seconds since node reset, uint32 big-endian
+#define REG_RX_ERRORS      0x07   // Node-side TWI receive errors (saturating)
+#define REG_CMD_ERRORS     0x08   // Unknown commands seen by the node (saturating)
+#define REG_SENSORS        0x09   // channels x uint16 big-endian (humidity, temp, light, ...)
+#define REG_MAP_LEN(ch)    (REG_SENSORS + 2 * (ch))
+
+// Legacy nodes (the original firmware, no descriptor) ignore the pointer
+// byte and answer every read with three 10-bit sensor words, big-endian:
+// no status block, no PEC
+#define NODE_LEGACY_FRAME_LEN   6
+#define NODE_LEGACY_CHANNELS    3
+#define NODE_LEGACY_ACTUATORS   4
+#define NODE_LEGACY_RESOLUTION  10
+
+// Capability descriptor: write 0xC0, repeated start, DESC_LEN bytes + PEC.
+// A legacy node sends sensor data instead, whose first byte (a 10-bit
+// sample's high byte) can never be DESC_MAGIC.
+#define DESC_POINTER       0xC0
+#define DESC_MAGIC         0xD5
+#define DESC_PROTOCOL      0x01
+#define DESC_CHANNELS      0x02
+#define DESC_ACTUATORS     0x03   // Outputs on PD2 upwards, ACT_* bit order
+#define DESC_RESOLUTION    0x04   // ADC bits per sample
+#define DESC_LEN           0x05
+
+#define NODE_PROTOCOL_LEGACY 1
+#define NODE_PROTOCOL_V2   2
+#define NODE_PROTOCOL_V3   3      // Adds CMD_SET_DUTY, register map as protocol 2
+
+// Protocol 3 nodes run Timer1 PWM on Fan (OC1B/PD4) and Light 1 (OC1A/PD5).
+// Duty 0 and 255 drive the pin as a plain output, so relays still work.
+#define NODE_PWM_OUTPUTS   ((1 << 2) | (1 << 3))
+
+#endif
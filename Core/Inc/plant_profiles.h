@@ -2,20 +2,39 @@
 #define PLANT_PROFILES_H
 
 #include <stdint.h>
+#include "control_rules.h"
 
+#define PROFILE_MAX_RULES 6
+#define PROFILE_MAX       16        // Compiled defaults plus profiles added at runtime
+
+#if ZONE_MAX * PROFILE_MAX_RULES > RULE_LANES_MAX
+#error "RULE_LANES_MAX must cover PROFILE_MAX_RULES rows for every zone"
+#endif
+
+// Fixed 70-byte layout with no padding: stored in flash as is (profile_store.c)
 typedef struct {
     char name[17];
-    uint16_t humidity_threshold;
-    uint16_t temp_threshold;
-    uint16_t light_threshold;
-    uint8_t irrigation_interval_sec;
-    uint8_t irrigation_duration_sec;
+    uint8_t rule_count;
+    ControlRule_t rules[PROFILE_MAX_RULES];     // Evaluated in order, see control_rules.c
+    uint8_t irrigation_interval_sec;            // 0-255 s: the byte is part of the stored layout
+    uint8_t irrigation_duration_sec;            // 0-255 s
+    uint8_t irrigation_priority;                // Pump queue order when slots are short, 0 first
+    uint8_t reserved;
 } PlantProfile_t;
 
+_Static_assert(sizeof(PlantProfile_t) == 70, "PlantProfile_t is a flash record; bump PROFILE_STORE_VERSION");
+
 // Public API
 void plant_profiles_init(void);
 uint8_t get_num_profiles(void);
 PlantProfile_t* get_profile(uint8_t index);
 const char* get_profile_name(uint8_t index);
 
+// Runtime edit: replaces profile 'index', or adds one when index equals
+// get_num_profiles(). Written to flash before it returns, unless the log is
+// full: then it is stored by the next compaction (profile_store_process()).
+// Returns 0 if the profile is invalid or the flash write failed (the RAM
+// copy still applies).
+uint8_t plant_profiles_update(uint8_t index, const PlantProfile_t* profile);
+
 #endif
@@ -0,0 +1,51 @@
+#ifndef PROFILE_STORE_H
+#define PROFILE_STORE_H
+
+#include <stdint.h>
+#include "main.h"
+#include "plant_profiles.h"
+
+// Reserved flash sector (excluded from FLASH in the linker script)
+#define PROFILE_STORE_SECTOR    FLASH_SECTOR_7
+#define PROFILE_STORE_ADDR      0x08060000UL
+#define PROFILE_STORE_SIZE      (128UL * 1024)
+
+// Worst case for one 128K sector erase (RM0383, x32 parallelism) and for
+// a compaction, which erases the sector and at most one EEPROM page
+#define PROFILE_STORE_ERASE_MAX_MS      4000
+#define PROFILE_STORE_COMPACT_MAX_MS    (2 * PROFILE_STORE_ERASE_MAX_MS)
+
+// Record layout version: bump whenever PlantProfile_t changes, older
+// records are then ignored and the compiled defaults apply
+#define PROFILE_STORE_VERSION   1
+#define PROFILE_STORE_MAGIC     0x5052      // "PR"
+
+typedef struct {
+    uint32_t records;           // Valid records found at boot
+    uint32_t bad_records;       // CRC or version mismatch
+    uint16_t free_slots;        // Appends left before the next compaction
+    uint16_t compactions;       // Sector erases since boot
+    uint16_t compaction_errors; // Compactions stopped by a flash error or no EEPROM page
+    uint8_t  compaction_due;    // Log full, the newest edits are in RAM only
+    uint8_t  restored;          // Loaded from a compaction snapshot cut short by a reset
+} ProfileStoreStats_t;
+
+// Public API
+// Applies the newest valid record of every index onto table[] (pre-filled
+// with the defaults). *count grows to cover stored indices past it.
+// Call before ee_init(): it may find a compaction snapshot on an EEPROM page.
+void profile_store_load(PlantProfile_t* table, uint8_t max, uint8_t* count);
+
+// Appends table[index]. When the sector is full the compaction is left
+// due for profile_store_process() instead. Returns 0 on a flash error.
+uint8_t profile_store_save(uint8_t index, const PlantProfile_t* table, uint8_t count);
+
+// Runs a due compaction when idle is set: the whole table is written to a
+// snapshot, the sector erased and the table written back. Blocks with
+// interrupts held off while flash is erased (two erases: 2-4 s, PROFILE_STORE_COMPACT_MAX_MS at worst),
+// so pass idle only with no pump running and the I2C buses quiet.
+void profile_store_process(uint8_t idle);
+
+const ProfileStoreStats_t* profile_store_get_stats(void);
+
+#endif
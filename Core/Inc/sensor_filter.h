@@ -0,0 +1,25 @@
+#ifndef SENSOR_FILTER_H
+#define SENSOR_FILTER_H
+
+#include <stdint.h>
+#include "zone_table.h"
+
+// Median over ZONE_FILTER_TAPS samples, then an EMA with alpha = 1 / 2^SHIFT.
+// Both run on the 10-bit counts; the EMA keeps FILTER_EMA_FRAC_BITS of
+// fraction so small steps are not lost to truncation.
+#define FILTER_EMA_SHIFT       2
+#define FILTER_EMA_FRAC_BITS   5
+
+// Public API
+// Filters every zone with a new snapshot (ZONE_FLAG_UNFILTERED), all of
+// its channels, and refreshes Zone_t.values[] through the zone's
+// calibration. Run once per control cycle before the rules.
+void sensor_filter_run(void);
+
+// Filtered 10-bit count of one channel; the raw sample until the first pass
+static inline uint16_t sensor_filter_output(const Zone_t* zone, uint8_t channel) {
+    if (!(zone->flags & ZONE_FLAG_FILTERED)) return zone->sensors[channel];
+    return (zone->filter_ema[channel] + (1 << (FILTER_EMA_FRAC_BITS - 1))) >> FILTER_EMA_FRAC_BITS;
+}
+
+#endif
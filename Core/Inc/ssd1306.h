@@ -14,7 +14,7 @@
 #include "main.h"
 
 // Public functions
-void ssd1306_init(void);
+void ssd1306_init(uint8_t bus);     // I2C_BUS_n the display is wired to
 void ssd1306_clear(void);
 void ssd1306_update(void);
 void ssd1306_print(uint8_t x, uint8_t y, const char *str);
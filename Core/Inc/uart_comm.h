@@ -1,4 +1,3 @@
-
 #ifndef UART_COMM_H
 #define UART_COMM_H
 
@@ -6,9 +5,14 @@
 #include "main.h"
 
 void uart_comm_init(UART_HandleTypeDef* huart);
-void uart_comm_send_status(uint16_t adc1[3], uint16_t adc2[3]);
 
-//Call this after every send_command() to track actuator states
-void uart_comm_update_actuator_state(uint8_t node, uint8_t command);
+// Starts a telemetry sweep: one JSON line per zone, sent by uart_comm_process()
+void uart_comm_send_status(void);
+
+// Sends telemetry lines and answers PROFILE command lines (see uart_comm.c)
+void uart_comm_process(void);
+
+// Blocking, boot only: reports how long zone discovery took
+void uart_comm_send_discovery_report(void);
 
 #endif
@@ -0,0 +1,23 @@
+#ifndef ZONE_DISCOVERY_H
+#define ZONE_DISCOVERY_H
+
+#include <stdint.h>
+
+// Share of bus time the background probe may use, in 1/1000 (10 = 1%)
+#define DISCOVERY_BUS_BUDGET_PERMILLE  10
+
+typedef struct {
+    uint32_t boot_scan_ms;          // Time the startup scan took
+    uint8_t  boot_zones_found;
+    uint16_t zones_added;           // Hot-plug events since boot
+    uint16_t zones_removed;
+    uint32_t probes_sent;
+    uint16_t probe_interval_ms;     // Current background probe spacing
+} DiscoveryStats_t;
+
+// Public API
+void zone_discovery_boot_scan(void);
+void zone_discovery_process(void);
+const DiscoveryStats_t* zone_discovery_get_stats(void);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef ZONE_LINK_H
+#define ZONE_LINK_H
+
+#include <stdint.h>
+#include "zone_table.h"
+#include "i2c_bus.h"
+
+// Error-rate window: the fallback decision is made every N attempts
+#define LINK_WINDOW_ATTEMPTS       32
+
+// Drop a zone to Standard Mode when NACK + bus-error attempts in a window
+// exceed this share (1/1000), return to Fast Mode after enough clean windows
+#define LINK_FALLBACK_PERMILLE     100
+#define LINK_CLEAN_PERMILLE        0
+#define LINK_RESTORE_WINDOWS       8
+
+// Circuit breaker: failed transfers in a row before a zone is quarantined,
+// and the probe backoff range while it is (doubles on every missed probe)
+#define LINK_QUARANTINE_FAILS      3
+#define LINK_BACKOFF_MIN_MS        500
+#define LINK_BACKOFF_MAX_MS        32000
+
+// A zone quarantined this long without a single answered probe is taken
+// as unplugged and dropped from the table (zone_discovery.c)
+#define LINK_ABSENT_REMOVE_MS      600000UL
+
+// Effective throughput is recomputed this often
+#define LINK_RATE_PERIOD_MS        1000
+
+// Public API
+void zone_link_init(Zone_t* zone);
+void zone_link_record(Zone_t* zone, const I2cXfer_t* xfer);
+void zone_link_record_corrupt(Zone_t* zone);
+void zone_link_process(void);
+uint8_t zone_link_usable(const Zone_t* zone);
+uint8_t zone_link_absent(const Zone_t* zone, uint32_t now);
+
+#endif
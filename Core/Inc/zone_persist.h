@@ -0,0 +1,49 @@
+#ifndef ZONE_PERSIST_H
+#define ZONE_PERSIST_H
+
+#include <stdint.h>
+#include "zone_table.h"
+
+// Run-time clock saved this often; irrigation timestamps are kept in it
+// since HAL_GetTick() restarts from zero at every reset. At most this much
+// run time before a reset is lost (one write per period).
+#define PERSIST_CLOCK_SAVE_SEC  10
+
+// Calibration overrides (a curve or trim other than the default on one
+// zone channel) saved at most, facility-wide: two EEPROM variables each,
+// in the ids no zone address uses
+#define PERSIST_CAL_SLOTS       14
+
+// State of one zone as it was last saved, by I2C address
+typedef struct {
+    uint8_t  profile;               // PROFILE_NONE if it was unassigned
+    uint8_t  actuators;             // Desired ACT_* bits, pump excluded
+    uint8_t  has_irrigation;        // 0: no timestamp saved yet
+    uint8_t  irrigating;            // Pump run in progress at the last save
+    uint16_t irrigation_age_sec;    // Run time since that run (or the assignment) started
+} ZonePersist_t;
+
+// Public API
+// Loads the journal (emulated EEPROM) and resumes the run-time clock
+void zone_persist_init(void);
+void zone_persist_process(uint32_t now);
+
+// Returns 0 if nothing was ever saved for this address
+uint8_t zone_persist_load(uint8_t addr, ZonePersist_t* out);
+
+// Assigned profile and desired outputs (pump excluded, see below)
+void zone_persist_save_state(const Zone_t* zone);
+
+// Start of the last irrigation run, or of the timer after an assignment;
+// 'running' marks a pump run, so a reset mid-run finishes it
+void zone_persist_save_irrigation(const Zone_t* zone, uint8_t running, uint32_t now);
+
+// Curve and trim of one channel as they are in the zone now; back to the
+// default frees the slot. Returns 0 if every slot is taken or flash failed.
+uint8_t zone_persist_save_calibration(const Zone_t* zone, uint8_t channel);
+
+// Fills cal_curve[] and cal_offset[] from what was saved for the zone's
+// address (calibration_prepare() builds the tables)
+void zone_persist_load_calibration(Zone_t* zone);
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef ZONE_TABLE_H
+#define ZONE_TABLE_H
+
+#include <stdint.h>
+
+// Capacity - RAM cost is sizeof(Zone_t) per zone plus a 128-byte address map.
+// Room for a node at every address discovery scans; zone indices stay 8-bit.
+#define ZONE_MAX              112
+#define ZONE_MAX_CHANNELS     8        // Largest node the master accepts (descriptor clamps to it)
+#define ZONE_NONE             0xFF
+#define ZONE_FW_LEGACY        0xFF     // Legacy node: no register map, so no firmware version
+#define PROFILE_NONE          255
+#define ZONE_AGE_NEVER        0xFFFFFFFFUL   // Data age of a zone never sampled
+
+// Addresses a zone can have (discovery scans this range)
+#define ZONE_ADDR_FIRST       0x07     // 0x00-0x06 reserved; 0x07 is the original node 2
+#define ZONE_ADDR_LAST        0x77     // 0x78-0x7F reserved by the I2C spec
+
+_Static_assert(ZONE_MAX < ZONE_NONE, "zone indices and heap slots are uint8_t with ZONE_NONE as the gap");
+
+// Actuator bitmap (bit n drives field-node pin PD2+n)
+#define ACT_PUMP              (1 << 0)
+#define ACT_HUMID             (1 << 1)
+#define ACT_FAN               (1 << 2)
+#define ACT_LIGHT1            (1 << 3)
+#define ZONE_ACTUATOR_BITS    4          // ACT_* bits, one relay each
+#define ZONE_PWM_BITS         4          // Actuator bits that may carry a PWM duty
+
+_Static_assert(ACT_LIGHT1 < (1 << ZONE_ACTUATOR_BITS), "ZONE_ACTUATOR_BITS must cover every ACT_* bit");
+_Static_assert(ZONE_PWM_BITS <= ZONE_ACTUATOR_BITS, "PWM outputs are a subset of the actuators");
+
+// Sensor channels with a fixed meaning; channels 3+ are reported only
+#define ZONE_CH_HUMIDITY      0
+#define ZONE_CH_TEMP          1
+#define ZONE_CH_LIGHT         2
+
+// Zone flags
+#define ZONE_FLAG_CMD_PENDING (1 << 0)   // Actuator frame on the bus, not yet acked
+#define ZONE_FLAG_SAMPLED     (1 << 1)   // At least one good sensor frame received
+#define ZONE_FLAG_STALE       (1 << 2)   // Last frame repeated the previous sample_seq
+#define ZONE_FLAG_DESCRIBED   (1 << 3)   // Capability descriptor read and trusted
+#define ZONE_FLAG_UNFILTERED  (1 << 4)   // New snapshot in sensors[], not through the filters yet
+#define ZONE_FLAG_FILTERED    (1 << 5)   // Filter state primed from a first sample
+#define ZONE_FLAG_LANES       (1 << 6)   // Hysteresis rows compiled from lane_first on
+#define ZONE_FLAG_RELEASED    (1 << 7)   // All-off frame sent since the breaker opened
+
+// Median window per channel, 3 or 5 samples (sensor_filter.c)
+#define ZONE_FILTER_TAPS      5
+
+// Zone health (circuit breaker, see zone_link.c)
+typedef enum {
+    ZONE_HEALTHY = 0,
+    ZONE_SUSPECT,                       // Recent failures, still polled
+    ZONE_QUARANTINED                    // No traffic except backoff probes
+} ZoneHealth_t;
+
+// Transfer time histogram: bucket 0 is < 128 us, each next bucket
+// doubles, the last one holds everything from 8.2 ms up (timeouts)
+#define ZONE_LATENCY_BUCKETS  8
+#define ZONE_LATENCY_BASE_SHIFT 7
+
+// Per-zone I2C link quality (maintained by zone_link.c)
+typedef struct {
+    uint32_t attempts;                  // Bus attempts incl. retries, lifetime
+    uint32_t nacks;
+    uint32_t bus_errors;                // BERR/ARLO/timeouts, each followed by a bus recovery
+    uint32_t arb_lost;                  // ARLO share of bus_errors
+    uint32_t timeouts;                  // Watchdog share of bus_errors
+    uint32_t transfers;                 // Finished transfers, ok or failed
+    uint32_t retries;                   // Attempts beyond the first
+    uint32_t last_ok_tick;              // Completion of the last successful transfer
+    uint32_t last_xfer_us;              // Wire time of the last transfer, all attempts
+    uint32_t max_xfer_us;
+    uint32_t latency_hist[ZONE_LATENCY_BUCKETS];
+    uint16_t window_attempts;           // Current error-rate window
+    uint16_t window_errors;
+    uint16_t error_permille;            // Error rate of the last full window
+    uint8_t  slow;                      // 1 = running at I2C_BUS_SPEED_SLOW_HZ
+    uint8_t  clean_windows;             // Error-free windows while slow
+    uint32_t rate_bytes;                // Payload bytes in the current rate period
+    uint16_t bytes_per_sec;             // Effective payload throughput
+    uint32_t pec_errors;                // Frames dropped for a bad PEC
+    uint8_t  health;                    // ZoneHealth_t
+    uint8_t  fail_streak;               // Consecutive failed transfers
+    uint8_t  probe_pending;             // Quarantine probe on the bus
+    uint16_t quarantines;               // Times the breaker opened
+    uint16_t backoff_ms;                // Current quarantine probe spacing
+    uint32_t next_probe_tick;
+    uint32_t quarantined_tick;          // Breaker opened (not re-armed by missed probes)
+} ZoneLink_t;
+
+// Per-zone state, one entry per field node
+typedef struct {
+    uint8_t  addr;                      // 7-bit I2C address (unique across buses)
+    uint8_t  bus;                       // I2C_BUS_n the node is wired to
+    uint8_t  assigned_profile;          // PROFILE_NONE = unassigned
+    uint8_t  actuators;                 // ACT_* bits confirmed by the node
+    uint8_t  desired;                   // ACT_* bits the control loop wants
+    uint8_t  irrigation_active;
+    uint32_t act_since[ZONE_ACTUATOR_BITS];  // Tick the desired state of each ACT_* bit last changed
+    uint32_t toggles[ZONE_ACTUATOR_BITS];    // Desired on/off changes per ACT_* bit
+    uint8_t  flags;                     // ZONE_FLAG_*
+    uint32_t last_irrigation_time;
+    uint32_t irrigation_start_time;
+    uint32_t irrigation_delay_ms;       // Last start's wait for a pump slot
+    uint32_t last_refresh_time;         // Last full actuator frame sent
+    uint8_t  protocol;                  // NODE_PROTOCOL_*, 0 until the descriptor read
+    uint8_t  channel_count;             // Sensor channels the node reports
+    uint8_t  actuator_mask;             // ACT_* bits the node has outputs for
+    uint8_t  resolution;                // ADC bits per raw sample
+    uint16_t sensors[ZONE_MAX_CHANNELS];// Last good read, scaled to 10 bits; [0..channel_count-1] valid
+    int16_t  values[ZONE_MAX_CHANNELS]; // Filtered sensors[] in engineering units (calibration.h)
+    uint32_t filter_taps[ZONE_FILTER_TAPS][ZONE_MAX_CHANNELS / 2]; // Median window, two channels per word
+    uint16_t filter_ema[ZONE_MAX_CHANNELS];  // EMA state, count << FILTER_EMA_FRAC_BITS
+    uint8_t  filter_next;                    // Median tap overwritten next
+    uint16_t lane_first;                     // First compiled hysteresis lane (control_rules.c)
+    uint8_t  cal_curve[ZONE_MAX_CHANNELS];   // CalCurve_t per channel
+    int16_t  cal_offset[ZONE_MAX_CHANNELS];  // Per-zone trim, engineering units
+    const int16_t* cal_lut[ZONE_MAX_CHANNELS];// Resolved table, NULL = values[] are raw
+    uint8_t  pwm_mask;                  // ACT_* outputs the node can modulate
+    uint8_t  pwm_active;                // Outputs currently under PI duty control
+    uint8_t  duty_pending;              // Duty frames on the bus, by ACT_* bit
+    uint8_t  duty[ZONE_PWM_BITS];       // Duty the PI loops want, 0-255
+    uint8_t  duty_acked[ZONE_PWM_BITS]; // Duty the node last acknowledged
+    int32_t  pi_integral[ZONE_PWM_BITS];// PI integrator, Q8 duty
+    uint8_t  fw_version;                // REG_FW_VERSION, ZONE_FW_LEGACY if unsupported
+    uint8_t  sample_seq;                // Node's REG_SAMPLE_SEQ at the last read
+    uint32_t sample_tick;               // Latch broadcast time of the snapshot in sensors[]
+    uint32_t evaluated_tick;            // sample_tick the control rules last ran on
+    uint8_t  node_rx_errors;            // Node-side counters from the register map
+    uint8_t  node_cmd_errors;
+    uint32_t node_uptime_sec;
+    ZoneLink_t link;
+} Zone_t;
+
+// Public API
+void zone_table_init(void);
+uint8_t zone_table_add(uint8_t bus, uint8_t addr);
+void zone_table_remove(uint8_t addr);
+uint8_t zone_table_find(uint8_t addr);
+uint8_t zone_table_node_number(uint8_t addr);   // 1-based, stable per address
+uint8_t zone_table_count(void);
+Zone_t* zone_table_get(uint8_t index);
+Zone_t* zone_table_lookup(uint8_t addr);
+uint32_t zone_table_data_age(const Zone_t* zone, uint32_t now);
+
+#endif
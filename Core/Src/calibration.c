@@ -0,0 +1,127 @@
+/*
+ * calibration.c
+ *
+ * Raw 10-bit counts -> engineering units through lookup tables.
+ *
+ * Each curve is stored as a short list of (raw, value) breakpoints taken
+ * from the sensor datasheet and its divider. The first time a zone that
+ * uses a curve gets a profile, the breakpoints are interpolated into a
+ * full 1024-entry table; from then on converting a sample is a single
+ * array read plus the zone's trim. Zones with the same sensor share the
+ * table, so RAM is CAL_LUT_SIZE * 2 bytes per curve in use, not per zone.
+ *
+ * Readings outside the breakpoint range clamp to the end values.
+ */
+
+#include "calibration.h"
+#include "sensor_filter.h"
+#include <stddef.h>
+
+typedef struct {
+    uint16_t raw;
+    int16_t  value;
+} CalPoint_t;
+
+typedef struct {
+    const CalPoint_t* points;   // Ascending raw
+    uint8_t count;
+} CalCurveDef_t;
+
+// Vout = 0.826 V + 31.5 mV/%RH at 5 V supply
+static const CalPoint_t hih4000_points[] = {
+    {169, CAL_RH(0)}, {813, CAL_RH(100)},
+};
+
+// Beta equation, 10k at 25 degC, B = 3950, every 5 degC
+static const CalPoint_t ntc10k_points[] = {
+    { 89, CAL_DEG_C(-20)}, {116, CAL_DEG_C(-15)}, {150, CAL_DEG_C(-10)}, {189, CAL_DEG_C(-5)},
+    {235, CAL_DEG_C(0)},   {285, CAL_DEG_C(5)},   {339, CAL_DEG_C(10)},  {396, CAL_DEG_C(15)},
+    {454, CAL_DEG_C(20)},  {512, CAL_DEG_C(25)},  {567, CAL_DEG_C(30)},  {620, CAL_DEG_C(35)},
+    {669, CAL_DEG_C(40)},  {713, CAL_DEG_C(45)},  {753, CAL_DEG_C(50)},  {788, CAL_DEG_C(55)},
+    {819, CAL_DEG_C(60)},  {846, CAL_DEG_C(65)},  {870, CAL_DEG_C(70)},  {890, CAL_DEG_C(75)},
+    {908, CAL_DEG_C(80)},
+};
+
+// R = 10k * (lux / 10) ^ -0.7, one point per half decade
+static const CalPoint_t ldr_points[] = {
+    { 93, CAL_LUX(10)},   {182, CAL_LUX(30)},   {342, CAL_LUX(100)},
+    {532, CAL_LUX(300)},  {732, CAL_LUX(1000)}, {864, CAL_LUX(3000)},
+    {948, CAL_LUX(10000)}, {987, CAL_LUX(30000)}, {1007, CAL_LUX(100000)},
+};
+
+#define CURVE(p)  {(p), sizeof(p) / sizeof((p)[0])}
+
+static const CalCurveDef_t curves[CAL_CURVE_COUNT] = {
+    [CAL_CURVE_HIH4000] = CURVE(hih4000_points),
+    [CAL_CURVE_NTC10K]  = CURVE(ntc10k_points),
+    [CAL_CURVE_LDR]     = CURVE(ldr_points),
+};
+
+// Private state
+static int16_t luts[CAL_CURVE_COUNT][CAL_LUT_SIZE];
+static uint8_t built;               // Bit per curve whose table is ready
+
+static uint8_t default_curve(uint8_t channel) {
+    switch (channel) {
+        case ZONE_CH_HUMIDITY: return CAL_CURVE_HIH4000;
+        case ZONE_CH_TEMP:     return CAL_CURVE_NTC10K;
+        case ZONE_CH_LIGHT:    return CAL_CURVE_LDR;
+        default:               return CAL_CURVE_RAW;
+    }
+}
+
+// Piecewise-linear fill, walking the breakpoints once
+static void build_lut(uint8_t curve) {
+    const CalCurveDef_t* def = &curves[curve];
+    const CalPoint_t* p = def->points;
+    const CalPoint_t* last = def->points + def->count - 1;
+    int16_t* lut = luts[curve];
+
+    for (uint16_t raw = 0; raw < CAL_LUT_SIZE; raw++) {
+        while (p < last && raw >= p[1].raw) p++;
+
+        if (raw <= def->points[0].raw) {
+            lut[raw] = def->points[0].value;
+        } else if (p == last) {
+            lut[raw] = last->value;
+        } else {
+            int32_t span = p[1].value - p->value;
+            lut[raw] = p->value + (int16_t)(span * (raw - p->raw) / (p[1].raw - p->raw));
+        }
+    }
+    built |= 1 << curve;
+}
+
+static const int16_t* curve_lut(uint8_t curve) {
+    if (curve >= CAL_CURVE_COUNT || curves[curve].points == NULL) return NULL;
+    if (!(built & (1 << curve))) build_lut(curve);
+    return luts[curve];
+}
+
+static void prepare_channel(Zone_t* zone, uint8_t channel) {
+    uint8_t curve = zone->cal_curve[channel];
+    if (curve == CAL_CURVE_DEFAULT) curve = default_curve(channel);
+
+    zone->cal_lut[channel] = curve_lut(curve);
+    zone->values[channel] = calibration_apply(zone, channel, sensor_filter_output(zone, channel));
+}
+
+// Public functions
+void calibration_init(void) {
+    built = 0;
+}
+
+void calibration_prepare(Zone_t* zone) {
+    for (uint8_t ch = 0; ch < ZONE_MAX_CHANNELS; ch++) {
+        prepare_channel(zone, ch);
+    }
+}
+
+uint8_t calibration_set(Zone_t* zone, uint8_t channel, uint8_t curve, int16_t offset) {
+    if (channel >= ZONE_MAX_CHANNELS || curve >= CAL_CURVE_COUNT) return 0;
+
+    zone->cal_curve[channel] = curve;
+    zone->cal_offset[channel] = offset;
+    prepare_channel(zone, channel);
+    return 1;
+}
@@ -0,0 +1,225 @@
+/*
+ * control_rules.c
+ *
+ * Evaluates a profile's rule table against one zone's sensor snapshot,
+ * in the engineering units calibration.c converted it to.
+ *
+ * Each rule decides at most its own actuator bits and adds them to the
+ * caller's mask/value pair, the same decision format the control loop
+ * hands to sync_actuators(). Inside the hysteresis band a rule makes no
+ * decision, so the actuator keeps its previous state.
+ *
+ * Several rules may drive one actuator: it is on if any rule turns it on,
+ * and any active interlock (INHIBIT_*) overrides them all. Rules on
+ * channels the node does not have are skipped.
+ *
+ * PI rows run in fixed point, duty in Q8 (255 << 8 = full on):
+ *   p = error * full / band,  integral += p * dt / Ti,  duty = p + integral
+ * Integration stops while the output sits on a rail and is pushed further
+ * into it (conditional anti-windup), and the integral stays in [0, full].
+ *
+ * Hysteresis rows (ON_* and PI_* without PWM) of every assigned zone are
+ * compiled into structure-of-arrays lanes: contiguous int16 value, on- and
+ * off-threshold arrays, with *_ABOVE rows complemented (~v = -v - 1,
+ * which mirrors the int16 range exactly where -v would saturate at
+ * -32768) so every lane reads "on below lane_on, off above lane_off". control_rules_batch() compares
+ * all lanes two at a time (SSUB16 sets the per-halfword GE flags, SEL turns
+ * them into lane masks) and control_rules_eval() then only picks up each
+ * row's result. Lanes are rebuilt after control_rules_invalidate(); a zone
+ * that does not fit, or was not compiled, is evaluated row by row.
+ */
+
+#include "control_rules.h"
+#include "plant_profiles.h"
+#include "main.h"
+#include <stddef.h>
+
+#define PI_FULL_Q8  (255 * 256)
+
+// Lane results
+#define LANE_ON     1
+#define LANE_OFF    2
+
+// Private state
+// Pairs of lanes are read as one word, so the arrays are also seen as uint32_t
+typedef union {
+    int16_t  h[RULE_LANES_MAX];
+    uint32_t w[RULE_LANES_MAX / 2];
+} LaneArray_t;
+
+static LaneArray_t lane_x;                  // Sensor value, complemented for *_ABOVE rows
+static LaneArray_t lane_on;                 // x < lane_on: actuator on
+static LaneArray_t lane_off;                // x > lane_off: actuator off
+static uint16_t lane_zone[RULE_LANES_MAX];  // Zone index
+static uint8_t lane_channel[RULE_LANES_MAX];
+static uint8_t lane_negate[RULE_LANES_MAX];
+static uint8_t lane_result[RULE_LANES_MAX]; // LANE_ON / LANE_OFF / 0 inside the band
+static uint16_t lane_count = 0;
+static uint8_t lanes_dirty = 1;
+
+static int32_t clamp(int32_t v, int32_t lo, int32_t hi) {
+    return (v < lo) ? lo : (v > hi) ? hi : v;
+}
+
+static uint8_t pi_step(int32_t* integral, const ControlRule_t* r, int32_t error, uint32_t dt_ms) {
+    int32_t band = (r->band != 0) ? r->band : 1;
+    int32_t p = clamp(error * PI_FULL_Q8 / band, -PI_FULL_Q8, PI_FULL_Q8);
+    int32_t u = p + *integral;
+
+    if (r->ti_sec != 0 && !(u >= PI_FULL_Q8 && p > 0) && !(u <= 0 && p < 0)) {
+        *integral = clamp(*integral + p * (int32_t)dt_ms / (r->ti_sec * 1000), 0, PI_FULL_Q8);
+        u = p + *integral;
+    }
+
+    return (uint8_t)((clamp(u, 0, PI_FULL_Q8) + 128) >> 8);
+}
+
+// PI row that the node can actually modulate (otherwise it is a hysteresis row)
+static uint8_t pi_has_pwm(const ControlRule_t* r, const Zone_t* zone) {
+    uint8_t bit = (r->actuator != 0) ? __builtin_ctz(r->actuator) : ZONE_PWM_BITS;
+    return bit < ZONE_PWM_BITS && (zone->pwm_mask & r->actuator);
+}
+
+static uint8_t is_hysteresis(const ControlRule_t* r, const Zone_t* zone) {
+    switch (r->cmp) {
+        case RULE_ON_BELOW:
+        case RULE_ON_ABOVE:
+            return 1;
+        case RULE_PI_BELOW:
+        case RULE_PI_ABOVE:
+            return !pi_has_pwm(r, zone);
+        default:
+            return 0;
+    }
+}
+
+static int16_t clamp16(int32_t v) {
+    return (int16_t)clamp(v, INT16_MIN, INT16_MAX);
+}
+
+static void compile_zone(uint8_t index, Zone_t* zone) {
+    PlantProfile_t* profile = get_profile(zone->assigned_profile);
+
+    zone->flags &= ~ZONE_FLAG_LANES;
+    if (profile == NULL) return;
+
+    uint16_t first = lane_count;
+    for (const ControlRule_t* r = profile->rules; r < profile->rules + profile->rule_count; r++) {
+        if (r->channel >= zone->channel_count || !is_hysteresis(r, zone)) continue;
+        if (lane_count >= RULE_LANES_MAX) {
+            lane_count = first;                 // Row by row for this zone
+            return;
+        }
+
+        uint8_t above = (r->cmp == RULE_ON_ABOVE || r->cmp == RULE_PI_ABOVE);
+        lane_zone[lane_count] = index;
+        lane_channel[lane_count] = r->channel;
+        lane_negate[lane_count] = above;
+        lane_on.h[lane_count] = above ? ~r->threshold : r->threshold;
+        lane_off.h[lane_count] = above ? clamp16((int32_t)r->band - r->threshold - 1)
+                                       : clamp16((int32_t)r->threshold + r->band);
+        lane_count++;
+    }
+    zone->lane_first = first;
+    zone->flags |= ZONE_FLAG_LANES;
+}
+
+static void compile_lanes(void) {
+    uint8_t count = zone_table_count();
+
+    lane_count = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        compile_zone(i, zone_table_get(i));
+    }
+    lanes_dirty = 0;
+}
+
+// Public functions
+void control_rules_invalidate(void) {
+    lanes_dirty = 1;
+}
+
+void control_rules_batch(void) {
+    if (lanes_dirty) compile_lanes();
+
+    // Values change per sample, thresholds only on recompile
+    for (uint16_t i = 0; i < lane_count; i++) {
+        int16_t v = zone_table_get(lane_zone[i])->values[lane_channel[i]];
+        lane_x.h[i] = lane_negate[i] ? ~v : v;
+    }
+
+    for (uint16_t p = 0; p < (lane_count + 1) / 2; p++) {
+        uint32_t x = lane_x.w[p];
+
+        __SSUB16(x, lane_on.w[p]);              // GE per lane where x >= on
+        uint32_t on = __SEL(0, 0xFFFFFFFF);
+        __SSUB16(lane_off.w[p], x);             // GE per lane where off >= x
+        uint32_t off = __SEL(0, 0xFFFFFFFF);
+
+        lane_result[2 * p] = (on & 1) ? LANE_ON : (off & 1) ? LANE_OFF : 0;
+        lane_result[2 * p + 1] = (on >> 16 & 1) ? LANE_ON : (off >> 16 & 1) ? LANE_OFF : 0;
+    }
+}
+
+void control_rules_eval(const ControlRule_t* rules, uint8_t count, Zone_t* zone,
+                        uint32_t dt_ms, uint8_t* mask, uint8_t* value) {
+    uint8_t on = 0, decided = 0, inhibit = 0, pwm = 0;
+    uint8_t lanes = !lanes_dirty && (zone->flags & ZONE_FLAG_LANES);
+    const uint8_t* result = &lane_result[zone->lane_first];
+
+    if (dt_ms > RULE_PI_MAX_DT_MS) dt_ms = RULE_PI_MAX_DT_MS;
+
+    for (const ControlRule_t* r = rules; r < rules + count; r++) {
+        if (r->channel >= zone->channel_count) continue;
+
+        int32_t v = zone->values[r->channel];
+        int32_t threshold = r->threshold;
+        uint8_t below = (r->cmp == RULE_ON_BELOW || r->cmp == RULE_PI_BELOW);
+
+        switch (r->cmp) {
+            case RULE_PI_BELOW:
+            case RULE_PI_ABOVE: {
+                if (pi_has_pwm(r, zone)) {
+                    uint8_t bit = __builtin_ctz(r->actuator);
+                    int32_t error = below ? threshold - v : v - threshold;
+                    uint8_t duty = pi_step(&zone->pi_integral[bit], r, error, dt_ms);
+
+                    zone->duty[bit] = duty;
+                    pwm |= r->actuator;
+                    decided |= r->actuator;
+                    if (duty != 0) on |= r->actuator;
+                    break;
+                }
+            }
+            // No PWM on this output: plain hysteresis around the setpoint
+            /* fall through */
+            case RULE_ON_BELOW:
+            case RULE_ON_ABOVE:
+                if (lanes) {
+                    uint8_t res = *result++;            // Compiled in row order
+                    if (res == LANE_ON) on |= r->actuator;
+                    if (res != 0) decided |= r->actuator;
+                } else if (below ? (v < threshold) : (v > threshold)) {
+                    on |= r->actuator;
+                    decided |= r->actuator;
+                } else if (below ? (v > threshold + r->band) : (v < threshold - r->band)) {
+                    decided |= r->actuator;
+                }
+                break;
+            case RULE_INHIBIT_BELOW:
+                if (v < threshold) inhibit |= r->actuator;
+                break;
+            case RULE_INHIBIT_ABOVE:
+                if (v > threshold) inhibit |= r->actuator;
+                break;
+            default:
+                break;
+        }
+    }
+
+    // An interlocked PWM output goes back to relay control, i.e. off
+    zone->pwm_active = pwm & ~inhibit;
+
+    *mask |= decided | inhibit;
+    *value = (*value & ~(decided | inhibit)) | (on & ~inhibit);
+}
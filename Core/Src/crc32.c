@@ -0,0 +1,20 @@
+/*
+ * crc32.c
+ *
+ * Bitwise CRC-32 for records kept in flash. Records are checked once at
+ * boot and written rarely, so a 1 KB table is not worth the flash.
+ */
+
+#include "crc32.h"
+
+uint32_t crc32_compute(const uint8_t* data, uint32_t len) {
+    uint32_t crc = 0xFFFFFFFFUL;
+
+    while (len--) {
+        crc ^= *data++;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320UL & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
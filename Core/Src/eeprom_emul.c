@@ -0,0 +1,256 @@
+/*
+ * eeprom_emul.c
+ *
+ * Emulated EEPROM over two flash sectors, for small values that change at
+ * runtime (zone assignments, timers - see zone_persist.c).
+ *
+ * Each write appends one 32-bit entry to the live page: value, variable
+ * id and a CRC-8 over both. Nothing is rewritten in place; the newest
+ * entry of a variable wins. When the page is full, the newest value of
+ * every variable is copied to the other (erased) page and the full one is
+ * erased, so erases alternate between the two sectors and each sees one
+ * erase per ~32000 writes. At boot one scan of the live page fills a RAM
+ * copy of all variables, and reads never touch flash again.
+ *
+ * The first word of a page is its status, only ever programmed towards
+ * zero so each step is one word write:
+ *   ERASED -> RECEIVE (copy running) -> COPIED (copy done) -> VALID
+ * A transfer marks the new page RECEIVE, copies, marks it COPIED, erases
+ * the old page and only then marks the new one VALID. Whatever step a
+ * reset cuts, ee_init() finds one complete page. A status write cut
+ * short leaves a value bitwise between the two steps and counts as the
+ * earlier one, except between COPIED and VALID where either means the
+ * same.
+ * - COPIED: the copy finished; the old page (maybe half erased) goes
+ * - VALID: the live page; a RECEIVE page next to it is a copy that never
+ *   finished and is erased before the next transfer
+ * - RECEIVE alone: cannot come from a transfer; what it holds is kept
+ * - neither: first boot or both pages damaged, both are formatted
+ * An entry torn by a reset fails its CRC-8 and is skipped (all but about
+ * 1 in 256 do; the reset has to land inside a ~16 us word program). The
+ * first erased word ends the journal.
+ */
+
+#include "eeprom_emul.h"
+#include "crc8.h"
+#include <string.h>
+
+#define PAGE_ERASED     0xFFFFFFFFUL
+#define PAGE_RECEIVE    0xEEEEEEEEUL
+#define PAGE_COPIED     0xCCCCCCCCUL
+#define PAGE_VALID      0x00000000UL
+
+#define ENTRY_ERASED    0xFFFFFFFFUL
+#define SLOT_COUNT      (EE_PAGE_SIZE / 4 - 1)     // Word 0 is the status
+#define NO_PAGE         0xFF
+
+typedef enum {
+    STATE_OTHER,                // Erased, being erased, or torn ERASED -> RECEIVE
+    STATE_RECEIVE,
+    STATE_COPIED,
+    STATE_VALID
+} PageState_t;
+
+// Private state
+static uint16_t values[EE_VAR_COUNT];
+static uint32_t present[(EE_VAR_COUNT + 31) / 32];
+static uint8_t live_page = NO_PAGE;
+static uint16_t next_slot = 0;
+static EeStats_t stats;
+
+static uint32_t page_addr(uint8_t page) {
+    return page ? EE_PAGE1_ADDR : EE_PAGE0_ADDR;
+}
+
+// Status bits are only ever cleared, so a torn write is a subset of the
+// status before it
+static PageState_t page_state(uint8_t page) {
+    uint32_t status = *(volatile const uint32_t*)page_addr(page);
+
+    if (status == PAGE_VALID) return STATE_VALID;
+    if ((status & ~PAGE_COPIED) == 0) return STATE_COPIED;
+    if ((status & ~PAGE_RECEIVE) == 0) return STATE_RECEIVE;
+    return STATE_OTHER;
+}
+
+static uint32_t slot_addr(uint8_t page, uint16_t slot) {
+    return page_addr(page) + 4 + 4UL * slot;
+}
+
+// value | var << 16 | crc << 24; var 0xFF is never used, so no valid
+// entry reads as an erased word
+static uint32_t pack_entry(uint8_t var, uint16_t value) {
+    uint8_t bytes[3] = {value & 0xFF, value >> 8, var};
+    return value | ((uint32_t)var << 16) | ((uint32_t)crc8_update(0, bytes, sizeof(bytes)) << 24);
+}
+
+static uint8_t entry_ok(uint32_t entry) {
+    return pack_entry((entry >> 16) & 0xFF, entry & 0xFFFF) == entry && ((entry >> 16) & 0xFF) < EE_VAR_COUNT;
+}
+
+static void set_value(uint8_t var, uint16_t value) {
+    values[var] = value;
+    present[var / 32] |= 1UL << (var % 32);
+}
+
+static uint8_t is_present(uint8_t var) {
+    return (present[var / 32] >> (var % 32)) & 1;
+}
+
+static uint8_t program_word(uint32_t addr, uint32_t word) {
+    HAL_FLASH_Unlock();
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_OPERR | FLASH_FLAG_WRPERR |
+                           FLASH_FLAG_PGAERR | FLASH_FLAG_PGPERR | FLASH_FLAG_PGSERR);
+    HAL_StatusTypeDef status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, addr, word);
+    HAL_FLASH_Lock();
+
+    if (status != HAL_OK) stats.write_errors++;
+    return status == HAL_OK;
+}
+
+static uint8_t erase_page(uint8_t page) {
+    FLASH_EraseInitTypeDef erase = {0};
+    uint32_t sector_error = 0;
+
+    erase.TypeErase = FLASH_TYPEERASE_SECTORS;
+    erase.Sector = page ? EE_PAGE1_SECTOR : EE_PAGE0_SECTOR;
+    erase.NbSectors = 1;
+    erase.VoltageRange = FLASH_VOLTAGE_RANGE_3;
+
+    HAL_FLASH_Unlock();
+    HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&erase, &sector_error);
+    HAL_FLASH_Lock();
+
+    if (status != HAL_OK) stats.write_errors++;
+    return status == HAL_OK;
+}
+
+// A reset during an erase can leave a page half cleared
+static uint8_t page_blank(uint8_t page) {
+    const uint32_t* word = (const uint32_t*)page_addr(page);
+    for (uint32_t i = 0; i < EE_PAGE_SIZE / 4; i++) {
+        if (word[i] != ENTRY_ERASED) return 0;
+    }
+    return 1;
+}
+
+// Replays the page's journal into the RAM copy
+static void load_page(uint8_t page) {
+    uint16_t slot;
+
+    for (slot = 0; slot < SLOT_COUNT; slot++) {
+        uint32_t entry = *(volatile const uint32_t*)slot_addr(page, slot);
+        if (entry == ENTRY_ERASED) break;
+
+        if (entry_ok(entry)) {
+            set_value((entry >> 16) & 0xFF, entry & 0xFFFF);
+        } else {
+            stats.bad_entries++;
+        }
+    }
+    live_page = page;
+    next_slot = slot;
+}
+
+// Starts a new journal in page 'to' from the RAM copy and retires 'from'
+// (NO_PAGE when formatting)
+static uint8_t transfer(uint8_t from, uint8_t to) {
+    uint16_t slot = 0;
+
+    live_page = NO_PAGE;                        // Until the new page is complete
+    if (!page_blank(to) && !erase_page(to)) return 0;
+    if (!program_word(page_addr(to), PAGE_RECEIVE)) return 0;
+
+    for (uint16_t var = 0; var < EE_VAR_COUNT; var++) {
+        if (!is_present(var)) continue;
+        if (!program_word(slot_addr(to, slot++), pack_entry(var, values[var]))) return 0;
+    }
+    if (!program_word(page_addr(to), PAGE_COPIED)) return 0;
+    if (from != NO_PAGE && !erase_page(from)) return 0;
+    if (!program_word(page_addr(to), PAGE_VALID)) return 0;
+
+    live_page = to;
+    next_slot = slot;
+    stats.transfers++;
+    return 1;
+}
+
+static uint8_t find_page(PageState_t state) {
+    if (page_state(0) == state) return 0;
+    if (page_state(1) == state) return 1;
+    return NO_PAGE;
+}
+
+static void update_stats(void) {
+    stats.entries = next_slot;
+    stats.free_slots = SLOT_COUNT - next_slot;
+}
+
+// Public functions
+uint8_t ee_init(void) {
+    uint32_t start = DWT->CYCCNT;
+    uint8_t page;
+
+    memset(present, 0, sizeof(present));
+    memset(&stats, 0, sizeof(stats));
+    live_page = NO_PAGE;
+
+    if ((page = find_page(STATE_COPIED)) != NO_PAGE) {
+        // Reset after the copy: finish retiring the old page
+        load_page(page);
+        if (!page_blank(!page) && !erase_page(!page)) live_page = NO_PAGE;
+        else if (!program_word(page_addr(page), PAGE_VALID)) live_page = NO_PAGE;
+    } else if ((page = find_page(STATE_VALID)) != NO_PAGE) {
+        load_page(page);
+    } else if ((page = find_page(STATE_RECEIVE)) != NO_PAGE) {
+        load_page(page);
+        transfer(page, !page);
+    } else {
+        transfer(NO_PAGE, 0);
+        if (!page_blank(1)) erase_page(1);
+    }
+
+    stats.restore_us = (DWT->CYCCNT - start) / (SystemCoreClock / 1000000U);
+    update_stats();
+    return live_page != NO_PAGE;
+}
+
+uint8_t ee_read(uint8_t var, uint16_t* value) {
+    if (var >= EE_VAR_COUNT || !is_present(var)) return 0;
+    *value = values[var];
+    return 1;
+}
+
+uint8_t ee_write(uint8_t var, uint16_t value) {
+    uint8_t ok;
+
+    if (var >= EE_VAR_COUNT) return 0;
+    if (is_present(var) && values[var] == value) return 1;
+
+    set_value(var, value);
+    if (live_page == NO_PAGE) return 0;
+
+    // The transfer writes the RAM copy, this value included
+    if (next_slot >= SLOT_COUNT) {
+        ok = transfer(live_page, !live_page);
+    } else {
+        uint32_t addr = slot_addr(live_page, next_slot);
+        ok = program_word(addr, pack_entry(var, value));
+
+        // A half-programmed word is skipped as torn; a still-erased one
+        // would end the journal at boot, so it is reused
+        if (ok || *(volatile const uint32_t*)addr != ENTRY_ERASED) next_slot++;
+    }
+    update_stats();
+    return ok;
+}
+
+const EeStats_t* ee_get_stats(void) {
+    return &stats;
+}
+
+uint32_t ee_borrow_spare(void) {
+    if (live_page == NO_PAGE) return 0;
+    if (!page_blank(!live_page) && !erase_page(!live_page)) return 0;
+    return page_addr(!live_page);
+}
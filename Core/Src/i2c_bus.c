@@ -0,0 +1,517 @@
+/*
+ * i2c_bus.c
+ *
+ * Non-blocking I2C transaction queues shared by every bus user
+ * (zone controllers, OLED). One independent queue per I2C peripheral,
+ * so traffic on I2C1/I2C2/I2C3 runs in parallel.
+ *
+ * Design:
+ * - Callers submit transactions into a bus's fixed ring; nothing blocks.
+ * - Transfers run in interrupt mode. The HAL completion/error callbacks
+ *   (ISR context) retire the active transfer and immediately start the
+ *   next one, so each bus stays busy even while the superloop sleeps.
+ * - i2c_bus_process() (superloop) runs the user callbacks, enforces the
+ *   per-transfer timeout and performs bus recovery, for every bus.
+ * - Recovery (after a bus error or timeout) follows the I2C spec: the
+ *   pins are taken over as open-drain GPIO, SCL is pulsed up to 9 times
+ *   until the slave releases SDA, a STOP is generated and the peripheral
+ *   is reinitialised. It takes tens of microseconds, timed with DWT.
+ * - Each bus runs at I2C_BUS_SPEED_FAST_HZ; devices marked slow get their
+ *   transfers at I2C_BUS_SPEED_SLOW_HZ. A transfer that needs the other
+ *   speed is not started from the ISR chain: it waits for
+ *   i2c_bus_process(), which reprograms the clock once the bus is idle
+ *   and the STOP of the previous transfer has cleared BUSY.
+ * - The HAL *_IT() starts spin on BUSY for up to 25 ms. A start here waits
+ *   at most I2C_BUS_START_WAIT_US for it (the previous STOP clearing) and
+ *   otherwise leaves the transfer queued; i2c_bus_process() retries it and
+ *   recovers a bus whose BUSY stays set past I2C_BUS_XFER_TIMEOUT_MS (a
+ *   slave holding SDA or SCL low).
+ *
+ * Ring layout (free-running 8-bit cursors):
+ *   q_done .. q_run   completed, waiting for callback dispatch
+ *   q_run             active transfer (or next to start)
+ *   q_run+1 .. q_head queued
+ */
+
+#include "i2c_bus.h"
+#include <string.h>
+
+#define QUEUE_MASK (I2C_BUS_QUEUE_LEN - 1)
+
+typedef struct {
+    I2C_HandleTypeDef* handle;
+    const I2cBusPins_t* pins;
+    I2cXfer_t queue[I2C_BUS_QUEUE_LEN];
+    volatile uint8_t q_done;
+    volatile uint8_t q_run;
+    volatile uint8_t q_head;
+    volatile uint8_t bus_active;
+    volatile uint8_t recovery_needed;
+    uint8_t slow_devices[128 / 8];          // Bitmap by 7-bit address
+    uint8_t start_blocked;                  // Queued work waiting for BUSY to clear
+    uint32_t start_blocked_tick;
+    I2cBusStats_t stats;
+} I2cBus_t;
+
+// Private state
+static I2cBus_t buses[I2C_BUS_COUNT];
+
+// Critical sections (submit/timeout paths race with the I2C ISRs)
+static inline uint32_t bus_lock(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    return primask;
+}
+
+static inline void bus_unlock(uint32_t primask) {
+    __set_PRIMASK(primask);
+}
+
+static I2cBus_t* bus_get(uint8_t bus) {
+    return (bus < I2C_BUS_COUNT && buses[bus].handle != NULL) ? &buses[bus] : NULL;
+}
+
+static I2cBus_t* bus_from_handle(I2C_HandleTypeDef* hi2c) {
+    for (uint8_t i = 0; i < I2C_BUS_COUNT; i++) {
+        if (buses[i].handle == hi2c) return &buses[i];
+    }
+    return NULL;
+}
+
+static uint8_t device_is_slow(const I2cBus_t* b, uint8_t addr) {
+    uint8_t addr7 = addr >> 1;
+    return (b->slow_devices[addr7 >> 3] >> (addr7 & 7)) & 1;
+}
+
+// Cycle-counter busy wait (DWT is enabled in i2c_bus_init)
+static void delay_us(uint32_t us) {
+    uint32_t start = DWT->CYCCNT;
+    uint32_t cycles = us * (SystemCoreClock / 1000000U);
+    while (DWT->CYCCNT - start < cycles) {
+    }
+}
+
+static inline uint8_t sda_high(const I2cBusPins_t* pins) {
+    return HAL_GPIO_ReadPin(pins->sda_port, pins->sda_pin) == GPIO_PIN_SET;
+}
+
+static inline void scl_set(const I2cBusPins_t* pins, GPIO_PinState state) {
+    HAL_GPIO_WritePin(pins->scl_port, pins->scl_pin, state);
+    delay_us(I2C_BUS_RECOVERY_HALF_US);
+}
+
+static inline void sda_set(const I2cBusPins_t* pins, GPIO_PinState state) {
+    HAL_GPIO_WritePin(pins->sda_port, pins->sda_pin, state);
+    delay_us(I2C_BUS_RECOVERY_HALF_US);
+}
+
+// Clock out whatever byte a slave is stuck in, then STOP. Returns 1 if
+// SDA ends up released.
+static uint8_t release_bus(const I2cBusPins_t* pins) {
+    GPIO_InitTypeDef gpio = {0};
+    gpio.Mode = GPIO_MODE_OUTPUT_OD;
+    gpio.Pull = GPIO_PULLUP;
+    gpio.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+
+    // Both lines released before handing them to GPIO
+    HAL_GPIO_WritePin(pins->scl_port, pins->scl_pin, GPIO_PIN_SET);
+    HAL_GPIO_WritePin(pins->sda_port, pins->sda_pin, GPIO_PIN_SET);
+    gpio.Pin = pins->scl_pin;
+    HAL_GPIO_Init(pins->scl_port, &gpio);
+    gpio.Pin = pins->sda_pin;
+    HAL_GPIO_Init(pins->sda_port, &gpio);
+    delay_us(I2C_BUS_RECOVERY_HALF_US);
+
+    for (uint8_t i = 0; i < I2C_BUS_RECOVERY_PULSES && !sda_high(pins); i++) {
+        scl_set(pins, GPIO_PIN_RESET);
+        scl_set(pins, GPIO_PIN_SET);
+    }
+
+    // STOP: SDA rises while SCL is high
+    scl_set(pins, GPIO_PIN_RESET);
+    sda_set(pins, GPIO_PIN_RESET);
+    scl_set(pins, GPIO_PIN_SET);
+    sda_set(pins, GPIO_PIN_SET);
+
+    return sda_high(pins);
+}
+
+// Bus recovery - only called from i2c_bus_process(), never from the ISR
+static void i2c_recovery(I2cBus_t* b) {
+    uint32_t start = DWT->CYCCNT;
+
+    __HAL_I2C_DISABLE(b->handle);
+    uint8_t released = (b->pins != NULL) ? release_bus(b->pins) : 1;
+
+    // DeInit/Init hands the pins back to the peripheral (MSP) and clears
+    // the busy state an abandoned IT transfer leaves in the HAL handle
+    HAL_I2C_DeInit(b->handle);
+    HAL_I2C_Init(b->handle);
+
+    uint32_t elapsed_us = (DWT->CYCCNT - start) / (SystemCoreClock / 1000000U);
+    b->stats.recoveries++;
+    if (!released) b->stats.recovery_failures++;
+    b->stats.last_recovery_us = elapsed_us;
+    if (elapsed_us > b->stats.max_recovery_us) b->stats.max_recovery_us = elapsed_us;
+}
+
+static uint32_t wanted_speed(const I2cBus_t* b, const I2cXfer_t* xfer) {
+    return device_is_slow(b, xfer->addr) ? I2C_BUS_SPEED_SLOW_HZ : I2C_BUS_SPEED_FAST_HZ;
+}
+
+// Reprogram the clock for the next transfer - only from i2c_bus_process().
+// HAL_I2C_Init() resets the peripheral (SWRST), so the previous transfer's
+// STOP must be off the wire: BUSY clears once it is.
+static void apply_speed(I2cBus_t* b) {
+    if (b->bus_active || b->q_run == b->q_head) return;
+
+    I2cXfer_t* xfer = &b->queue[b->q_run & QUEUE_MASK];
+    uint32_t wanted = wanted_speed(b, xfer);
+    if (b->handle->Init.ClockSpeed == wanted) return;
+    if (__HAL_I2C_GET_FLAG(b->handle, I2C_FLAG_BUSY)) return;    // See check_blocked()
+
+    b->handle->Init.ClockSpeed = wanted;
+    HAL_I2C_Init(b->handle);
+    b->stats.speed_switches++;
+}
+
+static HAL_StatusTypeDef start_xfer(I2cBus_t* b, I2cXfer_t* xfer) {
+    I2C_HandleTypeDef* hi2c = b->handle;
+
+    xfer->start_tick = HAL_GetTick();
+    xfer->start_cycles = DWT->CYCCNT;
+
+    switch (xfer->type) {
+        case I2C_XFER_WRITE:
+            return HAL_I2C_Master_Transmit_IT(hi2c, xfer->addr, xfer->buf, xfer->len);
+        case I2C_XFER_READ:
+            return HAL_I2C_Master_Receive_IT(hi2c, xfer->addr, xfer->buf, xfer->len);
+        case I2C_XFER_MEM_WRITE:
+            return HAL_I2C_Mem_Write_IT(hi2c, xfer->addr, xfer->mem_addr,
+                                        I2C_MEMADD_SIZE_8BIT, xfer->buf, xfer->len);
+        case I2C_XFER_MEM_READ:
+            return HAL_I2C_Mem_Read_IT(hi2c, xfer->addr, xfer->mem_addr,
+                                       I2C_MEMADD_SIZE_8BIT, xfer->buf, xfer->len);
+        default:
+            return HAL_ERROR;
+    }
+}
+
+// BUSY clears a few us after the previous STOP; a line held low keeps it
+// set. Bounded wait, so the ISR chain keeps going without ever spinning
+// on a stuck bus.
+static uint8_t wait_bus_free(I2cBus_t* b) {
+    uint32_t start = DWT->CYCCNT;
+    uint32_t limit = I2C_BUS_START_WAIT_US * (SystemCoreClock / 1000000U);
+
+    while (__HAL_I2C_GET_FLAG(b->handle, I2C_FLAG_BUSY)) {
+        if (DWT->CYCCNT - start > limit) return 0;
+    }
+    return 1;
+}
+
+// Must be called with interrupts masked or from the I2C ISR. A transfer
+// at the other speed waits for apply_speed(), one on a BUSY bus for
+// i2c_bus_process().
+static void start_next(I2cBus_t* b) {
+    if (b->bus_active || b->recovery_needed || b->q_run == b->q_head) return;
+    if (wanted_speed(b, &b->queue[b->q_run & QUEUE_MASK]) != b->handle->Init.ClockSpeed) return;
+    if (!wait_bus_free(b)) {
+        b->stats.busy_deferrals++;
+        return;
+    }
+
+    // HAL_BUSY leaves the transfer queued; i2c_bus_process() kicks it again
+    if (start_xfer(b, &b->queue[b->q_run & QUEUE_MASK]) == HAL_OK) {
+        b->bus_active = 1;
+    }
+}
+
+// Retire (or retry) the active transfer. ISR context or interrupts masked.
+static void finish_active(I2cBus_t* b, uint8_t status) {
+    I2cXfer_t* xfer = &b->queue[b->q_run & QUEUE_MASK];
+
+    b->bus_active = 0;
+    xfer->bus_cycles += DWT->CYCCNT - xfer->start_cycles;
+
+    if (status == I2C_XFER_NACK) {
+        xfer->nacks++;
+    } else if (status != I2C_XFER_OK) {
+        xfer->bus_errors++;
+    }
+
+    if (status != I2C_XFER_OK && xfer->attempts_left > 1) {
+        xfer->attempts_left--;          // Retry in place
+    } else {
+        xfer->status = status;
+        xfer->done_tick = HAL_GetTick();
+        b->q_run++;
+    }
+
+    if (status == I2C_XFER_BUS_ERROR || status == I2C_XFER_TIMEOUT) {
+        b->recovery_needed = 1;
+    } else {
+        start_next(b);
+    }
+}
+
+// Queued work that cannot start because BUSY stays set: a line held low.
+// Recovered like a stuck transfer once it has lasted the transfer timeout.
+static void check_blocked(I2cBus_t* b) {
+    uint8_t blocked = !b->bus_active && b->q_run != b->q_head && __HAL_I2C_GET_FLAG(b->handle, I2C_FLAG_BUSY);
+
+    if (!blocked) {
+        b->start_blocked = 0;
+    } else if (!b->start_blocked) {
+        b->start_blocked = 1;
+        b->start_blocked_tick = HAL_GetTick();
+    } else if (HAL_GetTick() - b->start_blocked_tick > I2C_BUS_XFER_TIMEOUT_MS) {
+        b->start_blocked = 0;
+        b->recovery_needed = 1;
+    }
+}
+
+static I2cXfer_t* alloc_xfer(uint8_t bus, uint8_t addr, uint8_t type, uint16_t len,
+                             I2cXferCallback_t cb, void* ctx) {
+    I2cBus_t* b = bus_get(bus);
+    if (b == NULL) return NULL;
+
+    if ((uint8_t)(b->q_head - b->q_done) >= I2C_BUS_QUEUE_LEN) {
+        b->stats.dropped++;
+        return NULL;
+    }
+
+    I2cXfer_t* xfer = &b->queue[b->q_head & QUEUE_MASK];
+    xfer->bus = bus;
+    xfer->addr = addr;
+    xfer->type = type;
+    xfer->mem_addr = 0;
+    xfer->attempts_left = I2C_BUS_DEFAULT_ATTEMPTS;
+    xfer->status = I2C_XFER_QUEUED;
+    xfer->nacks = 0;
+    xfer->bus_errors = 0;
+    xfer->arb_lost = 0;
+    xfer->timeouts = 0;
+    xfer->bus_cycles = 0;
+    xfer->len = len;
+    xfer->buf = xfer->data;
+    xfer->callback = cb;
+    xfer->ctx = ctx;
+    return xfer;
+}
+
+static uint8_t commit_xfer(I2cXfer_t* xfer) {
+    I2cBus_t* b = &buses[xfer->bus];
+    xfer->submit_tick = HAL_GetTick();
+
+    uint32_t primask = bus_lock();
+    b->q_head++;
+    uint8_t depth = (uint8_t)(b->q_head - b->q_done);
+    start_next(b);
+    bus_unlock(primask);
+
+    b->stats.submitted++;
+    if (depth > b->stats.max_depth) b->stats.max_depth = depth;
+    return 1;
+}
+
+static uint8_t setup_tx(I2cXfer_t* xfer, const uint8_t* data, uint16_t len) {
+    if (len <= I2C_BUS_INLINE_BYTES) {
+        if (len > 0) memcpy(xfer->data, data, len);
+    } else if (data != NULL) {
+        xfer->buf = (uint8_t*)data;     // Caller keeps it valid until callback
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+static uint8_t setup_rx(I2cXfer_t* xfer, uint8_t* buf, uint16_t len) {
+    if (buf != NULL) {
+        xfer->buf = buf;
+    } else if (len > I2C_BUS_INLINE_BYTES) {
+        return 0;
+    }
+    return 1;
+}
+
+static void process_bus(I2cBus_t* b) {
+    // Watchdog on the active transfer (slave stretching SCL forever, lost IRQ)
+    uint32_t primask = bus_lock();
+    if (b->bus_active) {
+        I2cXfer_t* xfer = &b->queue[b->q_run & QUEUE_MASK];
+        if (HAL_GetTick() - xfer->start_tick > I2C_BUS_XFER_TIMEOUT_MS) {
+            __HAL_I2C_DISABLE_IT(b->handle, I2C_IT_EVT | I2C_IT_BUF | I2C_IT_ERR);
+            b->stats.timeouts++;
+            xfer->timeouts++;
+            finish_active(b, I2C_XFER_TIMEOUT);
+        }
+    }
+    bus_unlock(primask);
+
+    if (b->recovery_needed) {
+        i2c_recovery(b);
+        primask = bus_lock();
+        b->recovery_needed = 0;
+        start_next(b);
+        bus_unlock(primask);
+    }
+
+    // Dispatch completed transfers in submission order
+    while (b->q_done != b->q_run) {
+        I2cXfer_t* xfer = &b->queue[b->q_done & QUEUE_MASK];
+        uint32_t latency = xfer->done_tick - xfer->submit_tick;
+
+        if (xfer->status == I2C_XFER_OK) {
+            b->stats.completed++;
+            b->stats.wire_bytes += xfer->len + 1;
+            if (xfer->type == I2C_XFER_MEM_WRITE) b->stats.wire_bytes += 1;     // Register byte
+            if (xfer->type == I2C_XFER_MEM_READ) b->stats.wire_bytes += 2;      // Register + re-addressing
+        } else {
+            b->stats.failed++;
+        }
+        if (latency > b->stats.max_latency_ms) b->stats.max_latency_ms = latency;
+
+        if (xfer->callback != NULL) {
+            xfer->callback(xfer);
+        }
+        b->q_done++;
+    }
+
+    // Restart the engine if a start was refused while the bus was busy or
+    // at the other speed
+    primask = bus_lock();
+    apply_speed(b);
+    start_next(b);
+    bus_unlock(primask);
+    check_blocked(b);
+}
+
+// Public functions
+void i2c_bus_init(uint8_t bus, I2C_HandleTypeDef* hi2c, const I2cBusPins_t* pins) {
+    if (bus >= I2C_BUS_COUNT) return;
+
+    I2cBus_t* b = &buses[bus];
+    memset(b, 0, sizeof(*b));
+    b->handle = hi2c;
+    b->pins = pins;
+
+    // Cycle counter for recovery and transfer timing
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+void i2c_bus_process(void) {
+    for (uint8_t i = 0; i < I2C_BUS_COUNT; i++) {
+        if (buses[i].handle != NULL) process_bus(&buses[i]);
+    }
+}
+
+uint8_t i2c_bus_submit_write(uint8_t bus, uint8_t addr, const uint8_t* data, uint16_t len,
+                             I2cXferCallback_t cb, void* ctx) {
+    I2cXfer_t* xfer = alloc_xfer(bus, addr, I2C_XFER_WRITE, len, cb, ctx);
+    if (xfer == NULL || !setup_tx(xfer, data, len)) return 0;
+    return commit_xfer(xfer);
+}
+
+uint8_t i2c_bus_submit_read(uint8_t bus, uint8_t addr, uint8_t* buf, uint16_t len,
+                            I2cXferCallback_t cb, void* ctx) {
+    I2cXfer_t* xfer = alloc_xfer(bus, addr, I2C_XFER_READ, len, cb, ctx);
+    if (xfer == NULL || !setup_rx(xfer, buf, len)) return 0;
+    return commit_xfer(xfer);
+}
+
+uint8_t i2c_bus_submit_mem_write(uint8_t bus, uint8_t addr, uint8_t mem_addr, const uint8_t* data,
+                                 uint16_t len, I2cXferCallback_t cb, void* ctx) {
+    I2cXfer_t* xfer = alloc_xfer(bus, addr, I2C_XFER_MEM_WRITE, len, cb, ctx);
+    if (xfer == NULL || !setup_tx(xfer, data, len)) return 0;
+    xfer->mem_addr = mem_addr;
+    return commit_xfer(xfer);
+}
+
+uint8_t i2c_bus_submit_mem_read(uint8_t bus, uint8_t addr, uint8_t mem_addr, uint8_t* buf,
+                                uint16_t len, I2cXferCallback_t cb, void* ctx) {
+    I2cXfer_t* xfer = alloc_xfer(bus, addr, I2C_XFER_MEM_READ, len, cb, ctx);
+    if (xfer == NULL || !setup_rx(xfer, buf, len)) return 0;
+    xfer->mem_addr = mem_addr;
+    return commit_xfer(xfer);
+}
+
+uint8_t i2c_bus_submit_probe(uint8_t bus, uint8_t addr, I2cXferCallback_t cb, void* ctx) {
+    I2cXfer_t* xfer = alloc_xfer(bus, addr, I2C_XFER_WRITE, 0, cb, ctx);
+    if (xfer == NULL) return 0;
+    xfer->attempts_left = 1;    // A NACK is the answer, not an error to retry
+    return commit_xfer(xfer);
+}
+
+void i2c_bus_set_device_slow(uint8_t bus, uint8_t addr, uint8_t slow) {
+    I2cBus_t* b = bus_get(bus);
+    if (b == NULL) return;
+
+    uint8_t addr7 = addr >> 1;
+    if (slow) {
+        b->slow_devices[addr7 >> 3] |= (1 << (addr7 & 7));
+    } else {
+        b->slow_devices[addr7 >> 3] &= ~(1 << (addr7 & 7));
+    }
+}
+
+uint8_t i2c_bus_device_is_slow(uint8_t bus, uint8_t addr) {
+    I2cBus_t* b = bus_get(bus);
+    return (b != NULL) ? device_is_slow(b, addr) : 0;
+}
+
+uint8_t i2c_bus_is_ready(uint8_t bus) {
+    return bus_get(bus) != NULL;
+}
+
+uint8_t i2c_bus_is_idle(uint8_t bus) {
+    I2cBus_t* b = bus_get(bus);
+    return (b == NULL) || ((b->q_done == b->q_head) && !b->bus_active);
+}
+
+uint8_t i2c_bus_pending(uint8_t bus) {
+    I2cBus_t* b = bus_get(bus);
+    return (b != NULL) ? (uint8_t)(b->q_head - b->q_done) : 0;
+}
+
+uint32_t i2c_bus_clock_hz(uint8_t bus) {
+    I2cBus_t* b = bus_get(bus);
+    return (b != NULL) ? b->handle->Init.ClockSpeed : 0;
+}
+
+const I2cBusStats_t* i2c_bus_get_stats(uint8_t bus) {
+    return (bus < I2C_BUS_COUNT) ? &buses[bus].stats : NULL;
+}
+
+// HAL callbacks (ISR context) - shared by all buses, routed by handle
+static void xfer_complete(I2C_HandleTypeDef* hi2c) {
+    I2cBus_t* b = bus_from_handle(hi2c);
+    if (b != NULL && b->bus_active) finish_active(b, I2C_XFER_OK);
+}
+
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef* hi2c) {
+    xfer_complete(hi2c);
+}
+
+void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef* hi2c) {
+    xfer_complete(hi2c);
+}
+
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef* hi2c) {
+    xfer_complete(hi2c);
+}
+
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef* hi2c) {
+    xfer_complete(hi2c);
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c) {
+    I2cBus_t* b = bus_from_handle(hi2c);
+    if (b == NULL || !b->bus_active) return;
+
+    // A plain NACK leaves the bus clean (HAL already sent STOP)
+    uint32_t error = HAL_I2C_GetError(hi2c);
+    if (error & HAL_I2C_ERROR_ARLO) b->queue[b->q_run & QUEUE_MASK].arb_lost++;
+    finish_active(b, (error == HAL_I2C_ERROR_AF) ? I2C_XFER_NACK : I2C_XFER_BUS_ERROR);
+}
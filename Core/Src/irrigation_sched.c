@@ -0,0 +1,161 @@
+/*
+ * irrigation_sched.c
+ *
+ * Two binary min-heaps drive irrigation:
+ * - events:  each zone's next pump start or stop, ordered by due tick.
+ *   The control loop pops only the events that are due, so a cycle with
+ *   nothing due costs one comparison against the heap root however many
+ *   zones exist.
+ * - waiting: starts that came due but are held for a free pump slot,
+ *   ordered by priority, then by how long they have waited.
+ * A zone has at most one entry per heap; an address -> heap slot map lets
+ * a profile change move or drop it in O(log N) without searching.
+ *
+ * Entries hold the zone address, not an index: zone slots move when a
+ * zone is removed. Discovery cancels a dropped zone's entries, so a heap
+ * never holds more than ZONE_MAX entries.
+ */
+
+#include "irrigation_sched.h"
+#include <string.h>
+
+typedef struct {
+    uint32_t tick;                      // Due tick, or tick the start was queued
+    uint8_t  priority;                  // 0 first; always 0 in the event heap
+    uint8_t  addr;
+} SchedEntry_t;
+
+typedef struct {
+    SchedEntry_t entries[ZONE_MAX];
+    uint16_t count;                     // Child slots 2 * slot + 2 pass 255 for ZONE_MAX > 127
+    uint8_t pos[128];                   // addr -> heap slot, ZONE_NONE if absent
+} SchedHeap_t;
+
+// Private state
+static SchedHeap_t events;
+static SchedHeap_t waiting;
+
+// Priority first, then the wrap-safe earlier tick
+static inline uint8_t before(const SchedEntry_t* a, const SchedEntry_t* b) {
+    if (a->priority != b->priority) return a->priority < b->priority;
+    return (int32_t)(a->tick - b->tick) < 0;
+}
+
+static void place(SchedHeap_t* h, uint16_t slot, SchedEntry_t entry) {
+    h->entries[slot] = entry;
+    h->pos[entry.addr] = slot;
+}
+
+static void sift_up(SchedHeap_t* h, uint16_t slot) {
+    SchedEntry_t entry = h->entries[slot];
+
+    while (slot > 0) {
+        uint16_t parent = (slot - 1) / 2;
+        if (!before(&entry, &h->entries[parent])) break;
+        place(h, slot, h->entries[parent]);
+        slot = parent;
+    }
+    place(h, slot, entry);
+}
+
+static void sift_down(SchedHeap_t* h, uint16_t slot) {
+    SchedEntry_t entry = h->entries[slot];
+
+    for (;;) {
+        uint16_t child = 2 * slot + 1;
+        if (child >= h->count) break;
+        if (child + 1 < h->count && before(&h->entries[child + 1], &h->entries[child])) child++;
+        if (!before(&h->entries[child], &entry)) break;
+        place(h, slot, h->entries[child]);
+        slot = child;
+    }
+    place(h, slot, entry);
+}
+
+static void remove_slot(SchedHeap_t* h, uint16_t slot) {
+    h->pos[h->entries[slot].addr] = ZONE_NONE;
+    h->count--;
+    if (slot == h->count) return;
+
+    // Last entry fills the hole and moves whichever way its key needs
+    SchedEntry_t moved = h->entries[h->count];
+    place(h, slot, moved);
+    sift_up(h, slot);
+    sift_down(h, h->pos[moved.addr]);
+}
+
+// Insert, or move an existing entry to its new key
+static void heap_set(SchedHeap_t* h, uint8_t addr, uint32_t tick, uint8_t priority) {
+    if (addr >= 128) return;
+
+    SchedEntry_t entry = {tick, priority, addr};
+    uint16_t slot = h->pos[addr];
+    if (slot == ZONE_NONE) {
+        if (h->count >= ZONE_MAX) return;
+        slot = h->count++;
+        place(h, slot, entry);
+        sift_up(h, slot);
+        return;
+    }
+
+    uint8_t up = before(&entry, &h->entries[slot]);
+    h->entries[slot] = entry;
+    if (up) {
+        sift_up(h, slot);
+    } else {
+        sift_down(h, slot);
+    }
+}
+
+static void heap_cancel(SchedHeap_t* h, uint8_t addr) {
+    if (addr < 128 && h->pos[addr] != ZONE_NONE) remove_slot(h, h->pos[addr]);
+}
+
+static void heap_init(SchedHeap_t* h) {
+    h->count = 0;
+    memset(h->pos, ZONE_NONE, sizeof(h->pos));
+}
+
+// Public functions
+void irrigation_sched_init(void) {
+    heap_init(&events);
+    heap_init(&waiting);
+}
+
+void irrigation_sched_set(uint8_t addr, uint32_t due_tick) {
+    heap_set(&events, addr, due_tick, 0);
+}
+
+void irrigation_sched_cancel(uint8_t addr) {
+    heap_cancel(&events, addr);
+    heap_cancel(&waiting, addr);
+}
+
+uint8_t irrigation_sched_pop_due(uint32_t now) {
+    if (events.count == 0 || (int32_t)(now - events.entries[0].tick) < 0) return ZONE_NONE;
+
+    uint8_t addr = events.entries[0].addr;
+    remove_slot(&events, 0);
+    return addr;
+}
+
+uint8_t irrigation_sched_count(void) {
+    return events.count;
+}
+
+void irrigation_sched_enqueue(uint8_t addr, uint8_t priority, uint32_t due_tick) {
+    heap_set(&waiting, addr, due_tick, priority);
+}
+
+uint8_t irrigation_sched_dequeue(uint32_t* due_tick) {
+    if (waiting.count == 0) return ZONE_NONE;
+
+    uint8_t addr = waiting.entries[0].addr;
+    *due_tick = waiting.entries[0].tick;
+    remove_slot(&waiting, 0);
+    return addr;
+}
+
+uint8_t irrigation_sched_waiting(void) {
+    return waiting.count;
+}
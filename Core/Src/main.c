@@ -25,7 +25,10 @@
 #include "menu.h"
 #include "node_controller.h"
 #include "plant_profiles.h"
+#include "profile_store.h"
 #include "uart_comm.h"
+#include "i2c_bus.h"
+#include "zone_discovery.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -35,6 +38,11 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
+// IWDG timeout as configured in MX_IWDG_Init() (prescaler 128, reload
+// 4095), taken at the fastest LSI (47 kHz): a profile log compaction
+// must fit in it, or enabling the watchdog resets mid-erase
+#define IWDG_MIN_TIMEOUT_MS  (4096UL * 128 * 1000 / 47000)
+_Static_assert(IWDG_MIN_TIMEOUT_MS > PROFILE_STORE_COMPACT_MAX_MS, "IWDG would expire during a compaction");
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -44,6 +52,8 @@
 
 /* Private variables ---------------------------------------------------------*/
 I2C_HandleTypeDef hi2c1;
+I2C_HandleTypeDef hi2c2;
+I2C_HandleTypeDef hi2c3;
 
 IWDG_HandleTypeDef hiwdg;
 
@@ -53,6 +63,16 @@ UART_HandleTypeDef huart2;
 
 volatile uint32_t stack_canary = 0xDEADBEEF;
 
+static const I2cBusPins_t i2c1_pins = {
+    I2C1_SCL_GPIO_Port, I2C1_SCL_Pin, I2C1_SDA_GPIO_Port, I2C1_SDA_Pin
+};
+static const I2cBusPins_t i2c2_pins = {
+    I2C2_SCL_GPIO_Port, I2C2_SCL_Pin, I2C2_SDA_GPIO_Port, I2C2_SDA_Pin
+};
+static const I2cBusPins_t i2c3_pins = {
+    I2C3_SCL_GPIO_Port, I2C3_SCL_Pin, I2C3_SDA_GPIO_Port, I2C3_SDA_Pin
+};
+
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -60,6 +80,8 @@ void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
 static void MX_USART2_UART_Init(void);
 static void MX_I2C1_Init(void);
+static void MX_I2C2_Init(void);
+static void MX_I2C3_Init(void);
 static void MX_IWDG_Init(void);
 /* USER CODE BEGIN PFP */
 
@@ -100,16 +122,22 @@ int main(void)
   MX_GPIO_Init();
   MX_USART2_UART_Init();
   MX_I2C1_Init();
+  MX_I2C2_Init();
+  MX_I2C3_Init();
 //  MX_IWDG_Init();
   /* USER CODE BEGIN 2 */
-  ssd1306_init();
+  i2c_bus_init(I2C_BUS_1, &hi2c1, &i2c1_pins);
+  i2c_bus_init(I2C_BUS_2, &hi2c2, &i2c2_pins);
+  i2c_bus_init(I2C_BUS_3, &hi2c3, &i2c3_pins);
+  ssd1306_init(OLED_I2C_BUS);
   ssd1306_clear();
-  ssd1306_update();
   keypad_init();
   menu_init();
   plant_profiles_init();
-  node_controller_init(&hi2c1);
+  node_controller_init();
+  zone_discovery_boot_scan();
   uart_comm_init(&huart2);
+  uart_comm_send_discovery_report();
 
   ssd1306_clear();
   ssd1306_print(10, 0, "WELCOME");
@@ -119,7 +147,15 @@ int main(void)
   ssd1306_print(5, 40, "SMART GREENHOUSE PR.");
   ssd1306_print(5, 50, "PRESS ANY KEY!");
   ssd1306_update();
-  while(!keypad_read());
+
+  // Only a power-on waits here; after a watchdog, canary or pin reset the
+  // zones already resumed their saved state and control goes on directly
+  if (__HAL_RCC_GET_FLAG(RCC_FLAG_PORRST)) {
+      while(!keypad_read()) {
+          i2c_bus_process();
+      }
+  }
+  __HAL_RCC_CLEAR_RESET_FLAGS();
 
   /* USER CODE END 2 */
 
@@ -135,10 +171,11 @@ int main(void)
 	    static uint32_t last_sensor_read = 0;
 	    static uint32_t last_display_update = 0;
 	    static uint32_t last_uart_time = 0;
-	    static uint16_t adc1[3] = {0};
-	    static uint16_t adc2[3] = {0};
 	    uint32_t current_time = HAL_GetTick();
 
+	    // Complete queued I2C transfers (sensor data, command acks, OLED)
+	    i2c_bus_process();
+
 	    // Read keypad
 	    uint8_t current_key = keypad_read();
 
@@ -148,39 +185,46 @@ int main(void)
 	    // Handle manual control commands
 	    if (menu_is_manual_mode()) {
 	        uint8_t manual_key = menu_get_last_manual_key();
-	        if (manual_key >= 1 && manual_key <= 8) {
-	        	uint8_t node = (manual_key - 1) / 4;
-	        	uint8_t actuator = ((manual_key - 1) % 4);
-	        	uint8_t command = 0x01 + actuator;  // 0x01=pump, 0x02=fan, 0x03=light1, 0x04=light2
-	        	node_controller_send_manual_command(node, command);
+	        if (manual_key >= 1 && manual_key <= 4) {
+	        	uint8_t addr = menu_get_manual_node();
+	        	uint8_t command = 0x01 + (manual_key - 1);  // 0x01=pump, 0x02=humid, 0x03=fan, 0x04=light1
+	        	node_controller_send_manual_command(addr, command);
 	            menu_clear_manual_key();
 	        }
 	    }
 
-	    // Read sensors every 500ms
+	    // Queue sensor reads every 1500ms (results arrive via i2c_bus_process)
 	    if (current_time - last_sensor_read >= 1500) {
-	        node_controller_read_sensors(0, adc1);
-	        HAL_Delay(100);
-	        node_controller_read_sensors(1, adc2);
+	        node_controller_poll_sensors();
 	        last_sensor_read = current_time;
 	    }
+	    node_controller_process();
+
+	    // Background hot-plug probe (rate-limited to a share of bus time)
+	    zone_discovery_process();
 
 	    // Run automatic control
 	    if (!menu_is_manual_mode()) {
-	        node_controller_update(adc1, adc2);
+	        node_controller_update();
 	    }
 
+	    // Profile log compaction stalls the CPU for seconds: only with no
+	    // pump running and nothing on the buses
+	    profile_store_process(node_controller_is_idle() && i2c_bus_is_idle(I2C_BUS_1) &&
+	                          i2c_bus_is_idle(I2C_BUS_2) && i2c_bus_is_idle(I2C_BUS_3));
+
 	    // Update display every 250ms
 	    if (current_time - last_display_update >= 500) {
-	        menu_display(adc1, adc2);
+	        menu_display();
 	        last_display_update = current_time;
 	    }
 
-	    // Send UART data every 1000ms
+	    // Send UART data every 2000ms (one zone line per free UART slot)
 	    if (current_time - last_uart_time >= 2000) {
-	        uart_comm_send_status(adc1, adc2);
+	        uart_comm_send_status();
 	        last_uart_time = current_time;
 	    }
+	    uart_comm_process();
 
 //	    HAL_IWDG_Refresh(&hiwdg);
 	    HAL_Delay(50);
@@ -249,7 +293,7 @@ static void MX_I2C1_Init(void)
 
   /* USER CODE END I2C1_Init 1 */
   hi2c1.Instance = I2C1;
-  hi2c1.Init.ClockSpeed = 100000;
+  hi2c1.Init.ClockSpeed = 400000;
   hi2c1.Init.DutyCycle = I2C_DUTYCYCLE_2;
   hi2c1.Init.OwnAddress1 = 0;
   hi2c1.Init.AddressingMode = I2C_ADDRESSINGMODE_7BIT;
@@ -267,6 +311,74 @@ static void MX_I2C1_Init(void)
 
 }
 
+/**
+  * @brief I2C2 Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_I2C2_Init(void)
+{
+
+  /* USER CODE BEGIN I2C2_Init 0 */
+
+  /* USER CODE END I2C2_Init 0 */
+
+  /* USER CODE BEGIN I2C2_Init 1 */
+
+  /* USER CODE END I2C2_Init 1 */
+  hi2c2.Instance = I2C2;
+  hi2c2.Init.ClockSpeed = 400000;
+  hi2c2.Init.DutyCycle = I2C_DUTYCYCLE_2;
+  hi2c2.Init.OwnAddress1 = 0;
+  hi2c2.Init.AddressingMode = I2C_ADDRESSINGMODE_7BIT;
+  hi2c2.Init.DualAddressMode = I2C_DUALADDRESS_DISABLE;
+  hi2c2.Init.OwnAddress2 = 0;
+  hi2c2.Init.GeneralCallMode = I2C_GENERALCALL_DISABLE;
+  hi2c2.Init.NoStretchMode = I2C_NOSTRETCH_DISABLE;
+  if (HAL_I2C_Init(&hi2c2) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  /* USER CODE BEGIN I2C2_Init 2 */
+
+  /* USER CODE END I2C2_Init 2 */
+
+}
+
+/**
+  * @brief I2C3 Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_I2C3_Init(void)
+{
+
+  /* USER CODE BEGIN I2C3_Init 0 */
+
+  /* USER CODE END I2C3_Init 0 */
+
+  /* USER CODE BEGIN I2C3_Init 1 */
+
+  /* USER CODE END I2C3_Init 1 */
+  hi2c3.Instance = I2C3;
+  hi2c3.Init.ClockSpeed = 400000;
+  hi2c3.Init.DutyCycle = I2C_DUTYCYCLE_2;
+  hi2c3.Init.OwnAddress1 = 0;
+  hi2c3.Init.AddressingMode = I2C_ADDRESSINGMODE_7BIT;
+  hi2c3.Init.DualAddressMode = I2C_DUALADDRESS_DISABLE;
+  hi2c3.Init.OwnAddress2 = 0;
+  hi2c3.Init.GeneralCallMode = I2C_GENERALCALL_DISABLE;
+  hi2c3.Init.NoStretchMode = I2C_NOSTRETCH_DISABLE;
+  if (HAL_I2C_Init(&hi2c3) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  /* USER CODE BEGIN I2C3_Init 2 */
+
+  /* USER CODE END I2C3_Init 2 */
+
+}
+
 /**
   * @brief IWDG Initialization Function
   * @param None
@@ -348,7 +460,7 @@ static void MX_GPIO_Init(void)
   HAL_GPIO_WritePin(GPIOA, GPIO_PIN_4|GPIO_PIN_5|GPIO_PIN_6|GPIO_PIN_7, GPIO_PIN_RESET);
 
   /*Configure GPIO pin Output Level */
-  HAL_GPIO_WritePin(GPIOB, GPIO_PIN_0|GPIO_PIN_1|GPIO_PIN_4|GPIO_PIN_8, GPIO_PIN_RESET);
+  HAL_GPIO_WritePin(GPIOB, GPIO_PIN_0|GPIO_PIN_1|GPIO_PIN_8, GPIO_PIN_RESET);
 
   /*Configure GPIO pin : PA0 */
   GPIO_InitStruct.Pin = GPIO_PIN_0;
@@ -363,8 +475,8 @@ static void MX_GPIO_Init(void)
   GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
   HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
 
-  /*Configure GPIO pins : PB0 PB1 PB4 */
-  GPIO_InitStruct.Pin = GPIO_PIN_0|GPIO_PIN_1|GPIO_PIN_4;
+  /*Configure GPIO pins : PB0 PB1 */
+  GPIO_InitStruct.Pin = GPIO_PIN_0|GPIO_PIN_1;
   GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
   GPIO_InitStruct.Pull = GPIO_NOPULL;
   GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
@@ -1,6 +1,7 @@
 #include "menu.h"
 #include "plant_profiles.h"
 #include "node_controller.h"
+#include "calibration.h"
 #include "ssd1306.h"
 #include <string.h>
 #include <stdio.h>
@@ -10,29 +11,211 @@ typedef enum {
     MENU_SELECT_NODE,
     MENU_SELECT_PROFILE,
     MENU_VIEW_STATUS,
-    MENU_MANUAL_CONTROL
+    MENU_MANUAL_CONTROL,
+    MENU_DIAGNOSTICS,
+    MENU_EDIT_PROFILE,
+    MENU_CALIBRATE
 } MenuState_t;
 
 // Private state
 static MenuState_t menu_state = MENU_MAIN;
 static uint8_t cursor_position = 0;      // Which item cursor is on (0-3 on screen)
 static uint8_t scroll_offset = 0;        // First item shown on screen
-static uint8_t selected_node = 0;
+static uint8_t selected_addr = 0;        // I2C address: table indices shift as zones come and go
 static uint8_t manual_mode = 0;
 static uint8_t last_manual_key = 0;
+static uint8_t editing = 0;              // MENU_SELECT_PROFILE picks a profile to edit, not assign
+static uint8_t edit_index = 0;
+static uint8_t edit_error = 0;           // Last save failed
+static PlantProfile_t edit_buf;          // Working copy, written back on save
+static uint8_t calibrating = 0;          // MENU_SELECT_NODE picks a zone to calibrate, not assign
+static uint8_t cal_curve_buf[ZONE_MAX_CHANNELS];   // Working copy of the selected zone's
+static int16_t cal_trim_buf[ZONE_MAX_CHANNELS];    // calibration, saved per changed channel
 
 #define ITEMS_PER_SCREEN 4
+#define ZONES_PER_STATUS_SCREEN 2
+
+// Latency histogram on the diagnostics screen: one bar per bucket
+#define HIST_X       104
+#define HIST_Y_BASE  50
+#define HIST_HEIGHT  36
+#define HIST_BAR_W   3
+
+// Profile editor fields: the three irrigation values, then threshold and
+// band of every rule
+#define EDIT_FIXED_FIELDS  3
+#define EDIT_RULE_STEP     10            // Engineering units per key press (1 %RH, 1 degC, 100 lux)
+
+// Calibration screen: curve and trim of every channel of the zone
+#define CAL_TRIM_STEP      5             // 0.5 %RH, 0.5 degC, 50 lux
+
+static const char* const curve_names[CAL_CURVE_COUNT] = {"DEF", "RAW", "HIH4000", "NTC10K", "LDR"};
+
+// The selected zone, or the first one if it left the table
+static Zone_t* selected_zone(void) {
+    Zone_t* zone = zone_table_lookup(selected_addr);
+    if (zone == NULL && (zone = zone_table_get(0)) != NULL) selected_addr = zone->addr;
+    return zone;
+}
+
+static void select_neighbour(uint8_t key) {
+    if (selected_zone() == NULL) return;
+
+    uint8_t index = zone_table_find(selected_addr);
+
+    if (key == 13 && index > 0) {
+        selected_addr = zone_table_get(index - 1)->addr;
+    } else if (key == 14 && index + 1 < zone_table_count()) {
+        selected_addr = zone_table_get(index + 1)->addr;
+    }
+}
 
 static void reset_cursor(void) {
     cursor_position = 0;
     scroll_offset = 0;
 }
 
+// UP/DOWN handling shared by every scrolling list
+static void list_move(uint8_t key, uint8_t total_items) {
+    if (key == 13) {  // UP arrow
+        if (cursor_position > 0) {
+            cursor_position--;
+        } else if (scroll_offset > 0) {
+            scroll_offset--;
+        }
+    } else if (key == 14) {  // DOWN arrow
+        uint8_t visible_items = (total_items - scroll_offset < ITEMS_PER_SCREEN)
+                                ? (total_items - scroll_offset) : ITEMS_PER_SCREEN;
+
+        if (cursor_position + 1 < visible_items) {
+            cursor_position++;
+        } else if (scroll_offset + ITEMS_PER_SCREEN < total_items) {
+            scroll_offset++;
+        }
+    }
+}
+
+static void draw_scroll_indicators(uint8_t total_items) {
+    if (scroll_offset > 0) {
+        ssd1306_print(120, 15, "^");  // More items above
+    }
+    if (scroll_offset + ITEMS_PER_SCREEN < total_items) {
+        ssd1306_print(120, 45, "v");  // More items below
+    }
+}
+
+static const char* zone_profile_name(Zone_t* zone) {
+    return (zone->assigned_profile != PROFILE_NONE) ?
+           get_profile_name(zone->assigned_profile) : "NONE";
+}
+
+static uint8_t edit_field_count(void) {
+    return EDIT_FIXED_FIELDS + 2 * edit_buf.rule_count;
+}
+
+static void edit_field_label(uint8_t field, char* buf, uint8_t size) {
+    static const char* const fixed[EDIT_FIXED_FIELDS] = {"INTERVAL", "DURATION", "PRIORITY"};
+
+    if (field < EDIT_FIXED_FIELDS) {
+        snprintf(buf, size, "%s", fixed[field]);
+    } else {
+        uint8_t rule = (field - EDIT_FIXED_FIELDS) / 2;
+        snprintf(buf, size, "R%d %s", rule + 1, ((field - EDIT_FIXED_FIELDS) & 1) ? "BAND" : "THR");
+    }
+}
+
+static int32_t edit_field_value(uint8_t field) {
+    switch (field) {
+        case 0: return edit_buf.irrigation_interval_sec;
+        case 1: return edit_buf.irrigation_duration_sec;
+        case 2: return edit_buf.irrigation_priority;
+    }
+    ControlRule_t* rule = &edit_buf.rules[(field - EDIT_FIXED_FIELDS) / 2];
+    return ((field - EDIT_FIXED_FIELDS) & 1) ? rule->band : rule->threshold;
+}
+
+// key 11 steps down, 12 up; each field clamps to its type's range
+static void edit_field_step(uint8_t field, uint8_t key) {
+    int32_t step = (field < EDIT_FIXED_FIELDS) ? 1 : EDIT_RULE_STEP;
+    int32_t value = edit_field_value(field) + ((key == 12) ? step : -step);
+
+    if (field < EDIT_FIXED_FIELDS) {
+        if (value < 0) value = 0;
+        if (value > 255) value = 255;
+        if (field == 0) edit_buf.irrigation_interval_sec = value;
+        else if (field == 1) edit_buf.irrigation_duration_sec = value;
+        else edit_buf.irrigation_priority = value;
+        return;
+    }
+
+    ControlRule_t* rule = &edit_buf.rules[(field - EDIT_FIXED_FIELDS) / 2];
+    if ((field - EDIT_FIXED_FIELDS) & 1) {
+        if (value < 0) value = 0;
+        if (value > UINT16_MAX) value = UINT16_MAX;
+        rule->band = value;
+    } else {
+        if (value < INT16_MIN) value = INT16_MIN;
+        if (value > INT16_MAX) value = INT16_MAX;
+        rule->threshold = value;
+    }
+}
+
+static uint8_t cal_field_count(void) {
+    Zone_t* zone = selected_zone();
+    return (zone != NULL) ? 2 * zone->channel_count : 0;
+}
+
+// key 11 steps down, 12 up; curves wrap, trims clamp to int16
+static void cal_field_step(uint8_t field, uint8_t key) {
+    uint8_t channel = field / 2;
+
+    if (channel >= ZONE_MAX_CHANNELS) return;
+    if ((field & 1) == 0) {
+        uint8_t curve = cal_curve_buf[channel];
+        cal_curve_buf[channel] = (key == 12) ? (curve + 1) % CAL_CURVE_COUNT
+                                             : (curve + CAL_CURVE_COUNT - 1) % CAL_CURVE_COUNT;
+    } else {
+        int32_t trim = cal_trim_buf[channel] + ((key == 12) ? CAL_TRIM_STEP : -CAL_TRIM_STEP);
+        if (trim < INT16_MIN) trim = INT16_MIN;
+        if (trim > INT16_MAX) trim = INT16_MAX;
+        cal_trim_buf[channel] = trim;
+    }
+}
+
+// Applies and saves every changed channel; 0 if any could not be saved
+static uint8_t cal_save(void) {
+    Zone_t* zone = selected_zone();
+    uint8_t ok = 1;
+
+    if (zone == NULL) return 0;
+    for (uint8_t ch = 0; ch < zone->channel_count; ch++) {
+        if (cal_curve_buf[ch] == zone->cal_curve[ch] && cal_trim_buf[ch] == zone->cal_offset[ch]) continue;
+        if (!node_controller_set_calibration(zone->addr, ch, cal_curve_buf[ch], cal_trim_buf[ch])) ok = 0;
+    }
+    return ok;
+}
+
+// Bars scaled to the fullest bucket, so the shape shows however long it ran
+static void draw_latency_hist(const ZoneLink_t* link) {
+    uint32_t peak = 0;
+    for (uint8_t i = 0; i < ZONE_LATENCY_BUCKETS; i++) {
+        if (link->latency_hist[i] > peak) peak = link->latency_hist[i];
+    }
+    if (peak == 0) return;
+
+    for (uint8_t i = 0; i < ZONE_LATENCY_BUCKETS; i++) {
+        uint8_t h = (uint8_t)((link->latency_hist[i] * HIST_HEIGHT + peak - 1) / peak);
+        if (h > 0) ssd1306_fill_rect(HIST_X + i * HIST_BAR_W, HIST_Y_BASE - h, HIST_BAR_W - 1, h);
+    }
+}
+
 void menu_init(void) {
     menu_state = MENU_MAIN;
     reset_cursor();
-    selected_node = 0;
+    selected_addr = 0;
     manual_mode = 0;
+    editing = 0;
+    calibrating = 0;
 }
 
 void menu_process_key(uint8_t key) {
@@ -57,62 +240,144 @@ void menu_process_key(uint8_t key) {
                     reset_cursor();
                 } else if (key == 4) {
                     manual_mode = !manual_mode;
+                } else if (key == 5) {
+                    menu_state = MENU_DIAGNOSTICS;
+                    reset_cursor();
+                } else if (key == 6) {
+                    editing = 1;
+                    menu_state = MENU_SELECT_PROFILE;
+                    reset_cursor();
+                } else if (key == 7) {
+                    calibrating = 1;
+                    menu_state = MENU_SELECT_NODE;
+                    reset_cursor();
                 }
                 break;
 
-            case MENU_SELECT_NODE:
-                if (key == 1 || key == 2) {
-                    selected_node = key - 1;
-                    menu_state = MENU_SELECT_PROFILE;
-                    reset_cursor();
+            case MENU_SELECT_NODE: {
+                uint8_t total_zones = zone_table_count();
+
+                if (key == 13 || key == 14) {
+                    list_move(key, total_zones);
+                } else if (key == 15) {  // SELECT/ENTER
+                    uint8_t absolute_index = scroll_offset + cursor_position;
+                    if (absolute_index < total_zones) {
+                        Zone_t* zone = zone_table_get(absolute_index);
+                        selected_addr = zone->addr;
+                        if (calibrating) {
+                            memcpy(cal_curve_buf, zone->cal_curve, sizeof(cal_curve_buf));
+                            memcpy(cal_trim_buf, zone->cal_offset, sizeof(cal_trim_buf));
+                            edit_error = 0;
+                        }
+                        menu_state = calibrating ? MENU_CALIBRATE : MENU_SELECT_PROFILE;
+                        reset_cursor();
+                    }
                 } else if (key == 16) {
                     menu_state = MENU_MAIN;
+                    calibrating = 0;
                     reset_cursor();
                 }
                 break;
+            }
 
             case MENU_SELECT_PROFILE: {
                 uint8_t total_profiles = get_num_profiles();
 
-                if (key == 13) {  // UP arrow
-                    if (cursor_position > 0) {
-                        cursor_position--;
-                    } else if (scroll_offset > 0) {
-                        scroll_offset--;
-                    }
-                } else if (key == 14) {  // DOWN arrow
-                    uint8_t visible_items = (total_profiles - scroll_offset < ITEMS_PER_SCREEN)
-                                            ? (total_profiles - scroll_offset) : ITEMS_PER_SCREEN;
-
-                    if (cursor_position < visible_items - 1) {
-                        cursor_position++;
-                    } else if (scroll_offset + ITEMS_PER_SCREEN < total_profiles) {
-                        scroll_offset++;
-                    }
+                if (key == 13 || key == 14) {
+                    list_move(key, total_profiles);
                 } else if (key == 15) {  // SELECT/ENTER
                     uint8_t absolute_index = scroll_offset + cursor_position;
-                    if (absolute_index < total_profiles) {
-                        node_controller_assign_profile(selected_node, absolute_index);
+                    if (absolute_index < total_profiles && editing) {
+                        edit_index = absolute_index;
+                        edit_buf = *get_profile(absolute_index);
+                        edit_error = 0;
+                        menu_state = MENU_EDIT_PROFILE;
+                        reset_cursor();
+                    } else if (absolute_index < total_profiles) {
+                        node_controller_assign_profile(selected_addr, absolute_index);
                         menu_state = MENU_MAIN;
                         reset_cursor();
                     }
                 } else if (key == 16) {  // BACK
-                    menu_state = MENU_SELECT_NODE;
+                    menu_state = editing ? MENU_MAIN : MENU_SELECT_NODE;
+                    editing = 0;
+                    reset_cursor();
+                }
+                break;
+            }
+
+            case MENU_EDIT_PROFILE: {
+                uint8_t field = scroll_offset + cursor_position;
+
+                if (key == 13 || key == 14) {
+                    list_move(key, edit_field_count());
+                } else if (key == 11 || key == 12) {
+                    edit_field_step(field, key);
+                } else if (key == 15) {  // SAVE: applies to RAM and flash
+                    edit_error = !plant_profiles_update(edit_index, &edit_buf);
+                    if (!edit_error) {
+                        menu_state = MENU_MAIN;
+                        editing = 0;
+                        reset_cursor();
+                    }
+                } else if (key == 16) {  // Discard
+                    menu_state = MENU_MAIN;
+                    editing = 0;
+                    reset_cursor();
+                }
+                break;
+            }
+
+            case MENU_CALIBRATE: {
+                uint8_t field = scroll_offset + cursor_position;
+
+                if (key == 13 || key == 14) {
+                    list_move(key, cal_field_count());
+                } else if (key == 11 || key == 12) {
+                    cal_field_step(field, key);
+                } else if (key == 15) {  // SAVE: applies and writes to flash
+                    edit_error = !cal_save();
+                    if (!edit_error) {
+                        menu_state = MENU_MAIN;
+                        calibrating = 0;
+                        reset_cursor();
+                    }
+                } else if (key == 16) {  // Discard
+                    menu_state = MENU_MAIN;
+                    calibrating = 0;
                     reset_cursor();
                 }
                 break;
             }
 
             case MENU_VIEW_STATUS:
-                if (key == 16) {
+                if (key == 13 && scroll_offset >= ZONES_PER_STATUS_SCREEN) {
+                    scroll_offset -= ZONES_PER_STATUS_SCREEN;
+                } else if (key == 14 && scroll_offset + ZONES_PER_STATUS_SCREEN < zone_table_count()) {
+                    scroll_offset += ZONES_PER_STATUS_SCREEN;
+                } else if (key == 16) {
                     menu_state = MENU_MAIN;
                     reset_cursor();
                 }
                 break;
 
             case MENU_MANUAL_CONTROL:
-                if (key >= 1 && key <= 8 && manual_mode) {
+                if (key >= 1 && key <= 4 && manual_mode) {
                     last_manual_key = key;
+                } else if (key == 13 || key == 14) {
+                    select_neighbour(key);
+                } else if (key == 16) {
+                    menu_state = MENU_MAIN;
+                    reset_cursor();
+                }
+                break;
+
+            case MENU_DIAGNOSTICS:
+                // One zone per screen, scroll_offset is the zone's position in the table
+                if (key == 13 && scroll_offset > 0) {
+                    scroll_offset--;
+                } else if (key == 14 && scroll_offset + 1 < zone_table_count()) {
+                    scroll_offset++;
                 } else if (key == 16) {
                     menu_state = MENU_MAIN;
                     reset_cursor();
@@ -124,12 +389,10 @@ void menu_process_key(uint8_t key) {
     }
 }
 
-void menu_display(uint16_t adc1[3], uint16_t adc2[3]) {
+void menu_display(void) {
     ssd1306_clear();
 
     char line_buf[32];
-    NodeState_t* node1 = node_controller_get_state(0);
-    NodeState_t* node2 = node_controller_get_state(1);
 
     switch (menu_state) {
         case MENU_MAIN:
@@ -140,21 +403,41 @@ void menu_display(uint16_t adc1[3], uint16_t adc2[3]) {
             ssd1306_print(5, 35, "3.MANUAL CTRL");
             snprintf(line_buf, sizeof(line_buf), "4.MODE:%s", manual_mode ? "MAN" : "AUTO");
             ssd1306_print(5, 45, line_buf);
+            ssd1306_print(5, 55, "5.DIAG 6.PROF 7.CAL");
             break;
 
-        case MENU_SELECT_NODE:
-            ssd1306_print(5, 0, "SELECT NODE:");
+        case MENU_SELECT_NODE: {
+            uint8_t total_zones = zone_table_count();
+
+            ssd1306_print(5, 0, calibrating ? "CALIBRATE NODE:" : "SELECT NODE:");
             ssd1306_draw_line(0, 10, 128, 10);
-            ssd1306_print(5, 20, "1. NODE 1");
-            ssd1306_print(5, 35, "2. NODE 2");
-            ssd1306_print(5, 50, "16.BACK");
+
+            for (uint8_t i = 0; i < ITEMS_PER_SCREEN && scroll_offset + i < total_zones; i++) {
+                Zone_t* zone = zone_table_get(scroll_offset + i);
+                uint8_t y_pos = 15 + i * 10;
+
+                if (i == cursor_position) {
+                    ssd1306_print(0, y_pos, "->");
+                }
+                snprintf(line_buf, sizeof(line_buf), "N%d %02X %s",
+                         zone_table_node_number(zone->addr), zone->addr, zone_profile_name(zone));
+                ssd1306_print(15, y_pos, line_buf);
+            }
+
+            draw_scroll_indicators(total_zones);
+            ssd1306_print(0, 55, "13^ 14v 15OK 16X");
             break;
+        }
 
         case MENU_SELECT_PROFILE: {
             uint8_t total_profiles = get_num_profiles();
 
-            snprintf(line_buf, sizeof(line_buf), "NODE %d PROFILE:", selected_node + 1);
-            ssd1306_print(5, 0, line_buf);
+            if (editing) {
+                ssd1306_print(5, 0, "EDIT PROFILE:");
+            } else {
+                snprintf(line_buf, sizeof(line_buf), "NODE %d PROFILE:", zone_table_node_number(selected_addr));
+                ssd1306_print(5, 0, line_buf);
+            }
             ssd1306_draw_line(0, 10, 128, 10);
 
             // Calculate how many items to show
@@ -179,13 +462,7 @@ void menu_display(uint16_t adc1[3], uint16_t adc2[3]) {
                 }
             }
 
-            // Show scroll indicators
-            if (scroll_offset > 0) {
-                ssd1306_print(120, 15, "^");  // More items above
-            }
-            if (scroll_offset + ITEMS_PER_SCREEN < total_profiles) {
-                ssd1306_print(120, 45, "v");  // More items below
-            }
+            draw_scroll_indicators(total_profiles);
 
             // Show instructions at bottom
             ssd1306_print(0, 55, "13^ 14v 15OK 16X");
@@ -196,35 +473,138 @@ void menu_display(uint16_t adc1[3], uint16_t adc2[3]) {
             ssd1306_print(5, 0, "SYSTEM STATUS");
             ssd1306_draw_line(0, 10, 128, 10);
 
-            if (node1 != NULL) {
-                snprintf(line_buf, sizeof(line_buf), "N1:%s",
-                    (node1->assigned_profile != 255) ?
-                    get_profile_name(node1->assigned_profile) : "NONE");
-                ssd1306_print(0, 15, line_buf);
-                snprintf(line_buf, sizeof(line_buf), "H:%d T:%d L:%d", adc1[0], adc1[1], adc1[2]);
-                ssd1306_print(0, 25, line_buf);
-            }
-
-            if (node2 != NULL) {
-                snprintf(line_buf, sizeof(line_buf), "N2:%s",
-                    (node2->assigned_profile != 255) ?
-                    get_profile_name(node2->assigned_profile) : "NONE");
-                ssd1306_print(0, 38, line_buf);
-                snprintf(line_buf, sizeof(line_buf), "H:%d T:%d L:%d", adc2[0], adc2[1], adc2[2]);
-                ssd1306_print(0, 48, line_buf);
+            // Two zones per screen, 13/14 pages through the table
+            for (uint8_t i = 0; i < ZONES_PER_STATUS_SCREEN; i++) {
+                Zone_t* zone = zone_table_get(scroll_offset + i);
+                if (zone == NULL) break;
+
+                // Data age in seconds, '!' once control has stopped trusting it
+                uint32_t age = zone_table_data_age(zone, HAL_GetTick());
+                uint8_t y_pos = 15 + i * 23;
+                if (age == ZONE_AGE_NEVER) {
+                    snprintf(line_buf, sizeof(line_buf), "N%d:%s --", zone_table_node_number(zone->addr), zone_profile_name(zone));
+                } else {
+                    snprintf(line_buf, sizeof(line_buf), "N%d:%s %lus%s", zone_table_node_number(zone->addr), zone_profile_name(zone),
+                             (unsigned long)(age / 1000), (age > SENSOR_MAX_AGE_MS) ? "!" : "");
+                }
+                ssd1306_print(0, y_pos, line_buf);
+                // %RH, degC, lux once calibrated (profile assigned), raw counts before
+                if (zone->cal_lut[ZONE_CH_TEMP] != NULL) {
+                    snprintf(line_buf, sizeof(line_buf), "H:%d%% T:%dC L:%ld",
+                             zone->values[ZONE_CH_HUMIDITY] / 10, zone->values[ZONE_CH_TEMP] / 10,
+                             (long)zone->values[ZONE_CH_LIGHT] * 10);
+                } else {
+                    snprintf(line_buf, sizeof(line_buf), "H:%d T:%d L:%d",
+                             zone->sensors[0], zone->sensors[1], zone->sensors[2]);
+                }
+                ssd1306_print(0, y_pos + 10, line_buf);
             }
             ssd1306_print(0, 58, "16.BACK");
             break;
 
-        case MENU_MANUAL_CONTROL:
+        case MENU_MANUAL_CONTROL: {
+            Zone_t* zone = selected_zone();
+
             ssd1306_print(5, 0, "MANUAL CONTROL");
             ssd1306_draw_line(0, 10, 128, 10);
-            ssd1306_print(0, 15, "N1:1-PMP 2-HUM");
-            ssd1306_print(0, 25, "   3-FAN 4-LGT");
-            ssd1306_print(0, 38, "N2:5-PMP 6-HUM");
-            ssd1306_print(0, 48, "   7-FAN 8-LGT");
+            if (zone != NULL) {
+                snprintf(line_buf, sizeof(line_buf), "N%d (%02X) 13^ 14v", zone_table_node_number(zone->addr), zone->addr);
+                ssd1306_print(0, 15, line_buf);
+            }
+            ssd1306_print(0, 28, "1-PMP 2-HUM");
+            ssd1306_print(0, 38, "3-FAN 4-LGT");
             ssd1306_print(0, 58, "16.BACK");
             break;
+        }
+
+        case MENU_EDIT_PROFILE: {
+            uint8_t total_fields = edit_field_count();
+            char label[12];
+
+            snprintf(line_buf, sizeof(line_buf), "%s%s", edit_buf.name, edit_error ? " FLASH ERR" : "");
+            ssd1306_print(5, 0, line_buf);
+            ssd1306_draw_line(0, 10, 128, 10);
+
+            for (uint8_t i = 0; i < ITEMS_PER_SCREEN && scroll_offset + i < total_fields; i++) {
+                uint8_t y_pos = 15 + i * 10;
+
+                if (i == cursor_position) {
+                    ssd1306_print(0, y_pos, "->");
+                }
+                edit_field_label(scroll_offset + i, label, sizeof(label));
+                snprintf(line_buf, sizeof(line_buf), "%-9s%ld", label, (long)edit_field_value(scroll_offset + i));
+                ssd1306_print(15, y_pos, line_buf);
+            }
+
+            draw_scroll_indicators(total_fields);
+            ssd1306_print(0, 55, "11- 12+ 15SAVE 16X");
+            break;
+        }
+
+        case MENU_CALIBRATE: {
+            Zone_t* zone = selected_zone();
+            uint8_t total_fields = cal_field_count();
+
+            if (zone == NULL) break;
+            snprintf(line_buf, sizeof(line_buf), "CAL N%d%s", zone_table_node_number(zone->addr),
+                     edit_error ? " NOT SAVED" : "");
+            ssd1306_print(5, 0, line_buf);
+            ssd1306_draw_line(0, 10, 128, 10);
+
+            for (uint8_t i = 0; i < ITEMS_PER_SCREEN && scroll_offset + i < total_fields; i++) {
+                uint8_t field = scroll_offset + i;
+                uint8_t channel = field / 2;
+                uint8_t y_pos = 15 + i * 10;
+
+                if (i == cursor_position) {
+                    ssd1306_print(0, y_pos, "->");
+                }
+                if ((field & 1) == 0) {
+                    snprintf(line_buf, sizeof(line_buf), "CH%d CURVE %s", channel, curve_names[cal_curve_buf[channel]]);
+                } else {
+                    snprintf(line_buf, sizeof(line_buf), "CH%d TRIM  %d", channel, cal_trim_buf[channel]);
+                }
+                ssd1306_print(15, y_pos, line_buf);
+            }
+
+            draw_scroll_indicators(total_fields);
+            ssd1306_print(0, 55, "11- 12+ 15SAVE 16X");
+            break;
+        }
+
+        case MENU_DIAGNOSTICS: {
+            Zone_t* zone = zone_table_get(scroll_offset);
+
+            if (zone == NULL) {
+                ssd1306_print(5, 0, "BUS DIAG");
+                ssd1306_draw_line(0, 10, 128, 10);
+                ssd1306_print(0, 25, "NO ZONES");
+                ssd1306_print(0, 58, "16.BACK");
+                break;
+            }
+
+            const ZoneLink_t* link = &zone->link;
+            snprintf(line_buf, sizeof(line_buf), "DIAG N%d %02X I2C%d", zone_table_node_number(zone->addr), zone->addr, zone->bus + 1);
+            ssd1306_print(0, 0, line_buf);
+            ssd1306_draw_line(0, 10, 128, 10);
+
+            // Left column text stays clear of the histogram at HIST_X
+            snprintf(line_buf, sizeof(line_buf), "TX%lu R%lu", (unsigned long)link->transfers, (unsigned long)link->retries);
+            ssd1306_print(0, 14, line_buf);
+            snprintf(line_buf, sizeof(line_buf), "NK%lu BE%lu", (unsigned long)link->nacks,
+                     (unsigned long)(link->bus_errors - link->arb_lost - link->timeouts));
+            ssd1306_print(0, 24, line_buf);
+            snprintf(line_buf, sizeof(line_buf), "AL%lu TO%lu", (unsigned long)link->arb_lost, (unsigned long)link->timeouts);
+            ssd1306_print(0, 34, line_buf);
+            snprintf(line_buf, sizeof(line_buf), "US%lu/%lu", (unsigned long)link->last_xfer_us, (unsigned long)link->max_xfer_us);
+            ssd1306_print(0, 44, line_buf);
+            snprintf(line_buf, sizeof(line_buf), "OK %lus ago",
+                     (unsigned long)((HAL_GetTick() - link->last_ok_tick) / 1000));
+            ssd1306_print(0, 55, line_buf);
+
+            draw_latency_hist(link);
+            break;
+        }
     }
 
     ssd1306_update();
@@ -238,6 +618,10 @@ uint8_t menu_get_last_manual_key(void) {
     return last_manual_key;
 }
 
+uint8_t menu_get_manual_node(void) {
+    return (selected_zone() != NULL) ? selected_addr : 0;
+}
+
 void menu_clear_manual_key(void) {
     last_manual_key = 0;
 }
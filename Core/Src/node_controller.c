@@ -2,106 +2,493 @@
  * node_controller.c
  *
  * Manages communication and control logic for irrigation zone controllers.
- * Each zone (ATmega32) has 3 sensors and 4 actuators.
+ * Each zone (ATmega32) is registered in the zone table by its I2C address
+ * (see zone_discovery.c). Nodes differ in width: the first read of a new
+ * zone fetches its capability descriptor (channels, actuators, ADC
+ * resolution, protocol), and every later read is sized from it.
  *
  * Control Strategy:
- * - Scheduled irrigation: Timer-based pump activation
- * - Environmental control: Humidity/temp/light thresholds with hysteresis
- * - I2C communication with automatic recovery on bus errors
+ * - Scheduled irrigation: each zone's next pump start or stop sits in a
+ *   min-heap keyed by due tick (irrigation_sched.c); a control cycle pops
+ *   only the events that are due and schedules the following one
+ * - Environmental control: each profile's rule table (channel, comparator,
+ *   threshold, hysteresis band, actuator), see control_rules.c. Samples
+ *   are median + EMA filtered in one pass over all new snapshots
+ *   (sensor_filter.c), then converted to engineering units by a table
+ *   lookup; the tables are built when a profile is assigned (calibration.c).
+ *   Zones with other sensors get a per-channel curve and trim over the
+ *   UART or keypad, saved with the zone's state
+ * - Shadow state: the loop sets desired actuator bits; a frame goes on the
+ *   bus only when desired differs from what the node confirmed, or on
+ *   the slow ACTUATOR_REFRESH_MS re-sync
+ * - Anti-short-cycle: per-actuator minimum on/off and maximum on times
+ *   hold back rule decisions that would cycle a relay too fast; every
+ *   on/off change of the desired state is counted per zone
+ * - Facility-wide caps: at most max_running pumps (optionally fans) on at
+ *   once. Due irrigation starts queue by profile priority and start
+ *   IRRIGATION_STAGGER_MS apart; each zone reports how long it waited
+ * - PWM outputs under a PI rule (protocol 3 nodes) are left out of the
+ *   on/off frames and get CMD_SET_DUTY frames instead, shadowed the same way
+ * - Legacy nodes (original firmware) drop CMD_SET_ACTUATORS; they get the
+ *   explicit 0x10-0x17 OFF/ON command of each bit instead
+ * - I2C communication through the non-blocking i2c_bus queue
+ *   (retries and bus recovery happen there, never in the control loop)
+ * - Sensor sweeps start with a general-call latch on every bus, so all
+ *   zones report values frozen at the same instant; the reads then run
+ *   back-to-back and every zone in the cycle shares one sample_tick
+ * - Sensor rules run once per new snapshot and only while it is younger
+ *   than SENSOR_MAX_AGE_MS; older data holds the outputs, and past
+ *   SENSOR_FAILSAFE_AGE_MS the sensor-driven outputs are switched off
+ * - Persistence: assignments, desired outputs and irrigation starts are
+ *   journalled in flash (zone_persist.c); a zone found after a reset
+ *   resumes its profile, outputs and irrigation cycle
  */
 
 #include "node_controller.h"
 #include "plant_profiles.h"
-#include "uart_comm.h"  // ADD THIS INCLUDE
+#include "control_rules.h"
+#include "irrigation_sched.h"
+#include "calibration.h"
+#include "sensor_filter.h"
+#include "i2c_bus.h"
+#include "node_protocol.h"
+#include "zone_link.h"
+#include "zone_persist.h"
+#include "crc8.h"
+#include <stdint.h>
 #include <string.h>
 
-// Command definitions
-#define CMD_PUMP_OFF     0x10
-#define CMD_PUMP_ON      0x11
-#define CMD_HUMID_OFF    0x12
-#define CMD_HUMID_ON     0x13
-#define CMD_FAN_OFF      0x14
-#define CMD_FAN_ON       0x15
-#define CMD_LIGHT1_OFF   0x16
-#define CMD_LIGHT1_ON    0x17
-
-// Node addresses
-#define NODE1_ADDR       (0x08 << 1)
-#define NODE2_ADDR       (0x07 << 1)
+// Sensor sweep pacing: leave half the bus queue for commands and the OLED
+#define SENSOR_READ_QUEUE_SHARE  (I2C_BUS_QUEUE_LEN / 2)
 
 // Private state
-static I2C_HandleTypeDef* i2c_handle = NULL;
-static NodeState_t node_states[2] = {
-    {255, 0, 0, 0},
-    {255, 0, 0, 0}
-};
 static uint32_t last_control_update = 0;
+static uint8_t sweep_cursor[I2C_BUS_COUNT]; // Next zone to read per bus, ZONE_NONE = idle
+static uint32_t sweep_tick = 0;             // Latch time of the current sweep
+static ControlStats_t control_stats;
+
+// Limits per ACT_* bit. The pump follows the irrigation schedule and has
+// no on/off times, only the facility-wide cap; a 0 disables that limit.
+static const ActuatorLimits_t actuator_limits[ZONE_ACTUATOR_BITS] = {
+    {0, 0, 0, 2},       // Pump: two at a time
+    {30, 30, 600, 0},   // Humidifier: never left running past 10 min
+    {20, 20, 0, 0},     // Fan: set max_running to cap fans as well
+    {60, 60, 0, 0},     // Light 1
+};
 
-// Private I2C functions
-static void i2c_recovery(void) {
-    if (i2c_handle == NULL) return;
+// Zones with each ACT_* bit desired on, kept by set_desired()
+static uint8_t running[ZONE_ACTUATOR_BITS];
+static uint32_t last_pump_start = 0;
+static uint8_t restored_zones = 0;          // Zones resumed from flash since boot
+
+// Bus context carries the zone address, not a pointer: zone slots can move
+// Bit 7 is free in a 7-bit address and marks the one PEC retry of a read,
+// or the last single-byte command of a legacy actuator frame
+#define CTX_RETRY        0x80
+#define CTX_LAST         CTX_RETRY
+#define ADDR_CTX(addr)   ((void*)(uintptr_t)(addr))
+#define CTX_ADDR(ctx)    ((uint8_t)((uintptr_t)(ctx) & 0x7F))
+#define CTX_IS_RETRY(ctx) (((uintptr_t)(ctx) & CTX_RETRY) != 0)
+#define CTX_IS_LAST(ctx) CTX_IS_RETRY(ctx)
+
+static uint8_t submit_sensor_read(Zone_t* zone, uint8_t retry);
+static void set_desired(Zone_t* zone, uint8_t mask, uint8_t value, uint32_t now);
+static void stop_irrigation(Zone_t* zone, uint32_t now);
+
+// Bytes in one sensor frame, PEC included
+static uint8_t frame_len(const Zone_t* zone) {
+    if (zone->protocol == NODE_PROTOCOL_LEGACY) return NODE_LEGACY_FRAME_LEN;
+    return REG_MAP_LEN(zone->channel_count) + 1;
+}
 
-    __HAL_I2C_DISABLE(i2c_handle);
-    HAL_Delay(10);
-    __HAL_I2C_ENABLE(i2c_handle);
-    HAL_Delay(10);
+// Raw samples are brought to 10 bits so profile thresholds fit any node
+static uint16_t scale_sample(const Zone_t* zone, uint16_t raw) {
+    if (zone->resolution >= 10) return raw >> (zone->resolution - 10);
+    return raw << (10 - zone->resolution);
+}
+
+// Track actuator state from acknowledged commands
+static void apply_command(Zone_t* zone, const uint8_t* frame) {
+    uint8_t command = frame[0];
+
+    if (command == CMD_SET_ACTUATORS) {
+        zone->actuators = (zone->actuators & ~frame[1]) | (frame[2] & frame[1]);
+    } else if (command == CMD_SET_DUTY) {
+        // The node drives the pin's port bit high for any non-zero duty
+        zone->duty_acked[frame[1]] = frame[2];
+        if (frame[2] != 0) {
+            zone->actuators |= (1 << frame[1]);
+        } else {
+            zone->actuators &= ~(1 << frame[1]);
+        }
+    } else if (command >= CMD_TOGGLE_PUMP && command <= CMD_TOGGLE_LIGHT1) {
+        // Manual toggle - keep desired in step so auto mode does not undo it
+        uint8_t bit = 1 << (command - CMD_TOGGLE_PUMP);
+        zone->actuators ^= bit;
+        set_desired(zone, bit, zone->desired ^ bit, HAL_GetTick());
+    } else if (command >= CMD_PUMP_OFF && command <= CMD_LIGHT1_ON) {
+        uint8_t bit = 1 << ((command - CMD_PUMP_OFF) >> 1);
+        if (command & 1) {
+            zone->actuators |= bit;
+        } else {
+            zone->actuators &= ~bit;
+        }
+    }
+}
+
+// I2C completion handlers (run from i2c_bus_process())
+static void command_done(I2cXfer_t* xfer) {
+    Zone_t* zone = zone_table_lookup(CTX_ADDR(xfer->ctx));
+    if (zone == NULL) return;
+
+    zone_link_record(zone, xfer);
+    if (xfer->data[0] == CMD_SET_ACTUATORS || CTX_IS_LAST(xfer->ctx)) {
+        zone->flags &= ~ZONE_FLAG_CMD_PENDING;
+    } else if (xfer->data[0] == CMD_SET_DUTY) {
+        zone->duty_pending &= ~(1 << xfer->data[1]);
+    }
+    // A failed frame leaves confirmed != desired, so the next cycle resends
+    if (xfer->status == I2C_XFER_OK) {
+        apply_command(zone, xfer->data);
+    }
+}
 
-    __HAL_I2C_CLEAR_FLAG(i2c_handle, I2C_FLAG_AF);
-    __HAL_I2C_CLEAR_FLAG(i2c_handle, I2C_FLAG_BERR);
-    __HAL_I2C_CLEAR_FLAG(i2c_handle, I2C_FLAG_ARLO);
-    __HAL_I2C_CLEAR_FLAG(i2c_handle, I2C_FLAG_OVR);
+// SMBus PEC over the whole read transaction, as the node computes it;
+// the PEC byte follows the len data bytes
+static uint8_t frame_pec_ok(const Zone_t* zone, uint8_t pointer, const uint8_t* data, uint8_t len) {
+    uint8_t header[3] = {zone->addr << 1, pointer, (zone->addr << 1) | 1};
+    uint8_t pec = crc8_update(0, header, sizeof(header));
+    return crc8_update(pec, data, len) == data[len];
 }
 
-// MODIFIED: Now tracks which node received the command
-static void send_command(uint8_t slave_addr, uint8_t command) {
-    if (i2c_handle == NULL) return;
+// Sizes the zone from its descriptor. Anything but the magic byte is a
+// legacy node with the original three channels and four actuators.
+static void descriptor_done(I2cXfer_t* xfer) {
+    Zone_t* zone = zone_table_lookup(CTX_ADDR(xfer->ctx));
+    if (zone == NULL) return;
+
+    zone_link_record(zone, xfer);
+    if (xfer->status != I2C_XFER_OK) return;
+
+    const uint8_t* desc = xfer->data;
+    if (desc[0] != DESC_MAGIC) {
+        zone->protocol = NODE_PROTOCOL_LEGACY;
+        zone->channel_count = NODE_LEGACY_CHANNELS;
+        zone->actuator_mask = (1 << NODE_LEGACY_ACTUATORS) - 1;
+        zone->resolution = NODE_LEGACY_RESOLUTION;
+        zone->pwm_mask = 0;
+    } else if (!frame_pec_ok(zone, DESC_POINTER, desc, DESC_LEN)) {
+        zone_link_record_corrupt(zone);         // Asked again next sweep
+        return;
+    } else {
+        uint8_t actuators = desc[DESC_ACTUATORS];
+        uint8_t resolution = desc[DESC_RESOLUTION];
+
+        zone->protocol = desc[DESC_PROTOCOL];
+        zone->channel_count = (desc[DESC_CHANNELS] < ZONE_MAX_CHANNELS) ? desc[DESC_CHANNELS] : ZONE_MAX_CHANNELS;
+        zone->actuator_mask = (actuators < 8) ? (1 << actuators) - 1 : 0xFF;
+        zone->resolution = (resolution >= 1 && resolution <= 16) ? resolution : NODE_LEGACY_RESOLUTION;
+        zone->pwm_mask = (zone->protocol >= NODE_PROTOCOL_V3) ? (NODE_PWM_OUTPUTS & zone->actuator_mask) : 0;
+    }
+    // Channel count may have changed: the filters start over and the
+    // rule lanes are recompiled
+    zone->flags = (zone->flags & ~ZONE_FLAG_FILTERED) | ZONE_FLAG_DESCRIBED;
+    control_rules_invalidate();
+}
+
+// One repeated-start read returns the whole register map
+static void sensors_done(I2cXfer_t* xfer) {
+    Zone_t* zone = zone_table_lookup(CTX_ADDR(xfer->ctx));
+    if (zone == NULL) return;
+
+    zone_link_record(zone, xfer);
+    if (xfer->status != I2C_XFER_OK) return;
+
+    const uint8_t* frame = xfer->data;
+
+    // Legacy nodes send the sensor words only: no PEC, sequence or status
+    if (zone->protocol == NODE_PROTOCOL_LEGACY) {
+        for (uint8_t i = 0; i < NODE_LEGACY_CHANNELS; i++) {
+            zone->sensors[i] = scale_sample(zone, (frame[2*i] << 8) | frame[2*i + 1]);
+        }
+        zone->flags |= ZONE_FLAG_SAMPLED | ZONE_FLAG_UNFILTERED;
+        zone->sample_tick = sweep_tick;
+        return;
+    }
+
+    // A corrupt frame is never acted on; re-read it once, right away.
+    // Two in a row may mean a misread descriptor, so that is read again.
+    if (!frame_pec_ok(zone, REG_POINTER_BASE, frame, xfer->len - 1)) {
+        zone_link_record_corrupt(zone);
+        if (!CTX_IS_RETRY(xfer->ctx)) {
+            submit_sensor_read(zone, 1);
+        } else {
+            zone->flags &= ~ZONE_FLAG_DESCRIBED;
+        }
+        return;
+    }
+
+    const uint8_t* regs = frame;
+    const uint8_t* samples = frame + REG_SENSORS;
+    for (uint8_t i = 0; i < zone->channel_count; i++) {
+        zone->sensors[i] = scale_sample(zone, (samples[2*i] << 8) | samples[2*i + 1]);
+    }
+    zone->fw_version = regs[REG_FW_VERSION];
+
+    // Every latch bumps the sequence; a repeat means the node missed it
+    // and these are the values of an earlier cycle
+    if ((zone->flags & ZONE_FLAG_SAMPLED) && regs[REG_SAMPLE_SEQ] == zone->sample_seq) {
+        zone->flags |= ZONE_FLAG_STALE;
+    } else {
+        zone->flags = (zone->flags & ~ZONE_FLAG_STALE) | ZONE_FLAG_SAMPLED | ZONE_FLAG_UNFILTERED;
+        zone->sample_tick = sweep_tick;
+    }
 
-    HAL_StatusTypeDef ref = HAL_ERROR;
-    uint8_t retry = 3;
+    // The node's pins are the truth; an in-flight frame will report itself
+    if (!(zone->flags & ZONE_FLAG_CMD_PENDING)) {
+        zone->actuators = regs[REG_ACTUATORS] & zone->actuator_mask;
+    }
+    zone->sample_seq = regs[REG_SAMPLE_SEQ];
+    zone->node_uptime_sec = ((uint32_t)regs[REG_UPTIME] << 24) | ((uint32_t)regs[REG_UPTIME + 1] << 16) |
+                            ((uint32_t)regs[REG_UPTIME + 2] << 8) | regs[REG_UPTIME + 3];
+    zone->node_rx_errors = regs[REG_RX_ERRORS];
+    zone->node_cmd_errors = regs[REG_CMD_ERRORS];
+}
 
-    while (retry-- > 0 && ref != HAL_OK) {
-        ref = HAL_I2C_Master_Transmit(i2c_handle, slave_addr, &command, 1, 1000);
-        if (ref != HAL_OK) {
-            i2c_recovery();
-            HAL_Delay(50);
+// Queued, non-blocking: retries and recovery are handled by i2c_bus
+static void send_command(Zone_t* zone, uint8_t command) {
+    i2c_bus_submit_write(zone->bus, zone->addr << 1, &command, 1, command_done, ADDR_CTX(zone->addr));
+}
+
+// Legacy nodes only know the explicit OFF/ON pairs: one command per bit,
+// queued together or not at all. The bus FIFO completes them in order, so
+// the last one ends the pending state.
+static void send_legacy_actuators(Zone_t* zone, uint8_t mask, uint8_t value) {
+    uint8_t count = __builtin_popcount(mask);
+    if (count == 0 || I2C_BUS_QUEUE_LEN - i2c_bus_pending(zone->bus) < count) return;
+
+    for (uint8_t bit = 0; bit < NODE_LEGACY_ACTUATORS; bit++) {
+        if (!(mask & (1 << bit))) continue;
+
+        uint8_t command = CMD_PUMP_OFF + 2 * bit + ((value >> bit) & 1);
+        uint8_t last = (mask >> (bit + 1)) == 0;
+        if (i2c_bus_submit_write(zone->bus, zone->addr << 1, &command, 1, command_done,
+                                 ADDR_CTX(zone->addr | (last ? CTX_LAST : 0))) && last) {
+            zone->flags |= ZONE_FLAG_CMD_PENDING;
+            control_stats.commands_sent++;
         }
     }
+}
 
-    // CRITICAL: Update actuator state tracking for ESP32 dashboard
-    if (ref == HAL_OK) {
-        uint8_t node = (slave_addr == NODE1_ADDR) ? 0 : 1;
-        uart_comm_update_actuator_state(node, command);
+// Replaces up to four single-byte commands with one 3-byte write
+static void send_actuators(Zone_t* zone, uint8_t mask, uint8_t value) {
+    uint8_t frame[3] = {CMD_SET_ACTUATORS, mask, value};
+
+    if (zone->protocol == NODE_PROTOCOL_LEGACY) {
+        send_legacy_actuators(zone, mask & ((1 << NODE_LEGACY_ACTUATORS) - 1), value);
+        return;
+    }
+    if (i2c_bus_submit_write(zone->bus, zone->addr << 1, frame, sizeof(frame), command_done, ADDR_CTX(zone->addr))) {
+        zone->flags |= ZONE_FLAG_CMD_PENDING;
+        control_stats.commands_sent++;
+    }
+}
+
+static void send_duty(Zone_t* zone, uint8_t bit, uint8_t duty) {
+    uint8_t frame[3] = {CMD_SET_DUTY, bit, duty};
+    if (i2c_bus_submit_write(zone->bus, zone->addr << 1, frame, sizeof(frame), command_done, ADDR_CTX(zone->addr))) {
+        zone->duty_pending |= (1 << bit);
+        control_stats.commands_sent++;
     }
 }
 
-static void read_sensors(uint8_t slave_addr, uint16_t* result) {
-    if (i2c_handle == NULL || result == NULL) return;
+// Best effort, once per quarantine: a node the master cannot reach should
+// not be left running its outputs. If it takes the frame the breaker
+// closes and the outputs are re-synced from desired. A run in progress
+// ends here, so its pump slot goes to the zones queued behind it.
+static void release_outputs(Zone_t* zone, uint32_t now) {
+    zone->flags |= ZONE_FLAG_RELEASED;
+    if (zone->irrigation_active) stop_irrigation(zone, now);
+    if (zone->actuator_mask != 0) send_actuators(zone, zone->actuator_mask, 0);
+}
+
+// One duty frame per PI output whose duty the node has not confirmed yet
+static void sync_duties(Zone_t* zone, uint8_t refresh) {
+    for (uint8_t bit = 0; bit < ZONE_PWM_BITS; bit++) {
+        uint8_t act = 1 << bit;
+        if (!(zone->pwm_active & act) || (zone->duty_pending & act)) continue;
+        if (refresh || zone->duty[bit] != zone->duty_acked[bit]) send_duty(zone, bit, zone->duty[bit]);
+    }
+}
 
-    uint8_t raw_data[6] = {0};
-    HAL_StatusTypeDef ref = HAL_ERROR;
-    uint8_t retry = 3;
+// Emits a frame only for bits where desired != confirmed, or a full
+// re-sync frame when the refresh period has passed
+static void sync_actuators(Zone_t* zone, uint8_t decided, uint32_t current_time) {
+    if (zone->flags & ZONE_FLAG_CMD_PENDING) return;
+    if (!zone_link_usable(zone)) return;        // Re-synced once the breaker closes
 
-    while (retry-- > 0 && ref != HAL_OK) {
-        ref = HAL_I2C_Master_Receive(i2c_handle, slave_addr | 1, raw_data, 6, 1000);
-        if (ref != HAL_OK) {
-            i2c_recovery();
-            HAL_Delay(50);
+    uint8_t refresh = (current_time - zone->last_refresh_time >= ACTUATOR_REFRESH_MS);
+    sync_duties(zone, refresh);
+
+    // PWM outputs under a PI rule are not touched by on/off frames
+    uint8_t relays = zone->actuator_mask & ~zone->pwm_active;
+
+    if (refresh) {
+        zone->last_refresh_time = current_time;
+        control_stats.refreshes++;
+        send_actuators(zone, relays, zone->desired);
+        return;
+    }
+
+    uint8_t changed = (zone->desired ^ zone->actuators) & relays;
+    if (changed != 0) {
+        send_actuators(zone, changed, zone->desired);
+    } else if (decided != 0) {
+        control_stats.commands_suppressed++;
+    }
+}
+
+// Applies a decision to the desired state and counts the on/off changes
+static void set_desired(Zone_t* zone, uint8_t mask, uint8_t value, uint32_t now) {
+    uint8_t changed = (zone->desired ^ value) & mask;
+
+    zone->desired ^= changed;
+    for (uint8_t bit = 0; bit < ZONE_ACTUATOR_BITS; bit++) {
+        if (changed & (1 << bit)) {
+            zone->act_since[bit] = now;
+            zone->toggles[bit]++;
+            if (zone->desired & (1 << bit)) {
+                running[bit]++;
+            } else {
+                running[bit]--;
+            }
         }
     }
+    if (changed & ~ACT_PUMP) zone_persist_save_state(zone);
+}
+
+// Anti-short-cycle: holds back decisions that would end an on- or
+// off-period early and ends on-periods past their maximum. Switch-ons
+// past the actuator's facility-wide cap are held too. Bits in 'forced'
+// (failsafe) and outputs under PWM duty are left alone.
+static void limit_cycling(Zone_t* zone, uint8_t* mask, uint8_t* value, uint8_t forced, uint32_t now) {
+    for (uint8_t bit = 0; bit < ZONE_ACTUATOR_BITS; bit++) {
+        const ActuatorLimits_t* timing = &actuator_limits[bit];
+        uint8_t act = 1 << bit;
+        if (((forced | zone->pwm_active) & act) || !(zone->actuator_mask & act)) continue;
+
+        uint8_t on = zone->desired & act;
+        uint32_t held_ms = now - zone->act_since[bit];
+
+        if (on && timing->max_on_sec != 0 && held_ms >= timing->max_on_sec * 1000UL) {
+            *mask |= act;
+            *value &= ~act;
+            control_stats.max_on_trips++;
+            continue;
+        }
+
+        // No change asked for, or the output has never switched yet
+        if (!(*mask & act) || !((*value ^ zone->desired) & act) || zone->toggles[bit] == 0) continue;
 
-    if (ref == HAL_OK) {
-        for (int i = 0; i < 3; i++) {
-            result[i] = (raw_data[2*i] << 8) | raw_data[2*i + 1];
+        uint16_t min_sec = on ? timing->min_on_sec : timing->min_off_sec;
+        if (held_ms < min_sec * 1000UL) {
+            *mask &= ~act;
+            control_stats.timing_holds++;
+        } else if (!on && timing->max_running != 0 && running[bit] >= timing->max_running) {
+            *mask &= ~act;
+            control_stats.concurrency_holds++;
         }
     }
 }
 
+// Another pump may start: under the cap and past the stagger gap
+static uint8_t pump_slot_free(uint32_t now) {
+    uint8_t cap = actuator_limits[0].max_running;
+    return (cap == 0 || running[0] < cap) && (now - last_pump_start >= IRRIGATION_STAGGER_MS);
+}
+
+static void start_irrigation(Zone_t* zone, PlantProfile_t* profile, uint32_t due, uint32_t now) {
+    zone->irrigation_active = 1;
+    zone->irrigation_start_time = now;
+    zone->last_irrigation_time = now;
+    set_desired(zone, ACT_PUMP & zone->actuator_mask, ACT_PUMP, now);
+    irrigation_sched_set(zone->addr, now + profile->irrigation_duration_sec * 1000UL);
+    zone_persist_save_irrigation(zone, 1, now);
+
+    // Time spent queued for a pump slot
+    zone->irrigation_delay_ms = now - due;
+    if (zone->irrigation_delay_ms > 0) control_stats.irrigation_deferred++;
+    if (zone->irrigation_delay_ms > control_stats.max_irrigation_delay_ms) {
+        control_stats.max_irrigation_delay_ms = zone->irrigation_delay_ms;
+    }
+    if (zone->actuator_mask & ACT_PUMP) last_pump_start = now;
+}
+
+// Ends a run and frees its pump slot; the next start is one interval after
+// this run began
+static void stop_irrigation(Zone_t* zone, uint32_t now) {
+    PlantProfile_t* profile = get_profile(zone->assigned_profile);
+
+    zone->irrigation_active = 0;
+    set_desired(zone, ACT_PUMP, 0, now);
+    zone_persist_save_irrigation(zone, 0, now);
+    if (profile != NULL) {
+        irrigation_sched_set(zone->addr, zone->last_irrigation_time + profile->irrigation_interval_sec * 1000UL);
+    } else {
+        irrigation_sched_cancel(zone->addr);
+    }
+}
+
+// A zone's irrigation start or stop came due. Stops switch the pump off
+// and schedule the next start; starts join the pump queue, which
+// node_controller_update() drains as slots free up.
+static void irrigation_event(Zone_t* zone, uint32_t now) {
+    PlantProfile_t* profile = get_profile(zone->assigned_profile);
+    if (profile == NULL) return;                // Unassigned since it was scheduled
+
+    if (zone->protocol == 0) {
+        irrigation_sched_set(zone->addr, now + IRRIGATION_RETRY_MS);
+        return;
+    }
+
+    if (zone->irrigation_active) {
+        stop_irrigation(zone, now);
+    } else {
+        irrigation_sched_enqueue(zone->addr, profile->irrigation_priority, now);
+    }
+}
+
+// Pointer write + repeated start + register map + PEC in a single transaction
+static uint8_t submit_sensor_read(Zone_t* zone, uint8_t retry) {
+    return i2c_bus_submit_mem_read(zone->bus, zone->addr << 1, REG_POINTER_BASE,
+                                   NULL, frame_len(zone), sensors_done,
+                                   ADDR_CTX(zone->addr | (retry ? CTX_RETRY : 0)));
+}
+
+// An undescribed zone gets its descriptor read in place of sensor data
+static uint8_t submit_zone_read(Zone_t* zone) {
+    if (zone->flags & ZONE_FLAG_DESCRIBED) return submit_sensor_read(zone, 0);
+    return i2c_bus_submit_mem_read(zone->bus, zone->addr << 1, DESC_POINTER,
+                                   NULL, DESC_LEN + 1, descriptor_done, ADDR_CTX(zone->addr));
+}
+
+
 // Public functions
-void node_controller_init(I2C_HandleTypeDef* hi2c) {
-    i2c_handle = hi2c;
+void node_controller_init(void) {
+    last_control_update = 0;
+    memset(sweep_cursor, ZONE_NONE, sizeof(sweep_cursor));
+    memset(&control_stats, 0, sizeof(control_stats));
+    memset(running, 0, sizeof(running));
+    restored_zones = 0;
+
+    // Zones are registered by zone_discovery, not hardcoded
+    zone_table_init();
+    irrigation_sched_init();
+    calibration_init();
+    zone_persist_init();
 }
 
-void node_controller_update(uint16_t adc_node1[3], uint16_t adc_node2[3]) {
+void node_controller_update(void) {
     uint32_t current_time = HAL_GetTick();
 
     if (current_time - last_control_update < 250) {
@@ -109,80 +496,254 @@ void node_controller_update(uint16_t adc_node1[3], uint16_t adc_node2[3]) {
     }
     last_control_update = current_time;
 
-    uint16_t adc_readings[2][3];
-    uint8_t slave_addrs[2] = {NODE1_ADDR, NODE2_ADDR};
+    // New snapshots: median + EMA, then engineering units for the rules
+    sensor_filter_run();
+    control_rules_batch();
+
+    // IRRIGATION CONTROL - only zones with a start or stop due
+    uint8_t addr;
+    while ((addr = irrigation_sched_pop_due(current_time)) != ZONE_NONE) {
+        Zone_t* zone = zone_table_lookup(addr);
+        if (zone != NULL) irrigation_event(zone, current_time);
+    }
 
-    memcpy(adc_readings[0], adc_node1, sizeof(uint16_t) * 3);
-    memcpy(adc_readings[1], adc_node2, sizeof(uint16_t) * 3);
+    // Queued starts by priority, one per free (and staggered) pump slot
+    uint32_t due;
+    while (pump_slot_free(current_time) && (addr = irrigation_sched_dequeue(&due)) != ZONE_NONE) {
+        Zone_t* zone = zone_table_lookup(addr);
+        PlantProfile_t* profile = (zone != NULL) ? get_profile(zone->assigned_profile) : NULL;
+        if (profile == NULL || zone->irrigation_active) continue;
 
-    for (uint8_t node = 0; node < 2; node++) {
-        if (node_states[node].assigned_profile == 255) {
+        // A quarantined zone takes no slot; it asks again until it answers
+        if (!zone_link_usable(zone)) {
+            irrigation_sched_set(addr, current_time + IRRIGATION_RETRY_MS);
             continue;
         }
+        start_irrigation(zone, profile, due, current_time);
+    }
+
+    uint8_t count = zone_table_count();
+    for (uint8_t i = 0; i < count; i++) {
+        Zone_t* zone = zone_table_get(i);
+
+        if (zone_link_usable(zone)) {
+            zone->flags &= ~ZONE_FLAG_RELEASED;
+        } else if (!(zone->flags & ZONE_FLAG_RELEASED)) {
+            release_outputs(zone, current_time);
+        }
 
-        PlantProfile_t *profile = get_profile(node_states[node].assigned_profile);
-        if (profile == NULL) continue;
+        if (zone->assigned_profile == PROFILE_NONE) {
+            continue;
+        }
+        if (zone->protocol == 0) continue;      // Capabilities not read yet
 
-        // IRRIGATION CONTROL
-        if (node_states[node].irrigation_active) {
-            uint32_t irrigation_elapsed = (current_time - node_states[node].irrigation_start_time) / 1000;
+        PlantProfile_t *profile = get_profile(zone->assigned_profile);
+        if (profile == NULL) continue;
 
-            if (irrigation_elapsed >= profile->irrigation_duration_sec) {
-                send_command(slave_addrs[node], CMD_PUMP_OFF);
-                node_states[node].irrigation_active = 0;
+        // Decisions for this cycle update the desired state in one go
+        uint8_t mask = 0;
+        uint8_t value = 0;
+        uint8_t forced = 0;
+
+        // Sensor rules are off while the zone irrigates
+        if (!zone->irrigation_active) {
+            // Sensor rules: once per snapshot, never on data past its age limit
+            uint32_t age = zone_table_data_age(zone, current_time);
+            if (age > SENSOR_FAILSAFE_AGE_MS) {
+                forced = ACT_HUMID | ACT_FAN | ACT_LIGHT1;
+                mask |= forced;
+                zone->pwm_active = 0;               // Off frame releases the PWM too
+            } else if (age <= SENSOR_MAX_AGE_MS && zone->evaluated_tick != zone->sample_tick) {
+                uint32_t dt_ms = zone->sample_tick - zone->evaluated_tick;
+                zone->evaluated_tick = zone->sample_tick;
+                control_rules_eval(profile->rules, profile->rule_count, zone, dt_ms, &mask, &value);
             }
+            if (age > SENSOR_MAX_AGE_MS) control_stats.stale_cycles++;
+        }
+
+        mask &= zone->actuator_mask;            // Outputs the node does not have
+        limit_cycling(zone, &mask, &value, forced, current_time);
+        set_desired(zone, mask, value, current_time);
+        sync_actuators(zone, mask, current_time);
+    }
+}
+
+void node_controller_send_manual_command(uint8_t addr, uint8_t command) {
+    Zone_t* zone = zone_table_lookup(addr);
+    if (zone == NULL || !zone_link_usable(zone)) return;
+
+    // Toggles for outputs the node does not have would only bump its error count
+    if (command >= CMD_TOGGLE_PUMP && command <= CMD_TOGGLE_LIGHT1 &&
+        !(zone->actuator_mask & (1 << (command - CMD_TOGGLE_PUMP)))) return;
+    send_command(zone, command);
+}
+
+// A zone discovery has just added: resumes what was saved for its address
+// before a reset. The outputs are restored as desired without a frame;
+// they are synced once the descriptor is read, like any other decision.
+void node_controller_zone_added(uint8_t addr) {
+    Zone_t* zone = zone_table_lookup(addr);
+    ZonePersist_t saved;
+
+    control_rules_invalidate();                 // Zones after it moved up one index
+    if (zone == NULL) return;
+
+    zone_persist_load_calibration(zone);        // Built into tables with the profile
+    if (!zone_persist_load(addr, &saved)) return;
+
+    PlantProfile_t* profile = get_profile(saved.profile);
+    if (profile == NULL) return;                // Saved unassigned, or profile gone
+
+    uint32_t now = HAL_GetTick();
+    uint32_t age_ms = saved.irrigation_age_sec * 1000UL;
+    uint32_t duration_ms = profile->irrigation_duration_sec * 1000UL;
+    uint32_t interval_ms = profile->irrigation_interval_sec * 1000UL;
+
+    zone->assigned_profile = saved.profile;
+    calibration_prepare(zone);
+    set_desired(zone, (uint8_t)~ACT_PUMP, saved.actuators, now);
+
+    if (saved.irrigating && age_ms < duration_ms) {
+        // Reset mid-run: the pump finishes the run it started
+        zone->irrigation_active = 1;
+        zone->irrigation_start_time = now - age_ms;
+        zone->last_irrigation_time = zone->irrigation_start_time;
+        set_desired(zone, ACT_PUMP, ACT_PUMP, now);
+        irrigation_sched_set(addr, zone->irrigation_start_time + duration_ms);
+    } else {
+        // An overdue start comes due now rather than in the past
+        if (!saved.has_irrigation) age_ms = 0;
+        zone->last_irrigation_time = now - ((age_ms < interval_ms) ? age_ms : interval_ms);
+        irrigation_sched_set(addr, zone->last_irrigation_time + interval_ms);
+    }
+    restored_zones++;
+}
+
+// Drops everything the controller keeps for a zone discovery is removing
+void node_controller_zone_removed(uint8_t addr) {
+    Zone_t* zone = zone_table_lookup(addr);
+    if (zone == NULL) return;
+
+    // Last word in case the node is only unreachable, not gone; its
+    // completion finds no zone and is dropped
+    if (zone->actuator_mask != 0) send_actuators(zone, zone->actuator_mask, 0);
+
+    for (uint8_t bit = 0; bit < ZONE_ACTUATOR_BITS; bit++) {
+        if (zone->desired & (1 << bit)) running[bit]--;
+    }
+    irrigation_sched_cancel(addr);
+    control_rules_invalidate();                 // Lanes hold zone indices
+}
+
+void node_controller_assign_profile(uint8_t addr, uint8_t profile_index) {
+    Zone_t* zone = zone_table_lookup(addr);
+    if (zone != NULL) {
+        PlantProfile_t* profile = get_profile(profile_index);
+        uint32_t now = HAL_GetTick();
+
+        zone->assigned_profile = profile_index;
+        calibration_prepare(zone);
+        control_rules_invalidate();
+        if (profile == NULL) {
+            irrigation_sched_cancel(zone->addr);
+        } else if (zone->irrigation_active) {
+            // Running cycle ends on the new profile's duration
+            irrigation_sched_set(zone->addr, zone->irrigation_start_time + profile->irrigation_duration_sec * 1000UL);
         } else {
-            uint32_t time_since_last = (current_time - node_states[node].last_irrigation_time) / 1000;
-
-            // Scheduled irrigation
-            if (time_since_last >= profile->irrigation_interval_sec) {
-                send_command(slave_addrs[node], CMD_PUMP_ON);
-                node_states[node].irrigation_active = 1;
-                node_states[node].irrigation_start_time = current_time;
-                node_states[node].last_irrigation_time = current_time;
-            }
+            irrigation_sched_cancel(zone->addr);    // Drops a queued start too
+            zone->last_irrigation_time = now;
+            irrigation_sched_set(zone->addr, now + profile->irrigation_interval_sec * 1000UL);
+            zone_persist_save_irrigation(zone, 0, now);
+        }
+        zone_persist_save_state(zone);
+        zone->evaluated_tick = zone->sample_tick - 1;  // New thresholds apply to the current snapshot
+        zone->pwm_active = 0;
+        memset(zone->pi_integral, 0, sizeof(zone->pi_integral));
+    }
+}
+
+uint8_t node_controller_set_calibration(uint8_t addr, uint8_t channel, uint8_t curve, int16_t offset) {
+    Zone_t* zone = zone_table_lookup(addr);
+    if (zone == NULL || channel >= ZONE_MAX_CHANNELS || curve >= CAL_CURVE_COUNT) return 0;
 
-            // HUMIDITY CONTROL (HUMIDIFIER) - WITH HYSTERESIS
-            if (adc_readings[node][0] < profile->humidity_threshold) {
-                send_command(slave_addrs[node], CMD_HUMID_ON);
-            } else if (adc_readings[node][0] > profile->humidity_threshold + 50) {
-                send_command(slave_addrs[node], CMD_HUMID_OFF);
+    uint8_t old_curve = zone->cal_curve[channel];
+    int16_t old_offset = zone->cal_offset[channel];
+
+    zone->cal_curve[channel] = curve;
+    zone->cal_offset[channel] = offset;
+    if (!zone_persist_save_calibration(zone, channel)) {
+        zone->cal_curve[channel] = old_curve;
+        zone->cal_offset[channel] = old_offset;
+        return 0;
+    }
+
+    // Unassigned zones keep raw values; their tables come with a profile
+    if (zone->assigned_profile != PROFILE_NONE) calibration_set(zone, channel, curve, offset);
+    zone->evaluated_tick = zone->sample_tick - 1;  // Rules see the converted snapshot
+    return 1;
+}
+
+// Starts a sensor sweep over all zones; results land in Zone_t.sensors.
+// One general-call latch per bus goes ahead of the reads in the same FIFO,
+// so every node has frozen its snapshot before its read starts.
+void node_controller_poll_sensors(void) {
+    static const uint8_t latch = CMD_LATCH_SAMPLES;
+    uint8_t count = zone_table_count();
+
+    for (uint8_t bus = 0; bus < I2C_BUS_COUNT; bus++) {
+        if (sweep_cursor[bus] != ZONE_NONE) return;    // Previous sweep still draining
+    }
+
+    sweep_tick = HAL_GetTick();
+    for (uint8_t bus = 0; bus < I2C_BUS_COUNT; bus++) {
+        for (uint8_t i = 0; i < count; i++) {
+            if (zone_table_get(i)->bus == bus) {
+                i2c_bus_submit_write(bus, I2C_GENERAL_CALL_ADDR, &latch, 1, NULL, NULL);
+                break;
             }
+        }
+        sweep_cursor[bus] = 0;
+    }
+}
+
+// Feeds the active sweep into each bus queue without flooding it. Every
+// bus has its own cursor, so a full queue on one bus never holds back
+// reads for zones on the others.
+void node_controller_process(void) {
+    uint8_t count = zone_table_count();
 
-            // TEMPERATURE CONTROL (FAN) - WITH HYSTERESIS
-            if (adc_readings[node][1] > profile->temp_threshold) {
-                send_command(slave_addrs[node], CMD_FAN_ON);
-            } else if (adc_readings[node][1] < profile->temp_threshold - 50) {
-                send_command(slave_addrs[node], CMD_FAN_OFF);
+    for (uint8_t bus = 0; bus < I2C_BUS_COUNT; bus++) {
+        uint8_t* cursor = &sweep_cursor[bus];
+
+        while (*cursor != ZONE_NONE) {
+            if (*cursor >= count) {
+                *cursor = ZONE_NONE;
+                break;
             }
 
-            // LIGHT CONTROL - WITH HYSTERESIS
-            if (adc_readings[node][2] < profile->light_threshold) {
-                send_command(slave_addrs[node], CMD_LIGHT1_ON);  // ✓ Already correct with new define
-            } else if (adc_readings[node][2] > profile->light_threshold + 100) {
-                send_command(slave_addrs[node], CMD_LIGHT1_OFF);  // ✓ Already correct with new define
+            Zone_t* zone = zone_table_get(*cursor);
+            if (zone->bus == bus) {
+                if (i2c_bus_pending(bus) >= SENSOR_READ_QUEUE_SHARE) break;
+
+                // Quarantined zones are skipped - only their backoff probe runs
+                if (zone_link_usable(zone) && !submit_zone_read(zone)) break;
             }
+            (*cursor)++;
         }
     }
-}
 
-void node_controller_send_manual_command(uint8_t node, uint8_t command) {
-    uint8_t addr = (node == 0) ? NODE1_ADDR : NODE2_ADDR;
-    send_command(addr, command);
+    zone_link_process();
+    zone_persist_process(HAL_GetTick());
 }
 
-NodeState_t* node_controller_get_state(uint8_t node) {
-    return (node < 2) ? &node_states[node] : NULL;
+const ControlStats_t* node_controller_get_stats(void) {
+    return &control_stats;
 }
 
-void node_controller_assign_profile(uint8_t node, uint8_t profile_index) {
-    if (node < 2) {
-        node_states[node].assigned_profile = profile_index;
-        node_states[node].last_irrigation_time = HAL_GetTick();
-    }
+uint8_t node_controller_restored_zones(void) {
+    return restored_zones;
 }
 
-void node_controller_read_sensors(uint8_t node, uint16_t* result) {
-    uint8_t addr = (node == 0) ? NODE1_ADDR : NODE2_ADDR;
-    read_sensors(addr, result);
+uint8_t node_controller_is_idle(void) {
+    return running[0] == 0;                     // No pump on, none left running blind
 }
@@ -1,23 +1,72 @@
+/*
+ * plant_profiles.c
+ *
+ * Profile table served by index. The compiled defaults below are copied
+ * to RAM at boot, then every edit stored in flash is replayed on top
+ * (profile_store.c). get_profile() stays a plain array access.
+ */
+
 #include "plant_profiles.h"
+#include "profile_store.h"
+#include "calibration.h"
 #include <stddef.h>
+#include <string.h>
+
+// The three classic climate loops as rule rows (threshold, hysteresis band).
+// Arguments are physical: %RH, degC, lux.
+#define HUMIDIFY_BELOW(h)  {ZONE_CH_HUMIDITY, RULE_ON_BELOW, CAL_RH(h), CAL_RH(5), ACT_HUMID, 0}
+#define COOL_ABOVE(t)      {ZONE_CH_TEMP, RULE_ON_ABOVE, CAL_DEG_C(t), CAL_DEG_C(2), ACT_FAN, 0}
+#define LIGHT_BELOW(l)     {ZONE_CH_LIGHT, RULE_ON_BELOW, CAL_LUX(l), CAL_LUX(3000), ACT_LIGHT1, 0}
+#define CLIMATE_RULES(h, t, l)  3, {HUMIDIFY_BELOW(h), COOL_ABOVE(t), LIGHT_BELOW(l)}
+
+// Same loops with fan speed and light intensity under PI control
+// (setpoint, proportional band, integral time 60 s). Nodes without PWM
+// on those outputs run them as the on/off rules above.
+#define FAN_PI(t)          {ZONE_CH_TEMP, RULE_PI_ABOVE, CAL_DEG_C(t), CAL_DEG_C(3), ACT_FAN, 60}
+#define LIGHT_PI(l)        {ZONE_CH_LIGHT, RULE_PI_BELOW, CAL_LUX(l), CAL_LUX(5000), ACT_LIGHT1, 60}
+#define CLIMATE_PI_RULES(h, t, l)  3, {HUMIDIFY_BELOW(h), FAN_PI(t), LIGHT_PI(l)}
 
-// Private database - ADD MORE PROFILES HERE TO SCALE
-static PlantProfile_t profiles[] = {
-    {"TOMATO", 450, 280, 650, 30, 5},
-    {"PEPPER", 420, 260, 600, 28, 4},
-    {"LETTUCE", 500, 200, 400, 20, 3},
-    {"HERBS", 480, 240, 550, 25, 4},
-    {"BASIL", 470, 250, 580, 22, 4},      // ADD THESE
-    {"CUCUMBER", 490, 270, 620, 35, 6},   // TO TEST
-    {"STRAWBERRY", 460, 240, 600, 28, 5}, // SCROLLING
+// Defaults - ADD MORE PROFILES HERE TO SCALE
+// Extra rows (interlocks, extra channels) go after the climate rules,
+// up to PROFILE_MAX_RULES per profile.
+static const PlantProfile_t default_profiles[] = {
+    {"TOMATO", CLIMATE_RULES(65, 27, 20000), 30, 5, 1, 0},
+    {"PEPPER", CLIMATE_RULES(65, 28, 20000), 28, 4, 2, 0},
+    {"LETTUCE", CLIMATE_RULES(60, 20, 12000), 20, 3, 0, 0},     // Shallow roots dry out first
+    {"HERBS", CLIMATE_RULES(55, 24, 15000), 25, 4, 3, 0},
+    {"BASIL", CLIMATE_RULES(60, 26, 15000), 22, 4, 2, 0},      // ADD THESE
+    {"CUCUMBER", CLIMATE_RULES(75, 28, 20000), 35, 6, 0, 0},   // TO TEST
+    {"STRAWBERRY", CLIMATE_RULES(65, 24, 15000), 28, 5, 1, 0}, // SCROLLING
+    {"TOMATO PI", CLIMATE_PI_RULES(65, 27, 20000), 30, 5, 1, 0},
 };
 
+#define DEFAULT_COUNT  (sizeof(default_profiles) / sizeof(default_profiles[0]))
+
+_Static_assert(DEFAULT_COUNT <= PROFILE_MAX, "PROFILE_MAX too small for the defaults");
+
+// Private state
+static PlantProfile_t profiles[PROFILE_MAX];
+static uint8_t profile_count = 0;
+
+static uint8_t profile_valid(const PlantProfile_t* p) {
+    if (p->rule_count > PROFILE_MAX_RULES || p->irrigation_interval_sec == 0) return 0;
+    if (memchr(p->name, '\0', sizeof(p->name)) == NULL) return 0;
+
+    for (uint8_t i = 0; i < p->rule_count; i++) {
+        const ControlRule_t* r = &p->rules[i];
+        if (r->channel >= ZONE_MAX_CHANNELS || r->cmp > RULE_PI_ABOVE || r->actuator == 0) return 0;
+    }
+    return 1;
+}
+
 void plant_profiles_init(void) {
-    // Reserved for future use
+    memcpy(profiles, default_profiles, sizeof(default_profiles));
+    profile_count = DEFAULT_COUNT;
+    profile_store_load(profiles, PROFILE_MAX, &profile_count);
 }
 
 uint8_t get_num_profiles(void) {
-    return sizeof(profiles) / sizeof(profiles[0]);
+    return profile_count;
 }
 
 PlantProfile_t* get_profile(uint8_t index) {
@@ -29,3 +78,12 @@ const char* get_profile_name(uint8_t index) {
     PlantProfile_t* p = get_profile(index);
     return (p != NULL) ? p->name : "INVALID";
 }
+
+uint8_t plant_profiles_update(uint8_t index, const PlantProfile_t* profile) {
+    if (index > profile_count || index >= PROFILE_MAX || !profile_valid(profile)) return 0;
+
+    profiles[index] = *profile;
+    if (index == profile_count) profile_count++;
+    control_rules_invalidate();                 // Lanes hold copies of the thresholds
+    return profile_store_save(index, profiles, profile_count);
+}
@@ -0,0 +1,247 @@
+/*
+ * profile_store.c
+ *
+ * Plant profiles in a reserved flash sector, as an append-only log.
+ *
+ * Every edit appends one fixed-size record (header, the packed
+ * PlantProfile_t, CRC-32) to the first erased slot; nothing is ever
+ * rewritten in place, so the sector is erased once per ~1600 edits
+ * instead of once per edit. At boot the log is replayed in order onto
+ * the compiled defaults - the last valid record of an index wins - and
+ * plant_profiles.c serves the resulting RAM table by index as before.
+ *
+ * - A record cut short by a reset fails its CRC and is skipped; the
+ *   next append goes after it. The first slot still erased (magic
+ *   0xFFFF) ends the log.
+ * - Records of another PROFILE_STORE_VERSION are skipped, so a layout
+ *   change falls back to the defaults instead of misreading old data.
+ * - When the sector is full the table is compacted the way the emulated
+ *   EEPROM transfers a page, so a reset at any step keeps one complete
+ *   copy. There is no second sector to spare (5 and 6 hold the EEPROM
+ *   pages), so the EEPROM's erased page is borrowed as the other page:
+ *     1. the table is written there as a snapshot (same records after
+ *        an 8-byte header), the header magic last: SNAPSHOT_COMMITTED
+ *     2. sector 7 is erased and the table written back as the new log
+ *     3. the snapshot is retired (SNAPSHOT_RETIRED, a bit subset of the
+ *        magic, so one more word write); the EEPROM erases the page
+ *        before its next transfer
+ *   profile_store_load() finds a committed snapshot after a reset in
+ *   step 2, serves it and redoes steps 2-3. It runs before ee_init(),
+ *   which never erases its spare page at boot while an EEPROM page is
+ *   intact. Neither header value reads as an EEPROM page status: both
+ *   keep bits outside 0xEEEEEEEE, as does any torn write towards them.
+ * - A compaction erases up to two 128K sectors. The code runs from the
+ *   same flash bank, so the CPU stalls for each erase (1-2 s typical,
+ *   4 s max) with every interrupt held off. A save into a full log
+ *   therefore only marks the compaction due; profile_store_process()
+ *   runs it once the caller reports control idle. Until then the edit
+ *   lives in RAM only.
+ */
+
+#include "profile_store.h"
+#include "eeprom_emul.h"
+#include "crc32.h"
+#include <stddef.h>
+#include <string.h>
+
+typedef struct {
+    uint16_t magic;             // PROFILE_STORE_MAGIC
+    uint8_t  version;           // PROFILE_STORE_VERSION
+    uint8_t  index;             // Profile slot this record replaces
+    PlantProfile_t profile;
+    uint16_t reserved;          // 0xFFFF, keeps the CRC word-aligned
+    uint32_t crc;               // CRC-32 of every byte above
+} ProfileRecord_t;
+
+_Static_assert(sizeof(ProfileRecord_t) % 4 == 0, "records are programmed as words");
+
+#define RECORD_WORDS    (sizeof(ProfileRecord_t) / 4)
+#define SLOT_COUNT      (PROFILE_STORE_SIZE / sizeof(ProfileRecord_t))
+#define ERASED_MAGIC    0xFFFF
+
+// Compaction snapshot: magic word, record count, then the records
+#define SNAPSHOT_COMMITTED  0x50534E50UL    // "PNSP"
+#define SNAPSHOT_RETIRED    0x10100000UL
+#define SNAPSHOT_HEADER     8
+
+_Static_assert((SNAPSHOT_RETIRED & ~SNAPSHOT_COMMITTED) == 0, "retiring only clears bits");
+
+// Private state
+static uint16_t next_slot = 0;          // First erased slot
+static const PlantProfile_t* due_table = NULL;  // Compaction waiting for idle
+static uint8_t due_count = 0;
+static ProfileStoreStats_t stats;
+
+static const ProfileRecord_t* slot_record(uint16_t slot) {
+    return (const ProfileRecord_t*)(PROFILE_STORE_ADDR + (uint32_t)slot * sizeof(ProfileRecord_t));
+}
+
+static uint32_t snapshot_slot(uint32_t snapshot, uint8_t i) {
+    return snapshot + SNAPSHOT_HEADER + (uint32_t)i * sizeof(ProfileRecord_t);
+}
+
+static uint8_t record_ok(const ProfileRecord_t* rec) {
+    return rec->magic == PROFILE_STORE_MAGIC && rec->version == PROFILE_STORE_VERSION &&
+           rec->crc == crc32_compute((const uint8_t*)rec, offsetof(ProfileRecord_t, crc));
+}
+
+static void clear_flash_errors(void) {
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_OPERR | FLASH_FLAG_WRPERR |
+                           FLASH_FLAG_PGAERR | FLASH_FLAG_PGPERR | FLASH_FLAG_PGSERR);
+}
+
+static uint8_t program_word(uint32_t addr, uint32_t word) {
+    HAL_FLASH_Unlock();
+    clear_flash_errors();
+    HAL_StatusTypeDef status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, addr, word);
+    HAL_FLASH_Lock();
+    return status == HAL_OK;
+}
+
+static uint8_t write_record(uint32_t addr, uint8_t index, const PlantProfile_t* profile) {
+    ProfileRecord_t rec;
+    uint8_t ok = 1;
+
+    memset(&rec, 0xFF, sizeof(rec));
+    rec.magic = PROFILE_STORE_MAGIC;
+    rec.version = PROFILE_STORE_VERSION;
+    rec.index = index;
+    rec.profile = *profile;
+    rec.crc = crc32_compute((const uint8_t*)&rec, offsetof(ProfileRecord_t, crc));
+
+    for (uint8_t w = 0; w < RECORD_WORDS && ok; w++) {
+        uint32_t word;
+        memcpy(&word, (const uint8_t*)&rec + 4 * w, sizeof(word));
+        ok = program_word(addr + 4 * w, word);
+    }
+    return ok;
+}
+
+static uint8_t append(uint8_t index, const PlantProfile_t* profile) {
+    uint32_t addr = PROFILE_STORE_ADDR + (uint32_t)next_slot * sizeof(ProfileRecord_t);
+
+    // The slot is used even if programming fails; the torn record is skipped
+    next_slot++;
+    stats.free_slots = SLOT_COUNT - next_slot;
+    return write_record(addr, index, profile);
+}
+
+// Erases the sector and starts a new log from the RAM table
+static uint8_t rewrite_log(const PlantProfile_t* table, uint8_t count) {
+    FLASH_EraseInitTypeDef erase = {0};
+    uint32_t sector_error = 0;
+
+    erase.TypeErase = FLASH_TYPEERASE_SECTORS;
+    erase.Sector = PROFILE_STORE_SECTOR;
+    erase.NbSectors = 1;
+    erase.VoltageRange = FLASH_VOLTAGE_RANGE_3;
+
+    HAL_FLASH_Unlock();
+    clear_flash_errors();
+    HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&erase, &sector_error);
+    HAL_FLASH_Lock();
+
+    stats.compactions++;
+    if (status != HAL_OK) return 0;
+
+    next_slot = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if (!append(i, &table[i])) return 0;
+    }
+    return 1;
+}
+
+// Sector full: snapshot, new log, retire the snapshot (see the top).
+// Without a usable EEPROM page the log is left full rather than erased.
+static uint8_t compact(const PlantProfile_t* table, uint8_t count) {
+    uint32_t snapshot = ee_borrow_spare();
+    if (snapshot == 0) return 0;
+
+    for (uint8_t i = 0; i < count; i++) {
+        if (!write_record(snapshot_slot(snapshot, i), i, &table[i])) return 0;
+    }
+    if (!program_word(snapshot + 4, count)) return 0;
+    if (!program_word(snapshot, SNAPSHOT_COMMITTED)) return 0;
+
+    if (!rewrite_log(table, count)) return 0;   // Snapshot stays committed
+    return program_word(snapshot, SNAPSHOT_RETIRED);
+}
+
+// Committed snapshot on either EEPROM page, 0 if none
+static uint32_t find_snapshot(void) {
+    if (*(volatile const uint32_t*)EE_PAGE0_ADDR == SNAPSHOT_COMMITTED) return EE_PAGE0_ADDR;
+    if (*(volatile const uint32_t*)EE_PAGE1_ADDR == SNAPSHOT_COMMITTED) return EE_PAGE1_ADDR;
+    return 0;
+}
+
+// Reset during a compaction: the snapshot is the table, the log is redone
+static void restore_snapshot(uint32_t snapshot, PlantProfile_t* table, uint8_t max, uint8_t* count) {
+    uint32_t records = *(volatile const uint32_t*)(snapshot + 4);
+
+    for (uint8_t i = 0; i < records && i < max; i++) {
+        const ProfileRecord_t* rec = (const ProfileRecord_t*)snapshot_slot(snapshot, i);
+        if (!record_ok(rec) || rec->index != i) {
+            stats.bad_records++;
+            continue;
+        }
+        stats.records++;
+        table[i] = rec->profile;
+        if (i >= *count) *count = i + 1;
+    }
+    stats.restored = 1;
+
+    if (rewrite_log(table, *count)) program_word(snapshot, SNAPSHOT_RETIRED);
+}
+
+// Public functions
+void profile_store_load(PlantProfile_t* table, uint8_t max, uint8_t* count) {
+    uint32_t snapshot = find_snapshot();
+    uint16_t slot;
+
+    memset(&stats, 0, sizeof(stats));
+    if (snapshot != 0) {
+        restore_snapshot(snapshot, table, max, count);
+        return;
+    }
+
+    for (slot = 0; slot < SLOT_COUNT; slot++) {
+        const ProfileRecord_t* rec = slot_record(slot);
+        if (rec->magic == ERASED_MAGIC) break;
+
+        if (!record_ok(rec)) {
+            stats.bad_records++;
+            continue;
+        }
+        stats.records++;
+        if (rec->index >= max) continue;
+
+        table[rec->index] = rec->profile;
+        if (rec->index >= *count) *count = rec->index + 1;
+    }
+    next_slot = slot;
+    stats.free_slots = SLOT_COUNT - next_slot;
+}
+
+uint8_t profile_store_save(uint8_t index, const PlantProfile_t* table, uint8_t count) {
+    if (next_slot >= SLOT_COUNT) {
+        due_table = table;
+        due_count = count;
+        stats.compaction_due = 1;
+        return 1;
+    }
+    return append(index, &table[index]);
+}
+
+void profile_store_process(uint8_t idle) {
+    if (due_table == NULL || !idle) return;
+
+    // One attempt per save: a failure after the spare page was written
+    // must not turn into an erase every main loop pass
+    if (!compact(due_table, due_count)) stats.compaction_errors++;
+    due_table = NULL;
+    stats.compaction_due = 0;
+}
+
+const ProfileStoreStats_t* profile_store_get_stats(void) {
+    return &stats;
+}
@@ -0,0 +1,119 @@
+/*
+ * sensor_filter.c
+ *
+ * Streaming median + EMA per sensor channel, run by the control loop in
+ * one pass over every zone that delivered a new snapshot.
+ *
+ * - Median of the last ZONE_FILTER_TAPS samples drops single-read spikes
+ *   (a relay switching next to the ADC line) without lagging a step.
+ * - EMA, y += (x - y) >> FILTER_EMA_SHIFT in Q FILTER_EMA_FRAC_BITS,
+ *   smooths what is left so a reading sitting on a hysteresis edge does
+ *   not chatter the relay.
+ *
+ * The median taps store two channels per 32-bit word (even channel in the
+ * low half), so the sorting network runs on both lanes at once with the
+ * M4 SIMD instructions: USUB16 sets the per-halfword GE flags and SEL
+ * picks the smaller or larger lane. A median of five costs four
+ * compare-exchanges plus a median of three per channel pair.
+ *
+ * State per channel: ZONE_FILTER_TAPS + 1 halfwords (12 bytes for 5 taps).
+ * The first sample primes every tap and the EMA, so a new zone reports
+ * its first reading unfiltered rather than ramping up from zero.
+ */
+
+#include "sensor_filter.h"
+#include "calibration.h"
+#include "main.h"
+#include <string.h>
+
+#if ZONE_FILTER_TAPS != 3 && ZONE_FILTER_TAPS != 5
+#error "ZONE_FILTER_TAPS must be 3 or 5"
+#endif
+
+// Both lanes: a <= b afterwards
+static inline void cmpx(uint32_t* a, uint32_t* b) {
+    __USUB16(*a, *b);                   // GE per lane where a >= b
+    uint32_t lo = __SEL(*b, *a);
+    *b = __SEL(*a, *b);
+    *a = lo;
+}
+
+static inline uint32_t lane_min(uint32_t a, uint32_t b) {
+    __USUB16(a, b);
+    return __SEL(b, a);
+}
+
+static inline uint32_t lane_max(uint32_t a, uint32_t b) {
+    __USUB16(a, b);
+    return __SEL(a, b);
+}
+
+static inline uint32_t median3(uint32_t a, uint32_t b, uint32_t c) {
+    cmpx(&a, &b);
+    return lane_max(a, lane_min(b, c));
+}
+
+// Median of one channel pair over the window
+static uint32_t median_pair(const Zone_t* zone, uint8_t pair) {
+    uint32_t a = zone->filter_taps[0][pair];
+    uint32_t b = zone->filter_taps[1][pair];
+    uint32_t c = zone->filter_taps[2][pair];
+#if ZONE_FILTER_TAPS == 5
+    uint32_t d = zone->filter_taps[3][pair];
+    uint32_t e = zone->filter_taps[4][pair];
+
+    // a and e end up min and max of four samples; the median of all
+    // five is then the median of the other three
+    cmpx(&a, &b);
+    cmpx(&d, &e);
+    cmpx(&a, &d);
+    cmpx(&b, &e);
+    return median3(b, c, d);
+#else
+    return median3(a, b, c);
+#endif
+}
+
+static void filter_zone(Zone_t* zone) {
+    uint8_t pairs = (zone->channel_count + 1) / 2;
+    uint8_t prime = !(zone->flags & ZONE_FLAG_FILTERED);
+    uint16_t median[ZONE_MAX_CHANNELS];
+
+    for (uint8_t p = 0; p < pairs; p++) {
+        uint32_t sample;
+        memcpy(&sample, &zone->sensors[2 * p], sizeof(sample));
+
+        if (prime) {
+            for (uint8_t t = 0; t < ZONE_FILTER_TAPS; t++) zone->filter_taps[t][p] = sample;
+        } else {
+            zone->filter_taps[zone->filter_next][p] = sample;
+        }
+
+        uint32_t m = median_pair(zone, p);
+        median[2 * p] = m & 0xFFFF;
+        median[2 * p + 1] = m >> 16;
+    }
+    zone->filter_next = (zone->filter_next + 1) % ZONE_FILTER_TAPS;
+
+    for (uint8_t ch = 0; ch < zone->channel_count; ch++) {
+        int32_t x = (int32_t)median[ch] << FILTER_EMA_FRAC_BITS;
+        int32_t y = prime ? x : zone->filter_ema[ch];
+
+        zone->filter_ema[ch] = y + ((x - y) >> FILTER_EMA_SHIFT);
+    }
+    zone->flags = (zone->flags & ~ZONE_FLAG_UNFILTERED) | ZONE_FLAG_FILTERED;
+
+    for (uint8_t ch = 0; ch < zone->channel_count; ch++) {
+        zone->values[ch] = calibration_apply(zone, ch, sensor_filter_output(zone, ch));
+    }
+}
+
+// Public functions
+void sensor_filter_run(void) {
+    uint8_t count = zone_table_count();
+
+    for (uint8_t i = 0; i < count; i++) {
+        Zone_t* zone = zone_table_get(i);
+        if (zone->flags & ZONE_FLAG_UNFILTERED) filter_zone(zone);
+    }
+}
@@ -1,5 +1,6 @@
 
 #include "ssd1306.h"
+#include "i2c_bus.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -9,11 +10,12 @@
 #define SSD1306_WIDTH       128
 #define SSD1306_HEIGHT      64
 
-// IMPORTANT: Change this to match your I2C peripheral
-extern I2C_HandleTypeDef hi2c1;  // Change to hi2c2 if you enabled I2C2 in CubeMX
 
 // ==================== Private Variables ====================
 static uint8_t ssd1306_buffer[SSD1306_WIDTH * SSD1306_HEIGHT / 8];
+static uint8_t ssd1306_tx_buffer[SSD1306_WIDTH * SSD1306_HEIGHT / 8];  // Frame on the bus
+static uint8_t flush_pending = 0;   // Queued flush transfers not yet completed
+static uint8_t oled_bus = I2C_BUS_1; // Bus the display is wired to (see ssd1306_init)
 
 // ==================== Font Data ====================
 // Simple 5x7 font (only printable ASCII 32-90)
@@ -79,12 +81,22 @@ static const uint8_t font5x7[][5] = {
     {0x61, 0x59, 0x49, 0x4D, 0x43}, // Z
 };
 
+// Blocking - only used by ssd1306_init() before the bus carries other traffic
 void ssd1306_command(uint8_t cmd) {
-    uint8_t data[2] = {0x00, cmd};
-    HAL_I2C_Master_Transmit(&hi2c1, SSD1306_I2C_ADDR, data, 2, 100);
+    if (!i2c_bus_is_ready(oled_bus)) return;
+
+    while (!i2c_bus_submit_mem_write(oled_bus, SSD1306_I2C_ADDR, 0x00, &cmd, 1, NULL, NULL)) {
+        i2c_bus_process();      // Queue full - let it drain
+    }
+    while (!i2c_bus_is_idle(oled_bus)) {
+        i2c_bus_process();
+    }
 }
 
-void ssd1306_init(void) {
+// The display can live on any bus; give it its own to keep frame flushes
+// out of the zone traffic
+void ssd1306_init(uint8_t bus) {
+    oled_bus = bus;
     HAL_Delay(100);
     ssd1306_command(0xAE); // Display off
     ssd1306_command(0x20); // Set memory addressing mode
@@ -120,16 +132,28 @@ void ssd1306_clear(void) {
     memset(ssd1306_buffer, 0, sizeof(ssd1306_buffer));
 }
 
+static void flush_done(I2cXfer_t* xfer) {
+    if (flush_pending > 0) flush_pending--;
+}
+
+// Queues the frame on the I2C bus and returns immediately. If the previous
+// frame is still being sent this one is dropped; the next update redraws.
 void ssd1306_update(void) {
+    if (flush_pending > 0) return;
+
+    memcpy(ssd1306_tx_buffer, ssd1306_buffer, sizeof(ssd1306_tx_buffer));
+
     for(uint8_t page = 0; page < 8; page++) {
-        ssd1306_command(0xB0 + page);
-        ssd1306_command(0x00);
-        ssd1306_command(0x10);
-
-        uint8_t data[SSD1306_WIDTH + 1];
-        data[0] = 0x40; // Data mode
-        memcpy(&data[1], &ssd1306_buffer[SSD1306_WIDTH * page], SSD1306_WIDTH);
-        HAL_I2C_Master_Transmit(&hi2c1, SSD1306_I2C_ADDR, data, SSD1306_WIDTH + 1, 100);
+        uint8_t cmds[3] = {0xB0 + page, 0x00, 0x10};
+
+        // Control byte 0x00 = command stream, 0x40 = data stream
+        if (i2c_bus_submit_mem_write(oled_bus, SSD1306_I2C_ADDR, 0x00, cmds, sizeof(cmds), flush_done, NULL)) {
+            flush_pending++;
+        }
+        if (i2c_bus_submit_mem_write(oled_bus, SSD1306_I2C_ADDR, 0x40, &ssd1306_tx_buffer[SSD1306_WIDTH * page],
+                                     SSD1306_WIDTH, flush_done, NULL)) {
+            flush_pending++;
+        }
     }
 }
 
@@ -307,7 +331,7 @@ void test_screen_alert(void) {
 // ==================== Main Test Function ====================
 
 void run_oled_test(void) {
-    ssd1306_init();
+    ssd1306_init(oled_bus);
     HAL_Delay(500);
 
     uint32_t screen = 0;
@@ -1,88 +1,429 @@
 
-
 #include "uart_comm.h"
 #include "node_controller.h"
 #include "plant_profiles.h"
+#include "zone_discovery.h"
+#include "i2c_bus.h"
+#include "irrigation_sched.h"
+#include "eeprom_emul.h"
+#include "calibration.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 static UART_HandleTypeDef* uart_handle = NULL;
 
-// Track actuator states for each node
-typedef struct {
-    uint8_t pump_on;
-    uint8_t humid_on;
-    uint8_t fan_on;
-    uint8_t light1_on;
-} ActuatorStates_t;
+// One zone per line keeps the buffer fixed no matter how many zones exist:
+// {"node3":{"addr":9,"humidity":...}}  - the ESP32 reads each nodeN key it knows
+// Each node line is followed by its {"diag3":{...}} bus diagnostics line.
+// Sized for the longest line, a diag line with every counter at its maximum.
+static char tx_buffer[640];
+static uint8_t sweep_next = ZONE_NONE;     // Next zone to send, ZONE_NONE = idle
+static uint8_t sweep_diag = 0;             // 1 = node line sent, diag line next
 
-static ActuatorStates_t node_actuators[2] = {{0, 0, 0, 0}, {0, 0, 0, 0}};
+// Command lines from the gateway, assembled byte by byte in the RX interrupt
+// and handled by uart_comm_process() ahead of the next telemetry line
+#define RX_LINE_MAX    96
+#define CMD_MAX_ARGS   10
+static uint8_t rx_byte;
+static char rx_line[RX_LINE_MAX];
+static volatile uint8_t rx_len = 0;
+static volatile uint8_t rx_ready = 0;      // Complete line waiting, RX bytes dropped meanwhile
 
 void uart_comm_init(UART_HandleTypeDef* huart) {
     uart_handle = huart;
+    sweep_next = ZONE_NONE;
+    HAL_UART_Receive_IT(huart, &rx_byte, 1);
 }
 
-// Call this function whenever you send a command to update state tracking
-void uart_comm_update_actuator_state(uint8_t node, uint8_t command) {
-    if (node >= 2) return;
-
-    switch (command) {
-        case 0x10: node_actuators[node].pump_on = 0; break;
-        case 0x11: node_actuators[node].pump_on = 1; break;
-        case 0x12: node_actuators[node].humid_on = 0; break;
-        case 0x13: node_actuators[node].humid_on = 1; break;
-        case 0x14: node_actuators[node].fan_on = 0; break;
-        case 0x15: node_actuators[node].fan_on = 1; break;
-        case 0x16: node_actuators[node].light1_on = 0; break;
-        case 0x17: node_actuators[node].light1_on = 1; break;
+void uart_comm_send_status(void) {
+    if (sweep_next == ZONE_NONE) {
+        sweep_next = 0;
+        sweep_diag = 0;
     }
 }
 
-void uart_comm_send_status(uint16_t adc1[3], uint16_t adc2[3]) {
-    if (uart_handle == NULL) return;
+// Line budget. The gateway parses every line into a StaticJsonDocument<1024>
+// (Esp32Uart.ino), where each member and array element takes a 16-byte slot
+// and keys and strings are copied:
+// - node line: 21 members + up to 5 aux values, ~160 bytes of keys and
+//   profile name -> ~600 bytes of document, 340 chars worst case
+// - diag line: 24 members + 12 array values, ~160 bytes of keys
+//   -> ~750 bytes of document, 520 chars worst case
+// Link, PEC and descriptor details belong on the diag line; the node line
+// only grows by what the dashboard reads.
+static int format_zone(Zone_t* zone) {
+    // Data age in ms, -1 until the zone's first good frame
+    uint32_t age = zone_table_data_age(zone, HAL_GetTick());
+    long age_ms = (age == ZONE_AGE_NEVER) ? -1L : (long)age;
 
-    char buffer[300];
-    NodeState_t* node1 = node_controller_get_state(0);
-    NodeState_t* node2 = node_controller_get_state(1);
+    // Channels past humidity/temp/light go out as a plain array
+    char aux[ZONE_MAX_CHANNELS * 6 + 1] = "";
+    int aux_len = 0;
+    for (uint8_t ch = ZONE_CH_LIGHT + 1; ch < zone->channel_count; ch++) {
+        aux_len += snprintf(aux + aux_len, sizeof(aux) - aux_len, "%s%d",
+                            (aux_len > 0) ? "," : "", zone->sensors[ch]);
+    }
 
-    snprintf(buffer, sizeof(buffer),
-        "{\"node1\":{"
-    		"\"humidity\":%d,"
+    return snprintf(tx_buffer, sizeof(tx_buffer),
+        "{\"node%d\":{"
+            "\"addr\":%d,"
+            "\"humidity\":%d,"
             "\"temp\":%d,"
             "\"light\":%d,"
+            "\"rh_x10\":%d,"
+            "\"temp_x10\":%d,"
+            "\"lux\":%ld,"
+            "\"cal\":%d,"
+            "\"aux\":[%s],"
             "\"profile\":\"%s\","
-    		"\"irrigation\":%d,"
-    		"\"humid\":%d,"
-    		"\"fan\":%d,"
-    		"\"light1\":%d"
-        "},"
-        "\"node2\":{"
-    		"\"humidity\":%d,"
-            "\"temp\":%d,"
-            "\"light\":%d,"
-            "\"profile\":\"%s\","
-    		"\"irrigation\":%d,"
-    		"\"humid\":%d,"
-    		"\"fan\":%d,"
-    		"\"light1\":%d"
+            "\"irrigation\":%d,"
+            "\"irr_delay\":%lu,"
+            "\"pump\":%d,"
+            "\"humid\":%d,"
+            "\"fan\":%d,"
+            "\"light1\":%d,"
+            "\"fan_duty\":%d,"
+            "\"light1_duty\":%d,"
+            "\"ts\":%lu,"
+            "\"age\":%ld,"
+            "\"stale\":%d"
         "}}\r\n",
-
-        // Node 1 data
-        adc1[0], adc1[1], adc1[2],
-        (node1 != NULL && node1->assigned_profile != 255) ? get_profile_name(node1->assigned_profile) : "None",
-        (node1 != NULL) ? node1->irrigation_active : 0,
-        node_actuators[0].humid_on,
-        node_actuators[0].fan_on,
-        node_actuators[0].light1_on,
-
-        // Node 2 data
-        adc2[0], adc2[1], adc2[2],
-        (node2 != NULL && node2->assigned_profile != 255) ? get_profile_name(node2->assigned_profile) : "None",
-        (node2 != NULL) ? node2->irrigation_active : 0,
-        node_actuators[1].humid_on,
-        node_actuators[1].fan_on,
-        node_actuators[1].light1_on
+        zone_table_node_number(zone->addr),
+        zone->addr,
+        zone->sensors[ZONE_CH_HUMIDITY], zone->sensors[ZONE_CH_TEMP], zone->sensors[ZONE_CH_LIGHT],
+        // Engineering units (0.1 %RH, 0.1 degC, lux), valid once cal is 1
+        zone->values[ZONE_CH_HUMIDITY], zone->values[ZONE_CH_TEMP], (long)zone->values[ZONE_CH_LIGHT] * 10,
+        (zone->cal_lut[ZONE_CH_TEMP] != NULL) ? 1 : 0,
+        aux,
+        (zone->assigned_profile != PROFILE_NONE) ? get_profile_name(zone->assigned_profile) : "None",
+        zone->irrigation_active,
+        (unsigned long)zone->irrigation_delay_ms,
+        (zone->actuators & ACT_PUMP) ? 1 : 0,
+        (zone->actuators & ACT_HUMID) ? 1 : 0,
+        (zone->actuators & ACT_FAN) ? 1 : 0,
+        (zone->actuators & ACT_LIGHT1) ? 1 : 0,
+        // duty[] is indexed by actuator bit; -1 while the output is on/off only
+        (zone->pwm_active & ACT_FAN) ? zone->duty_acked[2] : -1,
+        (zone->pwm_active & ACT_LIGHT1) ? zone->duty_acked[3] : -1,
+        (unsigned long)zone->sample_tick,
+        age_ms,
+        (zone->flags & ZONE_FLAG_STALE) ? 1 : 0
     );
+}
+
+// Node identity and link state (descriptor, register map, zone_link.c),
+// transfer counters and the wire-time histogram
+static int format_zone_diag(Zone_t* zone) {
+    const ZoneLink_t* link = &zone->link;
+    const uint32_t* hist = link->latency_hist;
+
+    return snprintf(tx_buffer, sizeof(tx_buffer),
+        "{\"diag%d\":{"
+            "\"fw\":%d,"
+            "\"proto\":%d,"
+            "\"ch\":%d,"
+            "\"act\":%d,"
+            "\"res\":%d,"
+            "\"seq\":%d,"
+            "\"uptime\":%lu,"
+            "\"pec_err\":%lu,"
+            "\"khz\":%d,"
+            "\"err_pm\":%d,"
+            "\"bps\":%d,"
+            "\"health\":%d,"
+            "\"xfers\":%lu,"
+            "\"retries\":%lu,"
+            "\"nacks\":%lu,"
+            "\"bus_err\":%lu,"
+            "\"arlo\":%lu,"
+            "\"timeouts\":%lu,"
+            "\"recoveries\":%lu,"
+            "\"last_us\":%lu,"
+            "\"max_us\":%lu,"
+            "\"last_ok\":%lu,"
+            "\"hist\":[%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu],"
+            "\"toggles\":[%lu,%lu,%lu,%lu]"
+        "}}\r\n",
+        zone_table_node_number(zone->addr),
+        zone->fw_version,
+        zone->protocol, zone->channel_count, zone->actuator_mask, zone->resolution,
+        zone->sample_seq,
+        (unsigned long)zone->node_uptime_sec,
+        (unsigned long)link->pec_errors,
+        (link->slow ? I2C_BUS_SPEED_SLOW_HZ : I2C_BUS_SPEED_FAST_HZ) / 1000,
+        link->error_permille,
+        link->bytes_per_sec,
+        link->health,
+        (unsigned long)link->transfers,
+        (unsigned long)link->retries,
+        (unsigned long)link->nacks,
+        (unsigned long)(link->bus_errors - link->arb_lost - link->timeouts),
+        (unsigned long)link->arb_lost,
+        (unsigned long)link->timeouts,
+        (unsigned long)link->bus_errors,
+        (unsigned long)link->last_xfer_us,
+        (unsigned long)link->max_xfer_us,
+        (unsigned long)link->last_ok_tick,
+        (unsigned long)hist[0], (unsigned long)hist[1], (unsigned long)hist[2], (unsigned long)hist[3],
+        (unsigned long)hist[4], (unsigned long)hist[5], (unsigned long)hist[6], (unsigned long)hist[7],
+        // Relay cycles by ACT_* bit: pump, humidifier, fan, light 1
+        (unsigned long)zone->toggles[0], (unsigned long)zone->toggles[1],
+        (unsigned long)zone->toggles[2], (unsigned long)zone->toggles[3]);
+}
+
+// Closes every sweep: bus-load counters for the whole master
+static int format_control_stats(void) {
+    const ControlStats_t* control = node_controller_get_stats();
+    const EeStats_t* ee = ee_get_stats();
+    uint32_t recoveries = 0, failures = 0, last_us = 0, max_us = 0;
+
+    for (uint8_t i = 0; i < I2C_BUS_COUNT; i++) {
+        const I2cBusStats_t* bus = i2c_bus_get_stats(i);
+        recoveries += bus->recoveries;
+        failures += bus->recovery_failures;
+        if (bus->last_recovery_us > last_us) last_us = bus->last_recovery_us;
+        if (bus->max_recovery_us > max_us) max_us = bus->max_recovery_us;
+    }
+
+    return snprintf(tx_buffer, sizeof(tx_buffer),
+        "{\"control\":{\"sent\":%lu,\"suppressed\":%lu,\"refreshes\":%lu,\"stale_cycles\":%lu,"
+        "\"holds\":%lu,\"max_on_trips\":%lu,\"cap_holds\":%lu,\"irr_deferred\":%lu,\"max_irr_delay\":%lu,"
+        "\"irr_waiting\":%d},"
+        "\"bus\":{\"recoveries\":%lu,\"recovery_failures\":%lu,\"recovery_us\":%lu,\"max_recovery_us\":%lu},"
+        "\"ee\":{\"free\":%u,\"transfers\":%u,\"errors\":%u}}\r\n",
+        (unsigned long)control->commands_sent,
+        (unsigned long)control->commands_suppressed,
+        (unsigned long)control->refreshes,
+        (unsigned long)control->stale_cycles,
+        (unsigned long)control->timing_holds,
+        (unsigned long)control->max_on_trips,
+        (unsigned long)control->concurrency_holds,
+        (unsigned long)control->irrigation_deferred,
+        (unsigned long)control->max_irrigation_delay_ms,
+        irrigation_sched_waiting(),
+        (unsigned long)recoveries,
+        (unsigned long)failures,
+        (unsigned long)last_us,
+        (unsigned long)max_us,
+        ee->free_slots, ee->transfers, ee->write_errors);
+}
+
+// Profile editing over the UART, one command per line, fields by spaces:
+//   PROFILE GET <i>
+//   PROFILE SET <i> NAME|INTERVAL|DURATION|PRIORITY <value>
+//   PROFILE RULE <i> <n> <channel> <cmp> <threshold> <band> <actuator> <ti_sec>
+//   PROFILE DELRULE <i> <n>
+//   PROFILE NEW <name>            (copy of profile 0, appended)
+//   CAL GET <addr>
+//   CAL SET <addr> <channel> <curve> <trim>
+// Rule fields are ControlRule_t as numbers; n = rule count appends a row.
+// INTERVAL, DURATION and PRIORITY are 0-255: one byte each in the stored
+// PlantProfile_t, whose layout is fixed by the flash records (so seconds
+// for interval and duration top out at 255 until PROFILE_STORE_VERSION
+// moves to a wider layout).
+// CAL sets a zone channel's sensor curve (CalCurve_t as a number, 0 =
+// the channel's default) and a trim in the channel's engineering units.
+// Every change is written to flash before the {"ack":...} reply.
+static uint8_t parse_long(const char* text, long lo, long hi, long* out) {
+    char* end;
+    *out = strtol(text, &end, 10);
+    return *text != '\0' && *end == '\0' && *out >= lo && *out <= hi;
+}
+
+static int reply_error(const char* reason) {
+    return snprintf(tx_buffer, sizeof(tx_buffer), "{\"ack\":\"error\",\"reason\":\"%s\"}\r\n", reason);
+}
+
+static int reply_update(uint8_t index, const PlantProfile_t* profile) {
+    if (!plant_profiles_update(index, profile)) return reply_error("rejected");
+    return snprintf(tx_buffer, sizeof(tx_buffer), "{\"ack\":\"ok\",\"profile\":%d}\r\n", index);
+}
+
+static int format_profile(uint8_t index, const PlantProfile_t* p) {
+    int len = snprintf(tx_buffer, sizeof(tx_buffer),
+        "{\"profile\":{\"index\":%d,\"name\":\"%s\",\"interval\":%d,\"duration\":%d,\"priority\":%d,\"rules\":[",
+        index, p->name, p->irrigation_interval_sec, p->irrigation_duration_sec, p->irrigation_priority);
+
+    for (uint8_t i = 0; i < p->rule_count && len < (int)sizeof(tx_buffer); i++) {
+        const ControlRule_t* r = &p->rules[i];
+        len += snprintf(tx_buffer + len, sizeof(tx_buffer) - len, "%s[%d,%d,%d,%u,%d,%d]", (i > 0) ? "," : "",
+                        r->channel, r->cmp, r->threshold, r->band, r->actuator, r->ti_sec);
+    }
+    if (len < (int)sizeof(tx_buffer)) {
+        len += snprintf(tx_buffer + len, sizeof(tx_buffer) - len, "]}}\r\n");
+    }
+    return len;
+}
+
+static int format_calibration(const Zone_t* zone) {
+    int len = snprintf(tx_buffer, sizeof(tx_buffer), "{\"cal\":{\"addr\":%d,\"curves\":[", zone->addr);
+
+    for (uint8_t ch = 0; ch < zone->channel_count; ch++) {
+        len += snprintf(tx_buffer + len, sizeof(tx_buffer) - len, "%s%d", (ch > 0) ? "," : "", zone->cal_curve[ch]);
+    }
+    len += snprintf(tx_buffer + len, sizeof(tx_buffer) - len, "],\"trims\":[");
+    for (uint8_t ch = 0; ch < zone->channel_count; ch++) {
+        len += snprintf(tx_buffer + len, sizeof(tx_buffer) - len, "%s%d", (ch > 0) ? "," : "", zone->cal_offset[ch]);
+    }
+    return len + snprintf(tx_buffer + len, sizeof(tx_buffer) - len, "]}}\r\n");
+}
+
+static int handle_calibration(char** argv, uint8_t argc) {
+    long addr, channel, curve, trim;
+    Zone_t* zone;
+
+    if (!parse_long(argv[2], 0, 0x7F, &addr) || (zone = zone_table_lookup(addr)) == NULL) {
+        return reply_error("bad zone");
+    }
+    if (strcmp(argv[1], "GET") == 0) return format_calibration(zone);
+    if (strcmp(argv[1], "SET") != 0 || argc != 6) return reply_error("bad command");
+
+    if (!parse_long(argv[3], 0, ZONE_MAX_CHANNELS - 1, &channel) ||
+        !parse_long(argv[4], 0, CAL_CURVE_COUNT - 1, &curve) ||
+        !parse_long(argv[5], INT16_MIN, INT16_MAX, &trim)) {
+        return reply_error("bad value");
+    }
+    if (!node_controller_set_calibration(addr, channel, curve, trim)) return reply_error("not saved");
+    return snprintf(tx_buffer, sizeof(tx_buffer), "{\"ack\":\"ok\",\"cal\":%ld}\r\n", addr);
+}
+
+static void set_name(PlantProfile_t* p, const char* name) {
+    strncpy(p->name, name, sizeof(p->name) - 1);
+    p->name[sizeof(p->name) - 1] = '\0';
+}
+
+static int handle_command(char* line) {
+    char* argv[CMD_MAX_ARGS];
+    uint8_t argc = 0;
+    long index;
+
+    for (char* tok = strtok(line, " "); tok != NULL && argc < CMD_MAX_ARGS; tok = strtok(NULL, " ")) {
+        argv[argc++] = tok;
+    }
+    if (argc >= 3 && strcmp(argv[0], "CAL") == 0) return handle_calibration(argv, argc);
+    if (argc < 3 || strcmp(argv[0], "PROFILE") != 0) return reply_error("unknown command");
+
+    if (strcmp(argv[1], "NEW") == 0) {
+        PlantProfile_t p = *get_profile(0);
+        set_name(&p, argv[2]);
+        return reply_update(get_num_profiles(), &p);
+    }
+
+    if (!parse_long(argv[2], 0, get_num_profiles() - 1, &index)) return reply_error("bad index");
+    if (strcmp(argv[1], "GET") == 0) return format_profile(index, get_profile(index));
+
+    PlantProfile_t p = *get_profile(index);
+    if (strcmp(argv[1], "SET") == 0 && argc == 5) {
+        long v = 0;
+        if (strcmp(argv[3], "NAME") == 0) {
+            set_name(&p, argv[4]);
+        } else if (!parse_long(argv[4], 0, 255, &v)) {
+            return reply_error("bad value");
+        } else if (strcmp(argv[3], "INTERVAL") == 0) {
+            p.irrigation_interval_sec = v;
+        } else if (strcmp(argv[3], "DURATION") == 0) {
+            p.irrigation_duration_sec = v;
+        } else if (strcmp(argv[3], "PRIORITY") == 0) {
+            p.irrigation_priority = v;
+        } else {
+            return reply_error("bad field");
+        }
+    } else if (strcmp(argv[1], "RULE") == 0 && argc == 10) {
+        long n, channel, cmp, threshold, band, actuator, ti;
+        uint8_t last = (p.rule_count < PROFILE_MAX_RULES) ? p.rule_count : PROFILE_MAX_RULES - 1;
+
+        if (!parse_long(argv[3], 0, last, &n) ||
+            !parse_long(argv[4], 0, ZONE_MAX_CHANNELS - 1, &channel) ||
+            !parse_long(argv[5], RULE_ON_BELOW, RULE_PI_ABOVE, &cmp) ||
+            !parse_long(argv[6], INT16_MIN, INT16_MAX, &threshold) ||
+            !parse_long(argv[7], 0, UINT16_MAX, &band) ||
+            !parse_long(argv[8], 1, 255, &actuator) ||
+            !parse_long(argv[9], 0, 255, &ti)) {
+            return reply_error("bad rule");
+        }
+        p.rules[n] = (ControlRule_t){channel, cmp, threshold, band, actuator, ti};
+        if (n == p.rule_count) p.rule_count++;
+    } else if (strcmp(argv[1], "DELRULE") == 0 && argc == 4) {
+        long n;
+        if (!parse_long(argv[3], 0, (long)p.rule_count - 1, &n)) return reply_error("bad rule");
+        memmove(&p.rules[n], &p.rules[n + 1], (p.rule_count - n - 1) * sizeof(ControlRule_t));
+        p.rule_count--;
+    } else {
+        return reply_error("bad command");
+    }
+    return reply_update(index, &p);
+}
+
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef* huart) {
+    if (huart != uart_handle) return;
+
+    if (!rx_ready) {
+        if (rx_byte == '\n' || rx_byte == '\r') {
+            if (rx_len > 0) {
+                rx_line[rx_len] = '\0';
+                rx_ready = 1;
+            }
+        } else if (rx_len < RX_LINE_MAX - 1) {
+            rx_line[rx_len++] = rx_byte;
+        }
+    }
+    HAL_UART_Receive_IT(huart, &rx_byte, 1);
+}
+
+// An overrun or framing error ends the receive; start it again
+void HAL_UART_ErrorCallback(UART_HandleTypeDef* huart) {
+    if (huart == uart_handle) HAL_UART_Receive_IT(huart, &rx_byte, 1);
+}
+
+// Non-blocking: queues the next line once the previous one has left the UART
+void uart_comm_process(void) {
+    if (uart_handle == NULL) return;
+    if (uart_handle->gState != HAL_UART_STATE_READY) return;
+
+    // A command reply goes out before the next telemetry line
+    if (rx_ready) {
+        int len = handle_command(rx_line);
+        rx_len = 0;
+        rx_ready = 0;
+        if (len > 0) HAL_UART_Transmit_IT(uart_handle, (uint8_t*)tx_buffer, strlen(tx_buffer));
+        return;
+    }
+    if (sweep_next == ZONE_NONE) return;
+
+    Zone_t* zone = zone_table_get(sweep_next);
+    int len;
+    if (zone == NULL) {
+        len = format_control_stats();
+    } else if (sweep_diag) {
+        len = format_zone_diag(zone);
+    } else {
+        len = format_zone(zone);
+    }
+
+    if (len > 0 && HAL_UART_Transmit_IT(uart_handle, (uint8_t*)tx_buffer, strlen(tx_buffer)) == HAL_OK) {
+        if (zone == NULL) {
+            sweep_next = ZONE_NONE;
+        } else if (sweep_diag) {
+            sweep_diag = 0;
+            sweep_next++;
+        } else {
+            sweep_diag = 1;
+        }
+    }
+}
+
+void uart_comm_send_discovery_report(void) {
+    if (uart_handle == NULL) return;
+
+    const DiscoveryStats_t* stats = zone_discovery_get_stats();
+    const EeStats_t* ee = ee_get_stats();
+    snprintf(tx_buffer, sizeof(tx_buffer),
+        "{\"discovery\":{\"zones\":%d,\"scan_ms\":%lu,\"probe_interval_ms\":%d},"
+        "\"persist\":{\"restored\":%d,\"restore_us\":%lu,\"entries\":%u,\"free\":%u,\"bad\":%u}}\r\n",
+        stats->boot_zones_found, (unsigned long)stats->boot_scan_ms, stats->probe_interval_ms,
+        node_controller_restored_zones(), (unsigned long)ee->restore_us, ee->entries, ee->free_slots,
+        ee->bad_entries);
 
-    HAL_UART_Transmit(uart_handle, (uint8_t*)buffer, strlen(buffer), 1000);
+    HAL_UART_Transmit(uart_handle, (uint8_t*)tx_buffer, strlen(tx_buffer), 1000);
 }
@@ -0,0 +1,160 @@
+/*
+ * zone_discovery.c
+ *
+ * Finds field nodes on the I2C buses and keeps the zone table in sync.
+ *
+ * - Boot: probes every usable 7-bit address (0x07-0x77) back-to-back on
+ *   every initialised bus in parallel and registers each one that ACKs,
+ *   remembering which bus it answered on.
+ * - Runtime: probes one unregistered address at a time per bus,
+ *   round-robin. The spacing is derived from the bus clock so probing
+ *   never uses more than DISCOVERY_BUS_BUDGET_PERMILLE of any bus's time.
+ *   A new ACK registers a zone.
+ * - Known zones are left to their circuit breaker (zone_link.c): a node
+ *   that stops answering is quarantined, gets one all-off frame
+ *   (node_controller.c), and is only dropped once zone_link_absent() says
+ *   it has been gone for LINK_ABSENT_REMOVE_MS. A short brown-out or a
+ *   loose connector does not lose the zone or its outputs' state.
+ *
+ * A probe is an address-only write (START, addr+W, STOP).
+ */
+
+#include "zone_discovery.h"
+#include "zone_table.h"
+#include "zone_link.h"
+#include "node_controller.h"
+#include "i2c_bus.h"
+#include <stddef.h>
+#include <string.h>
+
+#define OLED_ADDR         0x3C      // SSD1306 shares the bus, never a zone
+
+// Bit times per probe incl. START/STOP and ISR turnaround (conservative)
+#define PROBE_BIT_TIMES   20
+
+// Private state
+static DiscoveryStats_t stats;
+static uint8_t next_addr[I2C_BUS_COUNT];
+static uint8_t probe_in_flight[I2C_BUS_COUNT];
+static uint32_t last_probe_tick[I2C_BUS_COUNT];
+
+static uint8_t is_candidate(uint8_t addr) {
+    return addr != OLED_ADDR && zone_table_find(addr) == ZONE_NONE;
+}
+
+static uint8_t advance(uint8_t addr) {
+    return (addr >= ZONE_ADDR_LAST) ? ZONE_ADDR_FIRST : addr + 1;
+}
+
+// interval >= probe_time / budget  =>  probe share of bus time <= budget
+static uint16_t probe_interval_ms(uint8_t bus) {
+    uint32_t clock_hz = i2c_bus_clock_hz(bus);
+    if (clock_hz == 0) return 1000;
+
+    uint32_t probe_us = (PROBE_BIT_TIMES * 1000000UL) / clock_hz;
+    uint32_t interval = (probe_us + DISCOVERY_BUS_BUDGET_PERMILLE - 1) / DISCOVERY_BUS_BUDGET_PERMILLE;
+    return (interval > 0) ? (uint16_t)interval : 1;
+}
+
+static void probe_done(I2cXfer_t* xfer) {
+    uint8_t addr = xfer->addr >> 1;
+    Zone_t* zone = zone_table_lookup(addr);
+
+    probe_in_flight[xfer->bus] = 0;
+
+    // Same address on another bus: that node is not a zone (see zone_table.c)
+    if (zone != NULL && zone->bus != xfer->bus) return;
+
+    if (xfer->status == I2C_XFER_OK && zone == NULL) {
+        if (zone_table_add(xfer->bus, addr) != ZONE_NONE) {
+            zone_link_init(zone_table_lookup(addr));
+            node_controller_zone_added(addr);
+            stats.zones_added++;
+        }
+    }
+}
+
+static void remove_absent(uint32_t now) {
+    for (uint8_t i = zone_table_count(); i-- > 0;) {
+        Zone_t* zone = zone_table_get(i);
+        if (!zone_link_absent(zone, now)) continue;
+
+        uint8_t addr = zone->addr;
+        node_controller_zone_removed(addr);
+        zone_table_remove(addr);
+        stats.zones_removed++;
+    }
+}
+
+// Public functions
+void zone_discovery_boot_scan(void) {
+    memset(&stats, 0, sizeof(stats));
+    uint32_t start = HAL_GetTick();
+    uint8_t addr[I2C_BUS_COUNT];
+    uint8_t busy;
+
+    memset(addr, ZONE_ADDR_FIRST, sizeof(addr));
+
+    // All buses scan at once; each loop tops up every queue then drains
+    do {
+        busy = 0;
+        for (uint8_t bus = 0; bus < I2C_BUS_COUNT; bus++) {
+            if (!i2c_bus_is_ready(bus)) continue;
+
+            while (addr[bus] <= ZONE_ADDR_LAST) {
+                if (is_candidate(addr[bus]) && !i2c_bus_submit_probe(bus, addr[bus] << 1, probe_done, NULL)) {
+                    break;      // Queue full - drain some first
+                }
+                addr[bus]++;
+            }
+            if (addr[bus] <= ZONE_ADDR_LAST || !i2c_bus_is_idle(bus)) busy = 1;
+        }
+        i2c_bus_process();
+    } while (busy);
+
+    stats.boot_scan_ms = HAL_GetTick() - start;
+    stats.boot_zones_found = zone_table_count();
+    stats.zones_added = 0;
+    stats.probe_interval_ms = probe_interval_ms(I2C_BUS_1);
+
+    for (uint8_t bus = 0; bus < I2C_BUS_COUNT; bus++) {
+        next_addr[bus] = ZONE_ADDR_FIRST;
+        probe_in_flight[bus] = 0;
+        last_probe_tick[bus] = HAL_GetTick();
+    }
+}
+
+void zone_discovery_process(void) {
+    uint32_t now = HAL_GetTick();
+
+    remove_absent(now);
+
+    for (uint8_t bus = 0; bus < I2C_BUS_COUNT; bus++) {
+        if (!i2c_bus_is_ready(bus)) continue;
+
+        // Bus speed may change at runtime; keep the budget honest
+        uint16_t interval = probe_interval_ms(bus);
+        if (probe_in_flight[bus] || now - last_probe_tick[bus] < interval) continue;
+
+        // Registered zones and the OLED are never probed; every address
+        // taken means nothing to do this round
+        uint8_t skipped = 0;
+        while (!is_candidate(next_addr[bus]) && skipped <= ZONE_ADDR_LAST - ZONE_ADDR_FIRST) {
+            next_addr[bus] = advance(next_addr[bus]);
+            skipped++;
+        }
+        if (!is_candidate(next_addr[bus])) continue;
+
+        if (i2c_bus_submit_probe(bus, next_addr[bus] << 1, probe_done, NULL)) {
+            probe_in_flight[bus] = 1;
+            last_probe_tick[bus] = now;
+            stats.probes_sent++;
+            next_addr[bus] = advance(next_addr[bus]);
+        }
+        stats.probe_interval_ms = interval;
+    }
+}
+
+const DiscoveryStats_t* zone_discovery_get_stats(void) {
+    return &stats;
+}
@@ -0,0 +1,201 @@
+/*
+ * zone_link.c
+ *
+ * Per-zone I2C link quality and speed fallback.
+ *
+ * The bus runs in Fast Mode (400 kHz). Every zone transfer reports how many
+ * attempts it took and how they failed; once per LINK_WINDOW_ATTEMPTS the
+ * zone's error share is checked:
+ * - above LINK_FALLBACK_PERMILLE the zone is marked slow in i2c_bus and
+ *   its traffic drops to Standard Mode (100 kHz) - other zones stay fast
+ * - LINK_RESTORE_WINDOWS clean windows in a row bring it back to Fast Mode
+ *
+ * Effective throughput is the payload of successful transfers per second.
+ * Every transfer also lands in the zone's diagnostics: retry/NACK/ARLO/
+ * timeout counters and a log2 histogram of its wire time (DWT cycles
+ * measured by i2c_bus, all attempts included).
+ *
+ * Circuit breaker (one per zone):
+ *   HEALTHY --fail--> SUSPECT --LINK_QUARANTINE_FAILS in a row--> QUARANTINED
+ *   SUSPECT --ok--> HEALTHY
+ *   QUARANTINED: no sensor reads or commands. An address-only probe is sent
+ *   after backoff_ms; a NACK doubles the backoff (up to LINK_BACKOFF_MAX_MS),
+ *   an ACK moves the zone to SUSPECT with one failure of credit left, so
+ *   the next real transfer either closes the breaker or re-opens it.
+ * Dead zones therefore cost one probe per backoff period, and healthy
+ * zones keep their poll period however many zones are dead. After
+ * LINK_ABSENT_REMOVE_MS in quarantine with no probe answered the zone
+ * counts as absent, and discovery removes it.
+ */
+
+#include "zone_link.h"
+#include <stddef.h>
+#include <string.h>
+
+// Probe context carries the zone address (slots can move)
+#define ADDR_CTX(addr)   ((void*)(uintptr_t)(addr))
+#define CTX_ADDR(ctx)    ((uint8_t)(uintptr_t)(ctx))
+
+// Private state
+static uint32_t last_rate_tick = 0;
+
+// log2 bucket of a transfer time; __CLZ(0) is 32, so short transfers land in 0
+static inline uint8_t latency_bucket(uint32_t us) {
+    uint8_t bucket = 32 - __CLZ(us >> ZONE_LATENCY_BASE_SHIFT);
+    return (bucket < ZONE_LATENCY_BUCKETS) ? bucket : ZONE_LATENCY_BUCKETS - 1;
+}
+
+static void set_slow(Zone_t* zone, uint8_t slow) {
+    zone->link.slow = slow;
+    zone->link.clean_windows = 0;
+    i2c_bus_set_device_slow(zone->bus, zone->addr << 1, slow);
+}
+
+static void close_window(Zone_t* zone) {
+    ZoneLink_t* link = &zone->link;
+
+    link->error_permille = (uint16_t)((link->window_errors * 1000UL) / link->window_attempts);
+
+    if (!link->slow) {
+        if (link->error_permille > LINK_FALLBACK_PERMILLE) set_slow(zone, 1);
+    } else if (link->error_permille <= LINK_CLEAN_PERMILLE) {
+        if (++link->clean_windows >= LINK_RESTORE_WINDOWS) set_slow(zone, 0);
+    } else {
+        link->clean_windows = 0;
+    }
+
+    link->window_attempts = 0;
+    link->window_errors = 0;
+}
+
+static void quarantine(Zone_t* zone, uint32_t now) {
+    ZoneLink_t* link = &zone->link;
+
+    if (link->backoff_ms == 0) {
+        link->backoff_ms = LINK_BACKOFF_MIN_MS;
+    } else if (link->backoff_ms < LINK_BACKOFF_MAX_MS) {
+        link->backoff_ms *= 2;
+    }
+    if (link->health != ZONE_QUARANTINED) link->quarantined_tick = now;
+    link->health = ZONE_QUARANTINED;
+    link->next_probe_tick = now + link->backoff_ms;
+}
+
+static void update_health(Zone_t* zone, uint8_t ok) {
+    ZoneLink_t* link = &zone->link;
+
+    if (ok) {
+        link->health = ZONE_HEALTHY;
+        link->fail_streak = 0;
+        link->backoff_ms = 0;
+    } else if (link->health != ZONE_QUARANTINED) {
+        link->health = ZONE_SUSPECT;
+        if (++link->fail_streak >= LINK_QUARANTINE_FAILS) {
+            link->quarantines++;
+            quarantine(zone, HAL_GetTick());
+        }
+    }
+}
+
+static void probe_done(I2cXfer_t* xfer) {
+    Zone_t* zone = zone_table_lookup(CTX_ADDR(xfer->ctx));
+    if (zone == NULL) return;
+
+    ZoneLink_t* link = &zone->link;
+    link->probe_pending = 0;
+    if (link->health != ZONE_QUARANTINED) return;
+
+    if (xfer->status == I2C_XFER_OK) {
+        // Half-open: one more failure re-quarantines with a longer backoff
+        link->health = ZONE_SUSPECT;
+        link->fail_streak = LINK_QUARANTINE_FAILS - 1;
+    } else {
+        quarantine(zone, HAL_GetTick());
+    }
+}
+
+// Public functions
+void zone_link_init(Zone_t* zone) {
+    if (zone == NULL) return;
+    memset(&zone->link, 0, sizeof(zone->link));
+    i2c_bus_set_device_slow(zone->bus, zone->addr << 1, 0);
+}
+
+// Called from each zone transfer's completion handler
+void zone_link_record(Zone_t* zone, const I2cXfer_t* xfer) {
+    ZoneLink_t* link = &zone->link;
+    uint8_t errors = xfer->nacks + xfer->bus_errors;
+    uint8_t attempts = errors + (xfer->status == I2C_XFER_OK ? 1 : 0);
+
+    uint32_t us = xfer->bus_cycles / (SystemCoreClock / 1000000U);
+
+    link->attempts += attempts;
+    link->nacks += xfer->nacks;
+    link->bus_errors += xfer->bus_errors;
+    link->arb_lost += xfer->arb_lost;
+    link->timeouts += xfer->timeouts;
+    link->transfers++;
+    link->retries += attempts - 1;
+    link->window_attempts += attempts;
+    link->window_errors += errors;
+
+    link->last_xfer_us = us;
+    if (us > link->max_xfer_us) link->max_xfer_us = us;
+    link->latency_hist[latency_bucket(us)]++;
+
+    if (xfer->status == I2C_XFER_OK) {
+        link->rate_bytes += xfer->len;
+        link->last_ok_tick = xfer->done_tick;
+    }
+
+    if (link->window_attempts >= LINK_WINDOW_ATTEMPTS) {
+        close_window(zone);
+    }
+
+    update_health(zone, xfer->status == I2C_XFER_OK);
+}
+
+// An acked frame that failed its PEC still counts against the bus speed
+void zone_link_record_corrupt(Zone_t* zone) {
+    zone->link.pec_errors++;
+    zone->link.window_errors++;
+}
+
+// Sends due quarantine probes and rolls the throughput figures once per
+// LINK_RATE_PERIOD_MS
+void zone_link_process(void) {
+    uint32_t now = HAL_GetTick();
+    uint32_t elapsed = now - last_rate_tick;
+    uint8_t count = zone_table_count();
+
+    for (uint8_t i = 0; i < count; i++) {
+        Zone_t* zone = zone_table_get(i);
+        ZoneLink_t* link = &zone->link;
+
+        if (link->health != ZONE_QUARANTINED || link->probe_pending) continue;
+        if ((int32_t)(now - link->next_probe_tick) < 0) continue;
+
+        if (i2c_bus_submit_probe(zone->bus, zone->addr << 1, probe_done, ADDR_CTX(zone->addr))) {
+            link->probe_pending = 1;
+        }
+    }
+
+    if (elapsed < LINK_RATE_PERIOD_MS) return;
+    last_rate_tick = now;
+
+    for (uint8_t i = 0; i < count; i++) {
+        ZoneLink_t* link = &zone_table_get(i)->link;
+        link->bytes_per_sec = (uint16_t)((link->rate_bytes * 1000UL) / elapsed);
+        link->rate_bytes = 0;
+    }
+}
+
+// Quarantined zones get no reads or commands
+uint8_t zone_link_usable(const Zone_t* zone) {
+    return zone->link.health != ZONE_QUARANTINED;
+}
+
+uint8_t zone_link_absent(const Zone_t* zone, uint32_t now) {
+    return zone->link.health == ZONE_QUARANTINED &&
+           now - zone->link.quarantined_tick >= LINK_ABSENT_REMOVE_MS;
+}
@@ -0,0 +1,167 @@
+/*
+ * zone_persist.c
+ *
+ * Keeps what the control loop needs to resume after a reset (watchdog,
+ * stack canary) in the emulated EEPROM, so a zone goes back under
+ * control as soon as discovery finds it again instead of waiting for
+ * someone at the keypad.
+ *
+ * Two variables per zone, by I2C address (address 0, the general call,
+ * is never a zone; its slot holds the clock):
+ * - state: assigned profile | desired outputs << 8. Saved on assignment
+ *   and whenever a non-pump output changes. Restoring the outputs keeps a
+ *   node's relays where they were instead of dropping and re-asserting
+ *   them. The pump is not saved; it follows from the irrigation stamp.
+ * - irrigation: start of the last pump run in run-time seconds, bit 15
+ *   set while the run lasts. Two writes per irrigation cycle.
+ *
+ * Calibration overrides go in the ids left over (the clock's spare
+ * irrigation id, addresses below ZONE_ADDR_FIRST and past ZONE_ADDR_LAST),
+ * as PERSIST_CAL_SLOTS key/trim pairs. The key holds address, channel and
+ * curve; a channel back on the default curve with no trim frees its slot.
+ * The trim is written before the key, so a reset in between leaves a
+ * free slot or the previous key with the new trim.
+ *
+ * There is no RTC, so time across a reset is a run-time clock saved every
+ * PERSIST_CLOCK_SAVE_SEC and resumed at boot from the newest of it and
+ * the stamps. Time spent powered off is not counted: a zone resumes its
+ * irrigation cycle where it was, not where wall time would put it.
+ */
+
+#include "zone_persist.h"
+#include "eeprom_emul.h"
+#include "calibration.h"
+
+#define VAR_CLOCK               0
+#define VAR_STATE(addr)         (2 * (addr))
+#define VAR_IRRIGATION(addr)    (2 * (addr) + 1)
+
+// Spare id n: 1-13 below the zone range, then past it
+#define SPARE_LOW               (VAR_STATE(ZONE_ADDR_FIRST) - 1)
+#define VAR_SPARE(n)            ((n) < SPARE_LOW ? 1 + (n) : VAR_STATE(ZONE_ADDR_LAST + 1) + (n) - SPARE_LOW)
+#define VAR_CAL_KEY(slot)       VAR_SPARE(2 * (slot))
+#define VAR_CAL_TRIM(slot)      VAR_SPARE(2 * (slot) + 1)
+
+#define CAL_KEY_USED            0x8000
+#define CAL_KEY(addr, ch, curve) (CAL_KEY_USED | (addr) << 8 | (ch) << 4 | (curve))
+#define CAL_KEY_CHANNEL(key)    (((key) >> 4) & 0x0F)
+#define CAL_KEY_CURVE(key)      ((key) & 0x0F)
+#define CAL_KEY_ZONE            0xFF00      // Used flag and address
+#define CAL_KEY_SLOT            0xFFF0      // ... and channel
+
+_Static_assert(VAR_CAL_TRIM(PERSIST_CAL_SLOTS - 1) < EE_VAR_COUNT, "calibration slots past the EEPROM ids");
+_Static_assert(ZONE_MAX_CHANNELS <= 16 && CAL_CURVE_COUNT <= 16, "calibration key fields are 4 bits");
+
+#define STAMP_RUNNING           0x8000
+#define CLOCK_MASK              0x7FFF      // 15-bit seconds, wraps after ~9 h
+#define CLOCK_HALF              0x4000      // Differences past this are negative
+
+// Private state
+static uint16_t clock_base = 0;             // Run-time seconds at clock_tick
+static uint32_t clock_tick = 0;
+
+static uint16_t clock_now(uint32_t now) {
+    return (clock_base + (now - clock_tick) / 1000) & CLOCK_MASK;
+}
+
+// Resumes from the newest of the saved clock and every stamp, so no
+// stamp is ahead of the clock
+static void resume_clock(void) {
+    uint16_t value;
+
+    clock_base = ee_read(VAR_CLOCK, &value) ? (value & CLOCK_MASK) : 0;
+    for (uint16_t addr = ZONE_ADDR_FIRST; addr <= ZONE_ADDR_LAST; addr++) {
+        if (!ee_read(VAR_IRRIGATION(addr), &value)) continue;
+
+        uint16_t ahead = ((value & CLOCK_MASK) - clock_base) & CLOCK_MASK;
+        if (ahead != 0 && ahead < CLOCK_HALF) clock_base = value & CLOCK_MASK;
+    }
+    clock_tick = HAL_GetTick();
+}
+
+// Public functions
+void zone_persist_init(void) {
+    ee_init();
+    resume_clock();
+}
+
+// Advances the base at every save, so the tick counter wrapping does not
+// disturb the clock
+void zone_persist_process(uint32_t now) {
+    uint32_t elapsed_sec = (now - clock_tick) / 1000;
+    if (elapsed_sec < PERSIST_CLOCK_SAVE_SEC) return;
+
+    clock_base = (clock_base + elapsed_sec) & CLOCK_MASK;
+    clock_tick += elapsed_sec * 1000;
+    ee_write(VAR_CLOCK, clock_base);
+}
+
+uint8_t zone_persist_load(uint8_t addr, ZonePersist_t* out) {
+    uint16_t state, stamp;
+
+    if (addr < ZONE_ADDR_FIRST || addr > ZONE_ADDR_LAST || !ee_read(VAR_STATE(addr), &state)) return 0;
+
+    out->profile = state & 0xFF;
+    out->actuators = (state >> 8) & ~ACT_PUMP;
+    out->has_irrigation = ee_read(VAR_IRRIGATION(addr), &stamp);
+    out->irrigating = 0;
+    out->irrigation_age_sec = 0;
+
+    if (out->has_irrigation) {
+        uint16_t age = (clock_now(HAL_GetTick()) - stamp) & CLOCK_MASK;
+        out->irrigating = (stamp & STAMP_RUNNING) != 0;
+        out->irrigation_age_sec = (age < CLOCK_HALF) ? age : 0;
+    }
+    return 1;
+}
+
+void zone_persist_save_state(const Zone_t* zone) {
+    if (zone->addr < ZONE_ADDR_FIRST || zone->addr > ZONE_ADDR_LAST) return;
+    ee_write(VAR_STATE(zone->addr), zone->assigned_profile | ((zone->desired & ~ACT_PUMP) << 8));
+}
+
+void zone_persist_save_irrigation(const Zone_t* zone, uint8_t running, uint32_t now) {
+    uint16_t started = (clock_now(now) - (now - zone->last_irrigation_time) / 1000) & CLOCK_MASK;
+
+    if (zone->addr < ZONE_ADDR_FIRST || zone->addr > ZONE_ADDR_LAST) return;
+    ee_write(VAR_IRRIGATION(zone->addr), started | (running ? STAMP_RUNNING : 0));
+}
+
+uint8_t zone_persist_save_calibration(const Zone_t* zone, uint8_t channel) {
+    uint16_t match = CAL_KEY(zone->addr, channel, 0);
+    uint8_t slot = PERSIST_CAL_SLOTS, free_slot = PERSIST_CAL_SLOTS;
+    uint16_t key;
+
+    if (zone->addr < ZONE_ADDR_FIRST || zone->addr > ZONE_ADDR_LAST || channel >= ZONE_MAX_CHANNELS) return 0;
+
+    for (uint8_t i = 0; i < PERSIST_CAL_SLOTS && slot == PERSIST_CAL_SLOTS; i++) {
+        if (!ee_read(VAR_CAL_KEY(i), &key) || !(key & CAL_KEY_USED)) {
+            if (free_slot == PERSIST_CAL_SLOTS) free_slot = i;
+        } else if ((key & CAL_KEY_SLOT) == match) {
+            slot = i;
+        }
+    }
+
+    if (zone->cal_curve[channel] == CAL_CURVE_DEFAULT && zone->cal_offset[channel] == 0) {
+        return (slot == PERSIST_CAL_SLOTS) || ee_write(VAR_CAL_KEY(slot), 0);
+    }
+    if (slot == PERSIST_CAL_SLOTS) slot = free_slot;
+    if (slot == PERSIST_CAL_SLOTS) return 0;
+
+    return ee_write(VAR_CAL_TRIM(slot), (uint16_t)zone->cal_offset[channel]) &&
+           ee_write(VAR_CAL_KEY(slot), CAL_KEY(zone->addr, channel, zone->cal_curve[channel]));
+}
+
+void zone_persist_load_calibration(Zone_t* zone) {
+    uint16_t match = CAL_KEY(zone->addr, 0, 0);
+    uint16_t key, trim;
+
+    for (uint8_t i = 0; i < PERSIST_CAL_SLOTS; i++) {
+        if (!ee_read(VAR_CAL_KEY(i), &key) || (key & CAL_KEY_ZONE) != match) continue;
+
+        uint8_t channel = CAL_KEY_CHANNEL(key);
+        if (channel >= ZONE_MAX_CHANNELS || CAL_KEY_CURVE(key) >= CAL_CURVE_COUNT) continue;
+        zone->cal_curve[channel] = CAL_KEY_CURVE(key);
+        zone->cal_offset[channel] = ee_read(VAR_CAL_TRIM(i), &trim) ? (int16_t)trim : 0;
+    }
+}
@@ -0,0 +1,104 @@
+/*
+ * zone_table.c
+ *
+ * Registry of field-node zones keyed by 7-bit I2C address.
+ *
+ * Zones are kept dense in zones[0..count-1] so every module iterates
+ * the live zones only, in node number order (see zone_table_node_number),
+ * whatever order discovery found them in. An address -> index map gives
+ * O(1) lookup from I2C completion handlers. Adding or removing a zone
+ * shifts the ones numbered after it, so indices are stable only until the
+ * next change - hold on to addresses, not indices or pointers, across bus
+ * transactions and keypad steps.
+ *
+ * Zones may sit on any of the I2C buses, but an address identifies one
+ * zone system-wide: a second node answering the same address on another
+ * bus is not registered.
+ */
+
+#include "zone_table.h"
+#include <stddef.h>
+#include <string.h>
+
+// Private state
+static Zone_t zones[ZONE_MAX];
+static uint8_t zone_count = 0;
+static uint8_t zone_index[128];     // addr -> index, ZONE_NONE if unknown
+
+void zone_table_init(void) {
+    zone_count = 0;
+    memset(zones, 0, sizeof(zones));
+    memset(zone_index, ZONE_NONE, sizeof(zone_index));
+}
+
+static void reindex(uint8_t from) {
+    for (uint8_t i = from; i < zone_count; i++) {
+        zone_index[zones[i].addr] = i;
+    }
+}
+
+// Returns the zone index, or ZONE_NONE if the table is full
+uint8_t zone_table_add(uint8_t bus, uint8_t addr) {
+    if (addr >= 128) return ZONE_NONE;
+    if (zone_index[addr] != ZONE_NONE) return zone_index[addr];
+    if (zone_count >= ZONE_MAX) return ZONE_NONE;
+
+    uint8_t index = zone_count;
+    while (index > 0 && zone_table_node_number(zones[index - 1].addr) > zone_table_node_number(addr)) {
+        index--;
+    }
+    memmove(&zones[index + 1], &zones[index], (zone_count - index) * sizeof(Zone_t));
+
+    Zone_t* zone = &zones[index];
+    memset(zone, 0, sizeof(Zone_t));
+    zone->addr = addr;
+    zone->bus = bus;
+    zone->assigned_profile = PROFILE_NONE;
+    zone->fw_version = ZONE_FW_LEGACY;
+
+    zone_count++;
+    reindex(index);
+    return index;
+}
+
+void zone_table_remove(uint8_t addr) {
+    uint8_t index = zone_table_find(addr);
+    if (index == ZONE_NONE) return;
+
+    zone_count--;
+    memmove(&zones[index], &zones[index + 1], (zone_count - index) * sizeof(Zone_t));
+    zone_index[addr] = ZONE_NONE;
+    reindex(index);
+}
+
+// Fixed per address, so a node keeps its number (telemetry key, keypad
+// label) however many nodes come and go: the two original nodes stay
+// node1 (0x08) and node2 (0x07), every other address follows in order
+uint8_t zone_table_node_number(uint8_t addr) {
+    if (addr == 0x08) return 1;
+    if (addr == 0x07) return 2;
+    return addr - 6;
+}
+
+uint8_t zone_table_find(uint8_t addr) {
+    return (addr < 128) ? zone_index[addr] : ZONE_NONE;
+}
+
+uint8_t zone_table_count(void) {
+    return zone_count;
+}
+
+Zone_t* zone_table_get(uint8_t index) {
+    return (index < zone_count) ? &zones[index] : NULL;
+}
+
+Zone_t* zone_table_lookup(uint8_t addr) {
+    return zone_table_get(zone_table_find(addr));
+}
+
+// Milliseconds since the snapshot in sensors[] was latched. Failed, corrupt
+// and repeated reads leave sample_tick alone, so the age keeps growing.
+uint32_t zone_table_data_age(const Zone_t* zone, uint32_t now) {
+    if (!(zone->flags & ZONE_FLAG_SAMPLED)) return ZONE_AGE_NEVER;
+    return now - zone->sample_tick;
+}
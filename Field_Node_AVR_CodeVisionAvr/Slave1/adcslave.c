@@ -26,7 +26,15 @@ Data Stack size         : 512
 #include <delay.h>
 
 // Declare your global variables here
-unsigned int adc_values[3];  // Temp storage for reads
+
+// Node capabilities, published in the descriptor so the master sizes its
+// reads from them: change these rather than forking the firmware
+#define NODE_CHANNELS     3     // ADC0..ADC(n-1), up to 8
+#define NODE_ACTUATORS    4     // Outputs on PD2 upwards, up to 6
+#define ADC_RESOLUTION    10    // Bits per sample
+#define ACT_MASK          ((1 << NODE_ACTUATORS) - 1)
+
+unsigned int adc_values[NODE_CHANNELS];  // Temp storage for reads
 // Voltage Reference: AVCC pin
 #define ADC_VREF_TYPE ((0<<REFS1) | (1<<REFS0) | (0<<ADLAR))
 
@@ -58,12 +66,126 @@ unsigned int average_adc(unsigned char adc_input, unsigned char samples)
 // TWI functions
 #include <twi.h>
 
-// TWI Slave receive buffer
-#define TWI_RX_BUFFER_SIZE 1
+// TWI Slave receive buffer (command byte + up to 2 argument bytes)
+#define TWI_RX_BUFFER_SIZE 3
 unsigned char twi_rx_buffer[TWI_RX_BUFFER_SIZE];
 
-// TWI Slave transmit buffer
-#define TWI_TX_BUFFER_SIZE 6
+// Register map (read with a pointer write + repeated start, like an EEPROM)
+// Status block first, then one word per channel, so the frame is only as
+// long as the node is wide. A plain read starts at REG_ACTUATORS.
+#define REG_BASE          0x80  // Pointer bytes 0x80..0xBF select a register
+#define REG_ACTUATORS     0x00  // bit0=Pump bit1=Humidifier bit2=Fan bit3=Light 1
+#define REG_FW_VERSION    0x01
+#define REG_SAMPLE_SEQ    0x02  // Increments every time new samples are published
+#define REG_UPTIME        0x03  // Seconds since reset, 32-bit big-endian
+#define REG_RX_ERRORS     0x07  // TWI receive errors
+#define REG_CMD_ERRORS    0x08  // Unknown commands received
+#define REG_SENSORS       0x09  // NODE_CHANNELS x 16-bit averaged ADC, big-endian
+#define REG_COUNT         (REG_SENSORS + 2*NODE_CHANNELS)
+
+// Capability descriptor, read with pointer byte DESC_BASE
+#define DESC_BASE         0xC0
+#define DESC_COUNT        5
+#define PROTOCOL_VERSION  0x03  // 0x03: 0x21 PWM duty command
+
+#define FW_VERSION        0x05  // 0x03: reads end with an SMBus PEC byte
+                                // 0x04: capability descriptor, variable-width map
+                                // 0x05: Timer1 PWM on Fan/Light 1
+
+#define TWI_SLAVE_ADDR    0x08
+
+// SMBus PEC: CRC-8, polynomial 0x07, init 0
+flash unsigned char crc8_table[256]={
+    0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+    0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65, 0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D,
+    0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+    0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85, 0xA8, 0xAF, 0xA6, 0xA1, 0xB4, 0xB3, 0xBA, 0xBD,
+    0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2, 0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA,
+    0xB7, 0xB0, 0xB9, 0xBE, 0xAB, 0xAC, 0xA5, 0xA2, 0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+    0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32, 0x1F, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0D, 0x0A,
+    0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42, 0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A,
+    0x89, 0x8E, 0x87, 0x80, 0x95, 0x92, 0x9B, 0x9C, 0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+    0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC, 0xC1, 0xC6, 0xCF, 0xC8, 0xDD, 0xDA, 0xD3, 0xD4,
+    0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C, 0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44,
+    0x19, 0x1E, 0x17, 0x10, 0x05, 0x02, 0x0B, 0x0C, 0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+    0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B, 0x76, 0x71, 0x78, 0x7F, 0x6A, 0x6D, 0x64, 0x63,
+    0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B, 0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13,
+    0xAE, 0xA9, 0xA0, 0xA7, 0xB2, 0xB5, 0xBC, 0xBB, 0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+    0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB, 0xE6, 0xE1, 0xE8, 0xEF, 0xFA, 0xFD, 0xF4, 0xF3
+};
+
+unsigned char crc8(unsigned char crc, unsigned char data)
+{
+return crc8_table[crc ^ data];
+}
+
+// Magic byte first: an older node answers the descriptor pointer with
+// sensor data, whose first byte is never 0xD5
+flash unsigned char descriptor[DESC_COUNT]={0xD5, PROTOCOL_VERSION, NODE_CHANNELS, NODE_ACTUATORS, ADC_RESOLUTION};
+
+unsigned char twi_regs[REG_COUNT];
+unsigned char read_ptr = REG_BASE;  // Pointer byte of the next read
+volatile unsigned long uptime_sec = 0;
+unsigned int uptime_ms = 0;
+
+// Latest averages from the main loop, published to the register map either
+// continuously or, once the master has sent a latch, only on each latch
+unsigned int adc_live[NODE_CHANNELS];
+unsigned char latch_mode = 0;
+
+// PWM outputs: Fan on OC1B (PD4, actuator bit 2), Light 1 on OC1A (PD5, bit 3).
+// Duty 0 and 255 drive the pin as a plain output, so a relay on it still
+// works; anything in between hands the pin to Timer1. The port bit follows
+// "duty != 0" so REG_ACTUATORS keeps reporting the output as on.
+void set_duty(unsigned char bit, unsigned char duty)
+{
+unsigned char com, pin;
+if (bit == 2 && bit < NODE_ACTUATORS)
+   {
+   com = (1<<COM1B1);
+   pin = (1<<PORTD4);
+   OCR1B = duty;
+   }
+else if (bit == 3 && bit < NODE_ACTUATORS)
+   {
+   com = (1<<COM1A1);
+   pin = (1<<PORTD5);
+   OCR1A = duty;
+   }
+else
+   {
+   if (twi_regs[REG_CMD_ERRORS] < 255) twi_regs[REG_CMD_ERRORS]++;
+   return;
+   }
+if (duty == 0 || duty == 255) TCCR1A &= ~com;
+else TCCR1A |= com;
+if (duty == 0) PORTD &= ~pin;
+else PORTD |= pin;
+}
+
+// On/off commands take a PWM output back to plain port control
+void pwm_release(unsigned char act_bits)
+{
+if (act_bits & (1<<2)) TCCR1A &= ~(1<<COM1B1);
+if (act_bits & (1<<3)) TCCR1A &= ~(1<<COM1A1);
+}
+
+// Copies the live averages into the sensor registers as one snapshot.
+// Call with interrupts disabled (or from the TWI ISR).
+void latch_samples(void)
+{
+unsigned char i;
+for (i = 0; i < NODE_CHANNELS; i++)
+   {
+   twi_regs[REG_SENSORS + 2*i] = (adc_live[i] >> 8) & 0xFF;  // High byte
+   twi_regs[REG_SENSORS + 2*i + 1] = adc_live[i] & 0xFF;     // Low byte
+   }
+twi_regs[REG_SAMPLE_SEQ]++;
+}
+
+// TWI Slave transmit buffer (window of the register map or descriptor
+// starting at read_ptr, followed by the PEC byte)
+#define TWI_TX_BUFFER_SIZE (REG_COUNT + 1)
 unsigned char twi_tx_buffer[TWI_TX_BUFFER_SIZE];
 
 // TWI Slave receive handler
@@ -80,6 +202,17 @@ if (twi_result==TWI_RES_OK)
        // Command protocol:
        // 0x01-0x04: Toggle commands (manual mode)
        // 0x10-0x17: Explicit ON/OFF (automatic control)
+       // 0x20 mask value: Set all actuators in one frame
+       //      bit0=Pump bit1=Humidifier bit2=Fan bit3=Light 1
+       // 0x21 bit duty: PWM duty on Fan (bit 2) or Light 1 (bit 3)
+       // 0x30: Latch samples (sent as a general call to every node at once)
+       // 0x80+n: Set register pointer for the next read
+       // 0xC0+n: Point the next read at the capability descriptor
+       if (cmd >= REG_BASE) {
+           read_ptr = cmd;
+           return false;
+       }
+
        switch(cmd) {
            // ===== TOGGLE COMMANDS (Manual Mode) =====
             case 0x01:  // Toggle Pump
@@ -89,9 +222,11 @@ if (twi_result==TWI_RES_OK)
                 PORTD ^= (1<<PORTD3);
                 break;
             case 0x03:  // Toggle Fan 
+                pwm_release(1<<2);
                 PORTD ^= (1<<PORTD4);
                 break;
             case 0x04:  // Toggle Grow Light 1 
+                pwm_release(1<<3);
                 PORTD ^= (1<<PORTD5);
                 break;
            
@@ -113,22 +248,45 @@ if (twi_result==TWI_RES_OK)
 
             // ===== EXPLICIT FAN CONTROL (Auto Mode) =====
             case 0x14:  // Fan OFF 
+                pwm_release(1<<2);
                 PORTD &= ~(1<<PORTD4);
                 break;
             case 0x15:  // Fan ON 
+                pwm_release(1<<2);
                 PORTD |= (1<<PORTD4);
                 break;
 
             // ===== EXPLICIT LIGHT 1 CONTROL (Auto Mode) =====
             case 0x16:  // Light 1 OFF 
+                pwm_release(1<<3);
                 PORTD &= ~(1<<PORTD5);
                 break;
             case 0x17:  // Light 1 ON 
+                pwm_release(1<<3);
                 PORTD |= (1<<PORTD5);
                 break;
+
+            // ===== SET ALL ACTUATORS (Auto Mode) =====
+            case 0x20:  // Only bits set in mask change; PD2 upwards follow value
+                if (twi_rx_index >= 3) {
+                    unsigned char mask = (twi_rx_buffer[1] & ACT_MASK) << PORTD2;
+                    pwm_release(twi_rx_buffer[1]);
+                    PORTD = (PORTD & ~mask) | ((twi_rx_buffer[2] << PORTD2) & mask);
+                }
+                break;
+
+            case 0x21:  // PWM duty: actuator bit, duty 0-255
+                if (twi_rx_index >= 3) set_duty(twi_rx_buffer[1], twi_rx_buffer[2]);
+                break;
+
+            case 0x30:  // Freeze the current averages for the master's sweep
+                latch_mode = 1;
+                latch_samples();
+                break;
            
            default:
                // Unknown command - ignore
+               if (twi_regs[REG_CMD_ERRORS] < 255) twi_regs[REG_CMD_ERRORS]++;
                break;
        }
    }
@@ -136,6 +294,7 @@ if (twi_result==TWI_RES_OK)
 else
    {
    // Receive error
+   if (twi_regs[REG_RX_ERRORS] < 255) twi_regs[REG_RX_ERRORS]++;
    return false;
    }
 
@@ -157,10 +316,42 @@ unsigned char twi_tx_handler(bool tx_complete)
 if (tx_complete==false)
    {
    // Transmission from slave to master is about to start
-   // Return the number of bytes to transmit
-   return sizeof(twi_tx_buffer);
+   // Refresh live registers, copy the window from read_ptr, append the
+   // PEC and return the number of bytes to transmit.
+   // PEC covers the whole SMBus read: addr+W, pointer, addr+R, data.
+   unsigned char i, n, off, pec;
+   twi_regs[REG_ACTUATORS] = (PORTD >> PORTD2) & ACT_MASK;
+   twi_regs[REG_UPTIME] = (uptime_sec >> 24) & 0xFF;
+   twi_regs[REG_UPTIME + 1] = (uptime_sec >> 16) & 0xFF;
+   twi_regs[REG_UPTIME + 2] = (uptime_sec >> 8) & 0xFF;
+   twi_regs[REG_UPTIME + 3] = uptime_sec & 0xFF;
+   pec = crc8(0, TWI_SLAVE_ADDR << 1);
+   pec = crc8(pec, read_ptr);
+   pec = crc8(pec, (TWI_SLAVE_ADDR << 1) | 1);
+   if (read_ptr >= DESC_BASE) {
+       off = read_ptr - DESC_BASE;
+       if (off >= DESC_COUNT) off = 0;
+       n = DESC_COUNT - off;
+       for (i = 0; i < n; i++) {
+           twi_tx_buffer[i] = descriptor[off + i];
+           pec = crc8(pec, twi_tx_buffer[i]);
+       }
+   } else {
+       off = read_ptr - REG_BASE;
+       if (off >= REG_COUNT) off = 0;
+       n = REG_COUNT - off;
+       for (i = 0; i < n; i++) {
+           twi_tx_buffer[i] = twi_regs[off + i];
+           pec = crc8(pec, twi_tx_buffer[i]);
+       }
+   }
+   twi_tx_buffer[n] = pec;
+   return n + 1;
    }
 
+// Next plain read starts at the status block again
+read_ptr = REG_BASE;
+
 // Transmission from slave to master has finished
 // Place code here to eventually process data from
 // the twi_rx_buffer, if it wasn't yet processed
@@ -170,9 +361,20 @@ if (tx_complete==false)
 return 0;
 }
 
+// Timer2 output compare interrupt service routine - 1 ms tick for uptime
+interrupt [TIM2_COMP] void timer2_comp_isr(void)
+{
+if (++uptime_ms >= 1000)
+   {
+   uptime_ms = 0;
+   uptime_sec++;
+   }
+}
+
 void main(void)
 {
 // Declare your local variables here
+unsigned char ch;
 
 // Input/Output Ports initialization
 // Port A initialization
@@ -194,8 +396,8 @@ DDRC=(0<<DDC7) | (0<<DDC6) | (0<<DDC5) | (0<<DDC4) | (0<<DDC3) | (0<<DDC2) | (0<
 PORTC=(0<<PORTC7) | (0<<PORTC6) | (0<<PORTC5) | (0<<PORTC4) | (0<<PORTC3) | (0<<PORTC2) | (0<<PORTC1) | (0<<PORTC0);
 
 // Port D initialization
-// Function: Bit7=In Bit6=In Bit5=Out Bit4=Out Bit3=Out Bit2=Out Bit1=In Bit0=In 
-DDRD=(0<<DDD7) | (0<<DDD6) | (1<<DDD5) | (1<<DDD4) | (1<<DDD3) | (1<<DDD2) | (0<<DDD1) | (0<<DDD0);
+// Function: Bit2 upwards=Out for each of the NODE_ACTUATORS outputs, rest In
+DDRD=ACT_MASK << DDD2;
 // State: Bit7=T Bit6=T Bit5=0 Bit4=0 Bit3=0 Bit2=0 Bit1=T Bit0=T 
 PORTD=(0<<PORTD7) | (0<<PORTD6) | (0<<PORTD5) | (0<<PORTD4) | (0<<PORTD3) | (0<<PORTD2) | (0<<PORTD1) | (0<<PORTD0);
 
@@ -207,28 +409,61 @@ ADMUX=ADC_VREF_TYPE;
 ADCSRA=(1<<ADEN) | (0<<ADSC) | (1<<ADATE) | (0<<ADIF) | (0<<ADIE) | (0<<ADPS2) | (1<<ADPS1) | (1<<ADPS0);
 SFIOR=(0<<ADTS2) | (0<<ADTS1) | (0<<ADTS0);
 
+// Timer/Counter 1 initialization
+// Clock source: System Clock
+// Clock value: 1000.000 kHz
+// Mode: Fast PWM top=0x00FF
+// OC1A output: Disconnected until a duty command (Light 1, PD5)
+// OC1B output: Disconnected until a duty command (Fan, PD4)
+// Timer Period: 0.256 ms
+TCCR1A=(0<<COM1A1) | (0<<COM1A0) | (0<<COM1B1) | (0<<COM1B0) | (0<<WGM11) | (1<<WGM10);
+TCCR1B=(0<<ICNC1) | (0<<ICES1) | (0<<WGM13) | (1<<WGM12) | (0<<CS12) | (1<<CS11) | (0<<CS10);
+TCNT1H=0x00;
+TCNT1L=0x00;
+OCR1AH=0x00;
+OCR1AL=0x00;
+OCR1BH=0x00;
+OCR1BL=0x00;
+
+// Timer/Counter 2 initialization
+// Clock source: System Clock
+// Clock value: 125.000 kHz
+// Mode: CTC top=OCR2
+// OC2 output: Disconnected
+// Timer Period: 1 ms
+ASSR=0<<AS2;
+TCCR2=(0<<WGM20) | (0<<COM21) | (0<<COM20) | (1<<WGM21) | (1<<CS22) | (0<<CS21) | (0<<CS20);
+TCNT2=0x00;
+OCR2=0x7C;
+
+// Timer(s)/Counter(s) Interrupt(s) initialization
+TIMSK=(1<<OCIE2) | (0<<TOIE2) | (0<<TICIE1) | (0<<OCIE1A) | (0<<OCIE1B) | (0<<TOIE1) | (0<<OCIE0) | (0<<TOIE0);
+
+twi_regs[REG_FW_VERSION] = FW_VERSION;
+
 // TWI initialization
 // Mode: TWI Slave
-// Match Any Slave Address: Off
+// Match Any Slave Address: On (TWGCE: also answer the general call,
+// address 0x00, for the latch broadcast)
 // I2C Bus Slave Address: 0x08
-twi_slave_init(false,0x08,twi_rx_buffer,sizeof(twi_rx_buffer),twi_tx_buffer,twi_rx_handler,twi_tx_handler);
+twi_slave_init(true,TWI_SLAVE_ADDR,twi_rx_buffer,sizeof(twi_rx_buffer),twi_tx_buffer,twi_rx_handler,twi_tx_handler);
 
 // Global enable interrupts
 #asm("sei")
 
 while (1) {
-        adc_values[0] = average_adc(0, 100);  // PA0/ADC0, average 8 samples
-        adc_values[1] = average_adc(1, 100);  // PA1/ADC1
-        adc_values[2] = average_adc(2, 100);  // PA2/ADC2
+        for (ch = 0; ch < NODE_CHANNELS; ch++) {
+            adc_values[ch] = average_adc(ch, 100);  // PAn/ADCn, average 100 samples
+        }
 
+        // Hand the averages over; publish them unless the master latches
+        // Interrupts off so a master read never sees a half-updated set
+        #asm("cli")
+        for (ch = 0; ch < NODE_CHANNELS; ch++) {
+            adc_live[ch] = adc_values[ch];
+        }
+        if (!latch_mode) latch_samples();
+        #asm("sei")
         
-        // Pack into 6-byte TX buffer: high/low per ADC (big-endian)
-        twi_tx_buffer[0] = (adc_values[0] >> 8) & 0xFF;  // ADC0 high
-        twi_tx_buffer[1] = adc_values[0] & 0xFF;         // ADC0 low
-        twi_tx_buffer[2] = (adc_values[1] >> 8) & 0xFF;  // ADC1 high
-        twi_tx_buffer[3] = adc_values[1] & 0xFF;         // ADC1 low
-        twi_tx_buffer[4] = (adc_values[2] >> 8) & 0xFF;  // ADC2 high
-        twi_tx_buffer[5] = adc_values[2] & 0xFF;         // ADC2 low
-
       }
 }
@@ -0,0 +1,42 @@
+/*
+ * eeprom_host.c
+ *
+ * eeprom_emul.c stand-in for host builds: no flash, the variables live in
+ * RAM and start out never written.
+ */
+
+#include "eeprom_emul.h"
+#include <string.h>
+
+// Private state
+static uint16_t values[EE_VAR_COUNT];
+static uint8_t written[EE_VAR_COUNT];
+static EeStats_t stats;
+
+// Public functions
+uint8_t ee_init(void) {
+    memset(written, 0, sizeof(written));
+    memset(&stats, 0, sizeof(stats));
+    return 1;
+}
+
+uint8_t ee_read(uint8_t var, uint16_t* value) {
+    if (var >= EE_VAR_COUNT || !written[var]) return 0;
+    *value = values[var];
+    return 1;
+}
+
+uint8_t ee_write(uint8_t var, uint16_t value) {
+    if (var >= EE_VAR_COUNT) return 0;
+    values[var] = value;
+    written[var] = 1;
+    return 1;
+}
+
+const EeStats_t* ee_get_stats(void) {
+    return &stats;
+}
+
+uint32_t ee_borrow_spare(void) {
+    return 0;
+}
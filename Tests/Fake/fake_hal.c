@@ -0,0 +1,332 @@
+/*
+ * fake_hal.c
+ *
+ * Simulated clock, GPIO and I2C peripherals behind the fake HAL (see
+ * stm32f4xx_hal.h in this directory).
+ *
+ * A transfer occupies the wire for its bits at the handle's ClockSpeed:
+ * START, 9 bits per byte (address, register, data, each with its ACK), a
+ * repeated START and second address byte for memory reads, STOP. A NACK
+ * ends it after the address byte. fake_run_us() fires completions in
+ * time order across all buses, with the callbacks marked as ISR context
+ * so a HAL_I2C_Init from there is counted.
+ */
+
+#include "fake_hal.h"
+#include <string.h>
+
+#define FAKE_I2C_TX         0
+#define FAKE_I2C_RX         1
+#define FAKE_I2C_MEM_TX     2
+#define FAKE_I2C_MEM_RX     3
+
+typedef struct {
+    I2C_HandleTypeDef* handle;
+    FakeI2cDevice_t devices[128];
+    FakeI2cCounters_t counters;
+    uint8_t lines_held;
+} FakeBus_t;
+
+uint32_t SystemCoreClock = 100000000;
+CoreDebug_Type fake_core_debug;
+uint32_t fake_primask = 0;
+uint32_t fake_apsr_ge = 0;
+uint32_t fake_simd_ops = 0;
+GPIO_TypeDef fake_gpioa, fake_gpiob;
+
+// Private state
+static uint64_t cycles = 0;
+static DWT_Type dwt;
+static FakeBus_t buses[FAKE_I2C_MAX_HANDLES];
+static uint8_t bus_count = 0;
+static uint8_t in_isr = 0;
+static GPIO_TypeDef* sda_port = NULL;
+static uint16_t sda_pin = 0;
+static uint8_t sda_held_pulses = 0;
+static uint32_t scl_pulses = 0;
+
+static FakeBus_t* bus_of(const I2C_HandleTypeDef* hi2c) {
+    for (uint8_t i = 0; i < bus_count; i++) {
+        if (buses[i].handle == hi2c) return &buses[i];
+    }
+    return NULL;
+}
+
+static uint64_t cycles_per_us(void) {
+    return SystemCoreClock / 1000000U;
+}
+
+static uint64_t wire_cycles(const I2C_HandleTypeDef* hi2c, uint32_t bits) {
+    return (uint64_t)bits * SystemCoreClock / hi2c->Init.ClockSpeed;
+}
+
+// START + address + register/data bytes + STOP, 9 bits per byte
+static uint32_t wire_bits(uint8_t kind, uint16_t len) {
+    switch (kind) {
+        case FAKE_I2C_MEM_TX: return 2 + 9 * (2 + len);
+        case FAKE_I2C_MEM_RX: return 3 + 9 * (3 + len);     // + repeated START and address
+        default:              return 2 + 9 * (1 + len);
+    }
+}
+
+static HAL_StatusTypeDef start(I2C_HandleTypeDef* hi2c, uint8_t kind, uint16_t addr,
+                               uint16_t mem_addr, uint8_t* data, uint16_t len) {
+    FakeBus_t* bus = bus_of(hi2c);
+    FakeI2cWire_t* wire = &hi2c->wire;
+    if (bus == NULL) return HAL_ERROR;
+    if (wire->active) return HAL_BUSY;
+
+    // I2C_WaitOnFlagUntilTimeout(BUSY) in the HAL start: I2C_TIMEOUT_BUSY_FLAG
+    if (bus->lines_held) {
+        bus->counters.busy_spins++;
+        if (in_isr || fake_primask) bus->counters.busy_spins_masked++;
+        cycles += 25 * (SystemCoreClock / 1000U);
+        return HAL_BUSY;
+    }
+
+    FakeI2cDevice_t* dev = &bus->devices[(addr >> 1) & 0x7F];
+    uint64_t duration = wire_cycles(hi2c, wire_bits(kind, len));
+
+    wire->active = 1;
+    wire->kind = kind;
+    wire->addr = addr;
+    wire->mem_addr = mem_addr;
+    wire->buf = data;
+    wire->len = len;
+    wire->error = HAL_I2C_ERROR_NONE;
+    dev->last_clock_hz = hi2c->Init.ClockSpeed;
+
+    if (!dev->present || dev->nack_next) {
+        if (dev->nack_next) dev->nack_next--;
+        wire->error = HAL_I2C_ERROR_AF;
+        duration = wire_cycles(hi2c, 2 + 9);
+    } else if (dev->berr_next) {
+        dev->berr_next--;
+        wire->error = HAL_I2C_ERROR_BERR;
+        duration /= 2;
+    } else if (dev->hang_next) {
+        dev->hang_next--;
+        duration = 0;
+    }
+
+    wire->done_cycle = duration ? cycles + duration : 0;
+    bus->counters.transfers++;
+    bus->counters.wire_cycles += duration;
+    return HAL_OK;
+}
+
+static void complete(FakeBus_t* bus) {
+    I2C_HandleTypeDef* hi2c = bus->handle;
+    FakeI2cWire_t* wire = &hi2c->wire;
+    FakeI2cDevice_t* dev = &bus->devices[(wire->addr >> 1) & 0x7F];
+
+    wire->active = 0;
+    in_isr = 1;
+    if (wire->error != HAL_I2C_ERROR_NONE) {
+        hi2c->ErrorCode = wire->error;
+        HAL_I2C_ErrorCallback(hi2c);
+    } else if (wire->kind == FAKE_I2C_RX || wire->kind == FAKE_I2C_MEM_RX) {
+        for (uint16_t i = 0; i < wire->len; i++) wire->buf[i] = dev->data[i % sizeof(dev->data)];
+        if (wire->kind == FAKE_I2C_MEM_RX) dev->last_mem_addr = wire->mem_addr;
+        dev->reads++;
+        if (wire->kind == FAKE_I2C_RX) HAL_I2C_MasterRxCpltCallback(hi2c);
+        else HAL_I2C_MemRxCpltCallback(hi2c);
+    } else {
+        uint16_t n = (wire->len < sizeof(dev->last_write)) ? wire->len : sizeof(dev->last_write);
+        if (n > 0) memcpy(dev->last_write, wire->buf, n);
+        if (wire->kind == FAKE_I2C_MEM_TX) dev->last_mem_addr = wire->mem_addr;
+        dev->writes++;
+        if (wire->kind == FAKE_I2C_TX) HAL_I2C_MasterTxCpltCallback(hi2c);
+        else HAL_I2C_MemTxCpltCallback(hi2c);
+    }
+    in_isr = 0;
+}
+
+static FakeBus_t* next_due(uint64_t until) {
+    FakeBus_t* next = NULL;
+    for (uint8_t i = 0; i < bus_count; i++) {
+        const FakeI2cWire_t* wire = &buses[i].handle->wire;
+        if (!wire->active || wire->done_cycle == 0 || wire->done_cycle > until) continue;
+        if (next == NULL || wire->done_cycle < next->handle->wire.done_cycle) next = &buses[i];
+    }
+    return next;
+}
+
+// Public functions
+void fake_reset(void) {
+    cycles = 0;
+    memset(&dwt, 0, sizeof(dwt));
+    memset(buses, 0, sizeof(buses));
+    bus_count = 0;
+    in_isr = 0;
+    fake_primask = 0;
+    sda_port = NULL;
+    sda_held_pulses = 0;
+    scl_pulses = 0;
+}
+
+void fake_i2c_attach(I2C_HandleTypeDef* hi2c) {
+    if (bus_count >= FAKE_I2C_MAX_HANDLES || bus_of(hi2c) != NULL) return;
+    memset(&hi2c->wire, 0, sizeof(hi2c->wire));
+    if (hi2c->Init.ClockSpeed == 0) hi2c->Init.ClockSpeed = 400000;
+    buses[bus_count++].handle = hi2c;
+}
+
+FakeI2cDevice_t* fake_i2c_device(I2C_HandleTypeDef* hi2c, uint8_t addr7) {
+    FakeBus_t* bus = bus_of(hi2c);
+    return (bus != NULL) ? &bus->devices[addr7 & 0x7F] : NULL;
+}
+
+const FakeI2cCounters_t* fake_i2c_counters(const I2C_HandleTypeDef* hi2c) {
+    FakeBus_t* bus = bus_of(hi2c);
+    return (bus != NULL) ? &bus->counters : NULL;
+}
+
+void fake_run_cycles(uint64_t n) {
+    uint64_t until = cycles + n;
+    FakeBus_t* bus;
+
+    while ((bus = next_due(until)) != NULL) {
+        if (bus->handle->wire.done_cycle > cycles) cycles = bus->handle->wire.done_cycle;
+        complete(bus);
+    }
+    if (until > cycles) cycles = until;
+}
+
+void fake_run_us(uint32_t us) {
+    fake_run_cycles((uint64_t)us * cycles_per_us());
+}
+
+uint64_t fake_next_event(void) {
+    FakeBus_t* bus = next_due(UINT64_MAX);
+    if (bus == NULL) return 0;
+    uint64_t due = bus->handle->wire.done_cycle;
+    return (due > cycles) ? due - cycles : 1;
+}
+
+uint64_t fake_cycles(void) {
+    return cycles;
+}
+
+uint64_t fake_now_us(void) {
+    return cycles / cycles_per_us();
+}
+
+void fake_gpio_hold_sda(GPIO_TypeDef* port, uint16_t pin, uint8_t pulses) {
+    sda_port = port;
+    sda_pin = pin;
+    sda_held_pulses = pulses;
+}
+
+uint32_t fake_gpio_scl_pulses(void) {
+    return scl_pulses;
+}
+
+// Clock and cycle counter
+DWT_Type* fake_dwt(void) {
+    dwt.CYCCNT = (uint32_t)++cycles;
+    return &dwt;
+}
+
+uint32_t HAL_GetTick(void) {
+    return (uint32_t)(cycles / (SystemCoreClock / 1000U));
+}
+
+// GPIO
+void HAL_GPIO_Init(GPIO_TypeDef* port, GPIO_InitTypeDef* init) {
+    (void)port;
+    (void)init;
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* port, uint16_t pin) {
+    if (port == sda_port && pin == sda_pin && sda_held_pulses) return GPIO_PIN_RESET;
+    return (port->odr & pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+// Any other pin rising counts as an SCL pulse
+void HAL_GPIO_WritePin(GPIO_TypeDef* port, uint16_t pin, GPIO_PinState state) {
+    uint8_t rising = state == GPIO_PIN_SET && !(port->odr & pin);
+
+    if (state == GPIO_PIN_SET) port->odr |= pin;
+    else port->odr &= ~(uint32_t)pin;
+
+    if (rising && !(port == sda_port && pin == sda_pin)) {
+        scl_pulses++;
+        if (sda_held_pulses) sda_held_pulses--;
+    }
+}
+
+// I2C
+void fake_i2c_hold_lines(I2C_HandleTypeDef* hi2c) {
+    FakeBus_t* bus = bus_of(hi2c);
+    if (bus != NULL) bus->lines_held = 1;
+}
+
+uint8_t fake_i2c_busy(const I2C_HandleTypeDef* hi2c) {
+    FakeBus_t* bus = bus_of(hi2c);
+    return hi2c->wire.active || (bus != NULL && bus->lines_held);
+}
+
+// Resets the peripheral: a transfer still on the wire is cut off
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef* hi2c) {
+    FakeBus_t* bus = bus_of(hi2c);
+    if (bus != NULL) {
+        bus->counters.inits++;
+        if (in_isr) bus->counters.inits_in_isr++;
+        if (hi2c->wire.active) bus->counters.inits_while_busy++;
+        bus->lines_held = 0;
+    }
+    hi2c->wire.active = 0;
+    hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef* hi2c) {
+    hi2c->wire.active = 0;
+    return HAL_OK;
+}
+
+uint32_t HAL_I2C_GetError(I2C_HandleTypeDef* hi2c) {
+    return hi2c->ErrorCode;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_IT(I2C_HandleTypeDef* hi2c, uint16_t addr, uint8_t* data, uint16_t len) {
+    return start(hi2c, FAKE_I2C_TX, addr, 0, data, len);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Receive_IT(I2C_HandleTypeDef* hi2c, uint16_t addr, uint8_t* data, uint16_t len) {
+    return start(hi2c, FAKE_I2C_RX, addr, 0, data, len);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef* hi2c, uint16_t addr, uint16_t mem_addr,
+                                       uint16_t mem_size, uint8_t* data, uint16_t len) {
+    (void)mem_size;
+    return start(hi2c, FAKE_I2C_MEM_TX, addr, mem_addr, data, len);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef* hi2c, uint16_t addr, uint16_t mem_addr,
+                                      uint16_t mem_size, uint8_t* data, uint16_t len) {
+    (void)mem_size;
+    return start(hi2c, FAKE_I2C_MEM_RX, addr, mem_addr, data, len);
+}
+
+// Weak defaults, as in the HAL, for builds without i2c_bus.c
+__attribute__((weak)) void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef* hi2c) {
+    (void)hi2c;
+}
+
+__attribute__((weak)) void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef* hi2c) {
+    (void)hi2c;
+}
+
+__attribute__((weak)) void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef* hi2c) {
+    (void)hi2c;
+}
+
+__attribute__((weak)) void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef* hi2c) {
+    (void)hi2c;
+}
+
+__attribute__((weak)) void HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c) {
+    (void)hi2c;
+}
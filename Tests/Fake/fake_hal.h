@@ -0,0 +1,61 @@
+#ifndef FAKE_HAL_H
+#define FAKE_HAL_H
+
+#include <stdint.h>
+#include "stm32f4xx_hal.h"
+
+// Handles the simulation services (one per bus)
+#define FAKE_I2C_MAX_HANDLES    3
+
+// A slave on a simulated bus, by 7-bit address (0: the general call)
+typedef struct {
+    uint8_t  present;           // ACKs its address
+    uint8_t  nack_next;         // Attempts still to NACK
+    uint8_t  berr_next;         // Attempts still to end in a bus error
+    uint8_t  hang_next;         // Attempts still to stretch SCL forever
+    uint8_t  data[32];          // Returned by reads, from the first byte
+    uint32_t reads;
+    uint32_t writes;
+    uint8_t  last_write[8];
+    uint8_t  last_mem_addr;
+    uint32_t last_clock_hz;     // ClockSpeed of the last transfer addressed to it
+} FakeI2cDevice_t;
+
+typedef struct {
+    uint32_t transfers;         // Started on the wire
+    uint32_t inits;             // HAL_I2C_Init calls
+    uint32_t inits_in_isr;      // ... from a completion callback
+    uint32_t inits_while_busy;  // ... with a transfer or its STOP still on the wire
+    uint32_t busy_spins;        // HAL starts on a held bus: each spins 25 ms on BUSY
+    uint32_t busy_spins_masked; // ... from a completion callback or with IRQs masked
+    uint64_t wire_cycles;       // Time the wire was in use
+} FakeI2cCounters_t;
+
+// Public API
+// Clock back to 0, no handles, no devices, SDA released
+void fake_reset(void);
+void fake_i2c_attach(I2C_HandleTypeDef* hi2c);
+
+FakeI2cDevice_t* fake_i2c_device(I2C_HandleTypeDef* hi2c, uint8_t addr7);
+const FakeI2cCounters_t* fake_i2c_counters(const I2C_HandleTypeDef* hi2c);
+
+// Advances the clock, running completion callbacks in time order
+void fake_run_us(uint32_t us);
+
+// Cycles until the next completion on any bus, 0 if none is due
+uint64_t fake_next_event(void);
+void fake_run_cycles(uint64_t cycles);
+
+uint64_t fake_cycles(void);
+uint64_t fake_now_us(void);
+
+// SDA reads low until SCL has been pulsed this many times (slave stuck
+// mid-byte), for the recovery path
+void fake_gpio_hold_sda(GPIO_TypeDef* port, uint16_t pin, uint8_t pulses);
+uint32_t fake_gpio_scl_pulses(void);
+
+// A slave holds a line low: BUSY reads set until the next HAL_I2C_Init
+// (which follows bus recovery)
+void fake_i2c_hold_lines(I2C_HandleTypeDef* hi2c);
+
+#endif
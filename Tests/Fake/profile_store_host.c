@@ -0,0 +1,33 @@
+/*
+ * profile_store_host.c
+ *
+ * profile_store.c stand-in for host builds: no flash, so the compiled
+ * defaults in plant_profiles.c are all there is and edits stay in RAM.
+ */
+
+#include "profile_store.h"
+
+// Private state
+static ProfileStoreStats_t stats;
+
+// Public functions
+void profile_store_load(PlantProfile_t* table, uint8_t max, uint8_t* count) {
+    (void)table;
+    (void)max;
+    (void)count;
+}
+
+uint8_t profile_store_save(uint8_t index, const PlantProfile_t* table, uint8_t count) {
+    (void)index;
+    (void)table;
+    (void)count;
+    return 1;
+}
+
+void profile_store_process(uint8_t idle) {
+    (void)idle;
+}
+
+const ProfileStoreStats_t* profile_store_get_stats(void) {
+    return &stats;
+}
@@ -0,0 +1,197 @@
+#ifndef FAKE_STM32F4XX_HAL_H
+#define FAKE_STM32F4XX_HAL_H
+
+/*
+ * Host stand-in for the STM32F4 HAL, CMSIS core and DSP intrinsics, for
+ * building firmware modules on Linux (tests and benchmarks only). Core/Inc
+ * main.h includes "stm32f4xx_hal.h" and finds this one first.
+ *
+ * Time is simulated: one cycle counter at SystemCoreClock drives both
+ * HAL_GetTick() and DWT->CYCCNT and only moves when the test advances it
+ * (fake_run_us) or code reads DWT (one cycle per read, so busy waits end).
+ * The I2C peripherals put each transfer on a simulated wire: its time
+ * follows from the bytes and the handle's ClockSpeed, and the completion
+ * or error callback runs when the clock reaches it, as the ISR would.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef enum {
+    HAL_OK = 0,
+    HAL_ERROR,
+    HAL_BUSY,
+    HAL_TIMEOUT
+} HAL_StatusTypeDef;
+
+// Clock and cycle counter
+extern uint32_t SystemCoreClock;
+
+typedef struct {
+    uint32_t CTRL;
+    uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+    uint32_t DEMCR;
+} CoreDebug_Type;
+
+DWT_Type* fake_dwt(void);
+extern CoreDebug_Type fake_core_debug;
+
+#define DWT                             (fake_dwt())
+#define CoreDebug                       (&fake_core_debug)
+#define DWT_CTRL_CYCCNTENA_Msk          (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk      (1UL << 24)
+
+uint32_t HAL_GetTick(void);
+
+// Interrupt masking: there are no real interrupts, callbacks only run from
+// fake_run_us(), so PRIMASK is bookkeeping
+extern uint32_t fake_primask;
+
+static inline uint32_t __get_PRIMASK(void) { return fake_primask; }
+static inline void __set_PRIMASK(uint32_t primask) { fake_primask = primask; }
+static inline void __disable_irq(void) { fake_primask = 1; }
+static inline void __enable_irq(void) { fake_primask = 0; }
+
+static inline uint8_t __CLZ(uint32_t value) { return value ? (uint8_t)__builtin_clz(value) : 32; }
+
+// Cortex-M4 SIMD shims. __USUB16/__SSUB16 set the GE flags per halfword
+// (both flags of a lane together) and __SEL picks bytes by them, like the
+// core does; the flags live in one global as in the APSR. fake_simd_ops
+// counts them (each is one single-cycle instruction on the M4).
+#if !defined(__ARM_FEATURE_DSP)
+extern uint32_t fake_apsr_ge;
+extern uint32_t fake_simd_ops;
+
+static inline uint32_t __USUB16(uint32_t a, uint32_t b) {
+    uint32_t lo = (a & 0xFFFF) - (b & 0xFFFF);
+    uint32_t hi = (a >> 16) - (b >> 16);
+    fake_simd_ops++;
+    fake_apsr_ge = (((a & 0xFFFF) >= (b & 0xFFFF)) ? 0x3 : 0) | (((a >> 16) >= (b >> 16)) ? 0xC : 0);
+    return (lo & 0xFFFF) | (hi << 16);
+}
+
+static inline uint32_t __SSUB16(uint32_t a, uint32_t b) {
+    int32_t lo = (int16_t)(a & 0xFFFF) - (int16_t)(b & 0xFFFF);
+    int32_t hi = (int16_t)(a >> 16) - (int16_t)(b >> 16);
+    fake_simd_ops++;
+    fake_apsr_ge = ((lo >= 0) ? 0x3 : 0) | ((hi >= 0) ? 0xC : 0);
+    return ((uint32_t)lo & 0xFFFF) | ((uint32_t)hi << 16);
+}
+
+static inline uint32_t __SEL(uint32_t a, uint32_t b) {
+    uint32_t mask = 0;
+    fake_simd_ops++;
+    for (int i = 0; i < 4; i++) {
+        if (fake_apsr_ge & (1U << i)) mask |= 0xFFU << (8 * i);
+    }
+    return (a & mask) | (b & ~mask);
+}
+#endif
+
+// GPIO (I2C recovery bit-bangs SCL and reads SDA)
+typedef struct {
+    uint32_t odr;
+} GPIO_TypeDef;
+
+typedef enum {
+    GPIO_PIN_RESET = 0,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+typedef struct {
+    uint32_t Pin;
+    uint32_t Mode;
+    uint32_t Pull;
+    uint32_t Speed;
+    uint32_t Alternate;
+} GPIO_InitTypeDef;
+
+extern GPIO_TypeDef fake_gpioa, fake_gpiob;
+#define GPIOA                           (&fake_gpioa)
+#define GPIOB                           (&fake_gpiob)
+
+#define GPIO_PIN_3                      ((uint16_t)0x0008)
+#define GPIO_PIN_4                      ((uint16_t)0x0010)
+#define GPIO_PIN_6                      ((uint16_t)0x0040)
+#define GPIO_PIN_7                      ((uint16_t)0x0080)
+#define GPIO_PIN_8                      ((uint16_t)0x0100)
+#define GPIO_PIN_10                     ((uint16_t)0x0400)
+#define GPIO_MODE_OUTPUT_OD             0x11U
+#define GPIO_PULLUP                     0x01U
+#define GPIO_SPEED_FREQ_VERY_HIGH       0x03U
+
+void HAL_GPIO_Init(GPIO_TypeDef* port, GPIO_InitTypeDef* init);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* port, uint16_t pin);
+void HAL_GPIO_WritePin(GPIO_TypeDef* port, uint16_t pin, GPIO_PinState state);
+
+// I2C
+typedef struct {
+    uint32_t ClockSpeed;
+    uint32_t DutyCycle;
+    uint32_t OwnAddress1;
+    uint32_t AddressingMode;
+    uint32_t DualAddressMode;
+    uint32_t OwnAddress2;
+    uint32_t GeneralCallMode;
+    uint32_t NoStretchMode;
+} I2C_InitTypeDef;
+
+// The transfer on the simulated wire
+typedef struct {
+    uint8_t  active;
+    uint8_t  kind;              // FAKE_I2C_TX/RX/MEM_TX/MEM_RX
+    uint8_t  addr;              // 8-bit address
+    uint8_t  mem_addr;
+    uint8_t* buf;
+    uint16_t len;
+    uint32_t error;             // HAL_I2C_ERROR_* to report, 0 on success
+    uint64_t done_cycle;        // 0: never (slave stretching SCL forever)
+} FakeI2cWire_t;
+
+typedef struct {
+    void* Instance;
+    I2C_InitTypeDef Init;
+    volatile uint32_t ErrorCode;
+    FakeI2cWire_t wire;
+} I2C_HandleTypeDef;
+
+#define I2C_MEMADD_SIZE_8BIT            0x01U
+
+#define HAL_I2C_ERROR_NONE              0x00U
+#define HAL_I2C_ERROR_BERR              0x01U
+#define HAL_I2C_ERROR_ARLO              0x02U
+#define HAL_I2C_ERROR_AF                0x04U
+
+#define I2C_FLAG_BUSY                   0x00100002U
+#define I2C_IT_BUF                      0x0400U
+#define I2C_IT_EVT                      0x0200U
+#define I2C_IT_ERR                      0x0100U
+
+uint8_t fake_i2c_busy(const I2C_HandleTypeDef* hi2c);
+
+#define __HAL_I2C_GET_FLAG(h, flag)     (((flag) == I2C_FLAG_BUSY) ? fake_i2c_busy(h) : 0)
+#define __HAL_I2C_DISABLE_IT(h, it)     ((void)(h))
+#define __HAL_I2C_DISABLE(h)            ((void)(h))
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef* hi2c);
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef* hi2c);
+uint32_t HAL_I2C_GetError(I2C_HandleTypeDef* hi2c);
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_IT(I2C_HandleTypeDef* hi2c, uint16_t addr, uint8_t* data, uint16_t len);
+HAL_StatusTypeDef HAL_I2C_Master_Receive_IT(I2C_HandleTypeDef* hi2c, uint16_t addr, uint8_t* data, uint16_t len);
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef* hi2c, uint16_t addr, uint16_t mem_addr,
+                                       uint16_t mem_size, uint8_t* data, uint16_t len);
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef* hi2c, uint16_t addr, uint16_t mem_addr,
+                                      uint16_t mem_size, uint8_t* data, uint16_t len);
+
+// Completion callbacks, provided by the module under test (i2c_bus.c)
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef* hi2c);
+void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef* hi2c);
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef* hi2c);
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef* hi2c);
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c);
+
+#endif
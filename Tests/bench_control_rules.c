@@ -0,0 +1,102 @@
+/*
+ * bench_control_rules.c
+ *
+ * Cost per 100 zones of one control cycle's rule evaluation:
+ * control_rules_batch() plus control_rules_eval() reading the lane
+ * results, against control_rules_eval() alone branching row by row (the
+ * per-zone path, taken with ZONE_FLAG_LANES clear). Relay nodes under
+ * the default profiles, so every ON and PI row is a hysteresis lane.
+ *
+ * As in bench_sensor_filter.c, host cycles of the lanes run on the SIMD
+ * shims; the DSP instruction count (SSUB16/SEL) is the M4-relevant part.
+ */
+
+#include "host_test.h"
+#include "fake_hal.h"
+#include "plant_profiles.h"
+#include "zone_table.h"
+#include <stdlib.h>
+
+#define ZONES       100
+#define ROUNDS      5000
+
+static volatile uint8_t sink;
+
+static void load_values(void) {
+    for (uint8_t i = 0; i < ZONES; i++) {
+        Zone_t* zone = zone_table_get(i);
+        const PlantProfile_t* profile = get_profile(zone->assigned_profile);
+        for (uint8_t ch = 0; ch < zone->channel_count; ch++) {
+            const ControlRule_t* r = &profile->rules[rand() % profile->rule_count];
+            zone->values[ch] = r->threshold + (rand() % (4 * r->band + 1)) - 2 * r->band;
+        }
+    }
+}
+
+static void eval_all(void) {
+    for (uint8_t i = 0; i < ZONES; i++) {
+        Zone_t* zone = zone_table_get(i);
+        const PlantProfile_t* profile = get_profile(zone->assigned_profile);
+        uint8_t mask = 0, value = 0;
+        control_rules_eval(profile->rules, profile->rule_count, zone, 1500, &mask, &value);
+        sink ^= mask ^ value;
+    }
+}
+
+static void set_lanes(uint8_t on) {
+    for (uint8_t i = 0; i < ZONES; i++) {
+        Zone_t* zone = zone_table_get(i);
+        if (on) zone->flags |= ZONE_FLAG_LANES;
+        else zone->flags &= ~ZONE_FLAG_LANES;
+    }
+}
+
+int main(void) {
+    uint64_t lanes = 0, rows = 0;
+    uint64_t ops = 0;
+    uint32_t lane_rows = 0;
+
+    srand(100);
+    plant_profiles_init();
+    zone_table_init();
+    for (uint8_t i = 0; i < ZONES; i++) {
+        Zone_t* zone = zone_table_get(zone_table_add(i % 3, 0x07 + i));
+        zone->assigned_profile = i % get_num_profiles();
+        zone->channel_count = 3;
+
+        const PlantProfile_t* profile = get_profile(zone->assigned_profile);
+        for (uint8_t k = 0; k < profile->rule_count; k++) {
+            const ControlRule_t* rule = &profile->rules[k];
+            uint8_t hysteresis = rule->cmp != RULE_INHIBIT_BELOW && rule->cmp != RULE_INHIBIT_ABOVE;
+            if (rule->channel < zone->channel_count && hysteresis) lane_rows++;
+        }
+    }
+    control_rules_invalidate();
+    control_rules_batch();                      // Compile outside the timed loop
+
+    for (uint32_t r = 0; r < ROUNDS; r++) {
+        load_values();
+
+        uint32_t ops_before = fake_simd_ops;
+        uint64_t start = host_cycles();
+        control_rules_batch();
+        eval_all();
+        lanes += host_cycles() - start;
+        ops += fake_simd_ops - ops_before;
+
+        set_lanes(0);
+        start = host_cycles();
+        eval_all();
+        rows += host_cycles() - start;
+        set_lanes(1);
+    }
+
+    printf("Control rules, %u zones, %u profiles, %u lanes, per 100 zones\n", ZONES, get_num_profiles(), lane_rows);
+    printf("  lanes (batch + eval) %8.1f %s, %5.1f DSP instructions\n",
+           lanes * 100.0 / ((double)ROUNDS * ZONES), HOST_CYCLE_UNIT, ops * 100.0 / ((double)ROUNDS * ZONES));
+    printf("  row by row (eval)    %8.1f %s\n", rows * 100.0 / ((double)ROUNDS * ZONES), HOST_CYCLE_UNIT);
+
+    // Two lanes per word: an SSUB16/SEL pair for the on and one for the off edge
+    CHECK(ops == (uint64_t)ROUNDS * 4 * ((lane_rows + 1) / 2));
+    return test_result("bench_control_rules");
+}
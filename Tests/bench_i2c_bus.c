@@ -0,0 +1,131 @@
+/*
+ * bench_i2c_bus.c
+ *
+ * Throughput and worst-case latency of the i2c_bus.c queue on the
+ * simulated bus (simulated time; host cost per transfer is printed too).
+ *
+ * - Throughput: the queue is kept topped up with sensor-frame reads for
+ *   one simulated second. The ISR chain starts each transfer as the last
+ *   one completes, so the wire should stay busy whatever the superloop
+ *   period.
+ * - Latency: submit -> callback for a full queue, and behind a slave
+ *   that stretches SCL until the per-transfer timeout.
+ */
+
+#include "host_test.h"
+#include "fake_hal.h"
+#include "i2c_bus.h"
+#include "node_protocol.h"
+#include <string.h>
+
+#define FRAME_LEN       (REG_MAP_LEN(3) + 1)    // Three-channel node + PEC
+#define RUN_US          1000000
+
+static I2C_HandleTypeDef hi2c[I2C_BUS_COUNT];
+static const I2cBusPins_t pins = {GPIOB, GPIO_PIN_6, GPIOB, GPIO_PIN_7};
+
+static uint32_t completed;
+static uint64_t max_latency_us;
+
+static void done(I2cXfer_t* xfer) {
+    uint64_t latency = fake_now_us() - (uint64_t)(uintptr_t)xfer->ctx;
+    if (latency > max_latency_us) max_latency_us = latency;
+    completed++;
+}
+
+static void setup(void) {
+    fake_reset();
+    memset(hi2c, 0, sizeof(hi2c));
+    for (uint8_t bus = 0; bus < I2C_BUS_COUNT; bus++) {
+        hi2c[bus].Init.ClockSpeed = I2C_BUS_SPEED_FAST_HZ;
+        fake_i2c_attach(&hi2c[bus]);
+        i2c_bus_init(bus, &hi2c[bus], &pins);
+    }
+    completed = 0;
+    max_latency_us = 0;
+}
+
+static uint8_t submit(uint8_t addr7) {
+    return i2c_bus_submit_mem_read(I2C_BUS_1, addr7 << 1, REG_POINTER_BASE, NULL, FRAME_LEN,
+                                   done, (void*)(uintptr_t)fake_now_us());
+}
+
+// Frame time on the wire at 400 kHz: the bound the queue can approach
+static double frame_us(void) {
+    return (3 + 9 * (3 + FRAME_LEN)) * 1e6 / I2C_BUS_SPEED_FAST_HZ;
+}
+
+static void bench_throughput(uint32_t loop_us) {
+    setup();
+    fake_i2c_device(&hi2c[0], 0x08)->present = 1;
+
+    uint64_t host_start = host_cycles();
+    for (uint32_t t = 0; t < RUN_US; t += loop_us) {
+        while (i2c_bus_pending(I2C_BUS_1) < I2C_BUS_QUEUE_LEN && submit(0x08)) {
+        }
+        fake_run_us(loop_us);
+        i2c_bus_process();
+    }
+    uint64_t host_spent = host_cycles() - host_start;
+
+    double limit = RUN_US / frame_us();
+    double busy = (double)fake_i2c_counters(&hi2c[0])->wire_cycles / fake_cycles();
+    printf("  loop %5u us: %6u frames/s (wire limit %.0f), bus busy %5.1f %%, "
+           "worst latency %6.2f ms, %5.0f %s/frame on the host\n",
+           loop_us, completed, limit, busy * 100, max_latency_us / 1000.0,
+           (double)host_spent / completed, HOST_CYCLE_UNIT);
+
+    CHECK(busy > 0.97);
+    CHECK(i2c_bus_get_stats(I2C_BUS_1)->dropped == 0);
+}
+
+// A full queue drains in order; the last one waits for all ahead of it
+static void bench_full_queue_latency(void) {
+    setup();
+    fake_i2c_device(&hi2c[0], 0x08)->present = 1;
+
+    for (uint8_t i = 0; i < I2C_BUS_QUEUE_LEN; i++) submit(0x08);
+    while (!i2c_bus_is_idle(I2C_BUS_1)) {
+        fake_run_us(50);
+        i2c_bus_process();
+    }
+    printf("  full queue (%u frames): worst latency %.2f ms (%.0f us per frame on the wire)\n",
+           I2C_BUS_QUEUE_LEN, max_latency_us / 1000.0, frame_us());
+    CHECK(completed == I2C_BUS_QUEUE_LEN);
+    CHECK(max_latency_us <= I2C_BUS_QUEUE_LEN * frame_us() + 200);
+}
+
+// Worst case: a slave holds SCL on every attempt ahead of a full queue
+static void bench_stuck_slave_latency(void) {
+    setup();
+    FakeI2cDevice_t* stuck = fake_i2c_device(&hi2c[0], 0x07);
+    stuck->present = 1;
+    stuck->hang_next = I2C_BUS_DEFAULT_ATTEMPTS;
+    fake_i2c_device(&hi2c[0], 0x08)->present = 1;
+
+    submit(0x07);
+    for (uint8_t i = 1; i < I2C_BUS_QUEUE_LEN; i++) submit(0x08);
+    while (!i2c_bus_is_idle(I2C_BUS_1)) {
+        fake_run_us(1000);
+        i2c_bus_process();
+    }
+    const I2cBusStats_t* stats = i2c_bus_get_stats(I2C_BUS_1);
+    printf("  stuck slave ahead of %u frames: worst latency %.2f ms, %lu timeouts, %lu recoveries\n",
+           I2C_BUS_QUEUE_LEN - 1, max_latency_us / 1000.0,
+           (unsigned long)stats->timeouts, (unsigned long)stats->recoveries);
+
+    // Each attempt costs the timeout plus up to one superloop pass
+    CHECK(stats->timeouts == I2C_BUS_DEFAULT_ATTEMPTS);
+    CHECK(max_latency_us <= I2C_BUS_DEFAULT_ATTEMPTS * (I2C_BUS_XFER_TIMEOUT_MS + 2) * 1000
+                            + I2C_BUS_QUEUE_LEN * frame_us() + 2000);
+}
+
+int main(void) {
+    printf("i2c_bus queue, %u-byte sensor frames at %u kHz\n", FRAME_LEN, I2C_BUS_SPEED_FAST_HZ / 1000);
+    bench_throughput(100);
+    bench_throughput(1000);
+    bench_throughput(10000);
+    bench_full_queue_latency();
+    bench_stuck_slave_latency();
+    return test_result("bench_i2c_bus");
+}
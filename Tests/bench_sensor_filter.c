@@ -0,0 +1,74 @@
+/*
+ * bench_sensor_filter.c
+ *
+ * Cost per zone of sensor_filter_run() against the scalar per-channel
+ * reference (filter_reference.h), for 100 zones of 3 and of 8 channels.
+ *
+ * Host cycles of the packed path run on the SIMD shims, so they say
+ * little about the M4; the M4-relevant figure is the DSP instruction
+ * count per zone (USUB16/SEL, one cycle each there), printed next to it.
+ */
+
+#include "host_test.h"
+#include "fake_hal.h"
+#include "filter_reference.h"
+#include "zone_table.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ZONES       100
+#define ROUNDS      2000
+
+static RefFilter_t ref[ZONES][ZONE_MAX_CHANNELS];
+static volatile uint16_t sink;
+
+static void load_samples(void) {
+    for (uint8_t i = 0; i < ZONES; i++) {
+        Zone_t* zone = zone_table_get(i);
+        for (uint8_t ch = 0; ch < zone->channel_count; ch++) zone->sensors[ch] = rand() & 0x3FF;
+        zone->flags |= ZONE_FLAG_UNFILTERED;
+    }
+}
+
+static void bench(uint8_t channels) {
+    uint64_t packed = 0, scalar = 0;
+    uint64_t ops = 0;
+
+    zone_table_init();
+    memset(ref, 0, sizeof(ref));
+    for (uint8_t i = 0; i < ZONES; i++) {
+        zone_table_get(zone_table_add(0, 0x07 + i))->channel_count = channels;
+    }
+
+    for (uint32_t r = 0; r < ROUNDS; r++) {
+        load_samples();
+
+        uint32_t ops_before = fake_simd_ops;
+        uint64_t start = host_cycles();
+        sensor_filter_run();
+        packed += host_cycles() - start;
+        ops += fake_simd_ops - ops_before;
+
+        start = host_cycles();
+        for (uint8_t i = 0; i < ZONES; i++) {
+            const Zone_t* zone = zone_table_get(i);
+            for (uint8_t ch = 0; ch < channels; ch++) sink = ref_filter_step(&ref[i][ch], zone->sensors[ch]);
+        }
+        scalar += host_cycles() - start;
+    }
+
+    double per_zone = (double)ROUNDS * ZONES;
+    printf("  %u ch: packed %7.1f %s/zone, scalar %7.1f %s/zone, %5.1f DSP instructions/zone\n",
+           channels, packed / per_zone, HOST_CYCLE_UNIT, scalar / per_zone, HOST_CYCLE_UNIT, ops / per_zone);
+
+    // Four compare-exchanges plus a median of three per channel pair
+    CHECK(ops / per_zone == ((channels + 1) / 2) * (ZONE_FILTER_TAPS == 5 ? 19 : 7));
+}
+
+int main(void) {
+    srand(1);
+    printf("Sensor filters, %u zones, %u-tap median + EMA\n", ZONES, ZONE_FILTER_TAPS);
+    bench(3);
+    bench(8);
+    return test_result("bench_sensor_filter");
+}
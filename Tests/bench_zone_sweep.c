@@ -0,0 +1,134 @@
+/*
+ * bench_zone_sweep.c
+ *
+ * Bus time of one full sensor sweep over N zones, all on I2C1 against
+ * spread over I2C1/I2C2/I2C3, on the simulated bus. The sweep is paced
+ * as node_controller.c does it: one general-call latch per bus, then a
+ * register-map read per zone fed from a per-bus cursor while the bus
+ * queue holds fewer than SENSOR_READ_QUEUE_SHARE transfers. The third
+ * column adds an OLED frame flush (ssd1306_update: 8 pages of commands
+ * and 128 data bytes) on I2C1 at the start of the sweep.
+ */
+
+#include "host_test.h"
+#include "fake_hal.h"
+#include "i2c_bus.h"
+#include "node_protocol.h"
+#include "zone_table.h"
+#include <string.h>
+
+#define LOOP_US                  100
+#define FRAME_LEN                (REG_MAP_LEN(3) + 1)
+#define SENSOR_READ_QUEUE_SHARE  (I2C_BUS_QUEUE_LEN / 2)   // As in node_controller.c
+#define OLED_ADDR                0x78
+#define OLED_WIDTH               128
+
+static I2C_HandleTypeDef hi2c[I2C_BUS_COUNT];
+static const I2cBusPins_t pins = {GPIOB, GPIO_PIN_6, GPIOB, GPIO_PIN_7};
+static uint8_t oled_frame[8 * OLED_WIDTH];
+static uint8_t cursor[I2C_BUS_COUNT];
+static uint32_t frames_read;
+
+static void sensors_done(I2cXfer_t* xfer) {
+    if (xfer->status == I2C_XFER_OK) frames_read++;
+}
+
+static void setup(uint8_t zones, uint8_t bus_count) {
+    fake_reset();
+    memset(hi2c, 0, sizeof(hi2c));
+    for (uint8_t bus = 0; bus < I2C_BUS_COUNT; bus++) {
+        hi2c[bus].Init.ClockSpeed = I2C_BUS_SPEED_FAST_HZ;
+        fake_i2c_attach(&hi2c[bus]);
+        i2c_bus_init(bus, &hi2c[bus], &pins);
+        fake_i2c_device(&hi2c[bus], I2C_GENERAL_CALL_ADDR >> 1)->present = 1;
+    }
+    fake_i2c_device(&hi2c[I2C_BUS_1], OLED_ADDR >> 1)->present = 1;
+
+    zone_table_init();
+    for (uint8_t i = 0; i < zones; i++) {
+        uint8_t addr = 0x07 + i;
+        uint8_t bus = i % bus_count;
+        zone_table_add(bus, addr);
+        fake_i2c_device(&hi2c[bus], addr)->present = 1;
+    }
+    frames_read = 0;
+}
+
+static void flush_oled(void) {
+    for (uint8_t page = 0; page < 8; page++) {
+        uint8_t cmds[3] = {0xB0 + page, 0x00, 0x10};
+        i2c_bus_submit_mem_write(I2C_BUS_1, OLED_ADDR, 0x00, cmds, sizeof(cmds), NULL, NULL);
+        i2c_bus_submit_mem_write(I2C_BUS_1, OLED_ADDR, 0x40, &oled_frame[OLED_WIDTH * page],
+                                 OLED_WIDTH, NULL, NULL);
+    }
+}
+
+// node_controller_poll_sensors()
+static void start_sweep(void) {
+    static const uint8_t latch = CMD_LATCH_SAMPLES;
+
+    for (uint8_t bus = 0; bus < I2C_BUS_COUNT; bus++) {
+        for (uint8_t i = 0; i < zone_table_count(); i++) {
+            if (zone_table_get(i)->bus == bus) {
+                i2c_bus_submit_write(bus, I2C_GENERAL_CALL_ADDR, &latch, 1, NULL, NULL);
+                break;
+            }
+        }
+        cursor[bus] = 0;
+    }
+}
+
+// node_controller_process(); returns 0 once every cursor is done
+static uint8_t feed_sweep(void) {
+    uint8_t busy = 0;
+
+    for (uint8_t bus = 0; bus < I2C_BUS_COUNT; bus++) {
+        while (cursor[bus] != ZONE_NONE) {
+            if (cursor[bus] >= zone_table_count()) {
+                cursor[bus] = ZONE_NONE;
+                break;
+            }
+            Zone_t* zone = zone_table_get(cursor[bus]);
+            if (zone->bus == bus) {
+                if (i2c_bus_pending(bus) >= SENSOR_READ_QUEUE_SHARE) break;
+                if (!i2c_bus_submit_mem_read(bus, zone->addr << 1, REG_POINTER_BASE, NULL, FRAME_LEN,
+                                             sensors_done, NULL)) break;
+            }
+            cursor[bus]++;
+        }
+        if (cursor[bus] != ZONE_NONE || !i2c_bus_is_idle(bus)) busy = 1;
+    }
+    return busy;
+}
+
+// Simulated milliseconds from the latch to the last frame's callback
+static double sweep_ms(uint8_t zones, uint8_t bus_count, uint8_t with_oled) {
+    setup(zones, bus_count);
+    uint64_t start = fake_now_us();
+
+    if (with_oled) flush_oled();
+    start_sweep();
+    while (feed_sweep()) {
+        fake_run_us(LOOP_US);
+        i2c_bus_process();
+    }
+    CHECK(frames_read == zones);
+    return (fake_now_us() - start) / 1000.0;
+}
+
+int main(void) {
+    static const uint8_t sizes[] = {3, 12, 36, 63, 99, ZONE_MAX};
+
+    printf("Sensor sweep, %u-byte frames at %u kHz (simulated ms)\n", FRAME_LEN, I2C_BUS_SPEED_FAST_HZ / 1000);
+    printf("  zones   1 bus   3 buses  speedup   3 buses + OLED on I2C1\n");
+    for (uint8_t i = 0; i < sizeof(sizes); i++) {
+        double one = sweep_ms(sizes[i], 1, 0);
+        double three = sweep_ms(sizes[i], I2C_BUS_COUNT, 0);
+        double oled = sweep_ms(sizes[i], I2C_BUS_COUNT, 1);
+        printf("  %5u  %6.2f  %8.2f  %6.2fx  %8.2f\n", sizes[i], one, three, one / three, oled);
+
+        // Bus time splits three ways up to the superloop granularity
+        if (sizes[i] >= 36) CHECK(one / three > 2.7);
+    }
+    return test_result("bench_zone_sweep");
+}
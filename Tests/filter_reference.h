@@ -0,0 +1,43 @@
+#ifndef FILTER_REFERENCE_H
+#define FILTER_REFERENCE_H
+
+#include <stdint.h>
+#include "sensor_filter.h"
+
+// Plain scalar median + EMA of one channel, written the obvious way (copy
+// and insertion-sort the window), as the reference for sensor_filter.c
+typedef struct {
+    uint16_t taps[ZONE_FILTER_TAPS];
+    uint8_t next;
+    uint8_t primed;
+    uint16_t ema;               // Q FILTER_EMA_FRAC_BITS
+} RefFilter_t;
+
+static inline uint16_t ref_filter_step(RefFilter_t* f, uint16_t sample) {
+    uint16_t sorted[ZONE_FILTER_TAPS];
+
+    if (!f->primed) {
+        for (uint8_t t = 0; t < ZONE_FILTER_TAPS; t++) f->taps[t] = sample;
+    } else {
+        f->taps[f->next] = sample;
+    }
+    f->next = (f->next + 1) % ZONE_FILTER_TAPS;
+
+    for (uint8_t i = 0; i < ZONE_FILTER_TAPS; i++) {
+        uint16_t v = f->taps[i];
+        uint8_t j = i;
+        while (j > 0 && sorted[j - 1] > v) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = v;
+    }
+
+    int32_t x = (int32_t)sorted[ZONE_FILTER_TAPS / 2] << FILTER_EMA_FRAC_BITS;
+    int32_t y = f->primed ? f->ema : x;
+    f->ema = y + ((x - y) >> FILTER_EMA_SHIFT);
+    f->primed = 1;
+    return (f->ema + (1 << (FILTER_EMA_FRAC_BITS - 1))) >> FILTER_EMA_FRAC_BITS;
+}
+
+#endif
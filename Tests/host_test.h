@@ -0,0 +1,43 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// Shared by the host tests and benchmarks: a failed CHECK is reported and
+// counted, main() returns test_result() so ctest sees it
+static int test_failures = 0;
+
+#define CHECK(cond)                                                         \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            test_failures++;                                                \
+        }                                                                   \
+    } while (0)
+
+static inline int test_result(const char* name) {
+    printf("%s: %s\n", name, test_failures ? "FAILED" : "ok");
+    return test_failures ? 1 : 0;
+}
+
+// Host time for the benchmarks. x86 reads the TSC, anything else counts
+// nanoseconds; either way only ratios between two runs mean much, the
+// Cortex-M4 numbers are not the host's.
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HOST_CYCLE_UNIT "TSC cycles"
+static inline uint64_t host_cycles(void) {
+    return __rdtsc();
+}
+#else
+#define HOST_CYCLE_UNIT "ns"
+static inline uint64_t host_cycles(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+#endif
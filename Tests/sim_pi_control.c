@@ -0,0 +1,187 @@
+/*
+ * sim_pi_control.c
+ *
+ * Greenhouse temperature under the TOMATO profile's relay fan rule
+ * (hysteresis) against TOMATO PI's PI fan rule, through the real
+ * control_rules.c, on a first-order thermal model:
+ *
+ *   dT/dt = (T_load - T) / TAU_S - u * (T - T_OUTSIDE) * FAN_GAIN
+ *
+ * u is 0/1 for the relay (held for the fan's 20 s min on/off time, as
+ * node_controller.c does) and duty/255 for PWM. The zone starts hot and
+ * the heat load steps up halfway through (sun out). Rules run once per
+ * sensor sweep on a reading with +-0.2 degC of noise.
+ *
+ * Reported per controller: settling time into +-SETTLE_BAND of the
+ * setpoint (and staying there), from the start and after the step, the
+ * peak error after the step, ripple and mean error over the last
+ * hour, fan relay on/off switches and duty frames sent.
+ */
+
+#include "host_test.h"
+#include "plant_profiles.h"
+#include "calibration.h"
+#include "zone_table.h"
+#include <math.h>
+#include <string.h>
+
+#define SWEEP_MS        1500        // Sensor sweep / control period
+#define STEP_MS         100         // Plant integration step
+#define RUN_S           (4 * 3600)
+#define DISTURB_S       (RUN_S / 2)
+#define TAIL_S          3600        // Ripple and error measured over this
+
+#define T_START         32.0
+#define T_OUTSIDE       20.0
+#define T_LOAD          35.0        // Where the zone ends up with the fan off
+#define T_LOAD_SUN      40.0        // ... after the disturbance
+#define TAU_S           600.0
+#define FAN_GAIN        (1.0 / 200)
+
+#define FAN_MIN_ON_OFF_MS  20000    // actuator_limits[] in node_controller.c
+#define SETTLE_BAND     0.5
+
+typedef struct {
+    const char* name;
+    Zone_t* zone;
+    const PlantProfile_t* profile;
+    double temp;
+    uint8_t fan_on;                 // Relay state (PWM: duty != 0)
+    uint8_t duty;                   // PWM duty sent, 255 for a closed relay
+    uint32_t fan_since_ms;
+    uint32_t relay_switches;
+    uint32_t duty_frames;
+    double settled_at[2];           // Per half, -1 while outside the band
+    double peak_after_step;         // Largest error after the disturbance
+    double tail_min, tail_max, tail_abs_error;
+    uint32_t tail_samples;
+} Loop_t;
+
+static uint32_t noise_state = 12345;
+
+static double noise(void) {
+    noise_state = noise_state * 1103515245 + 12345;
+    return ((noise_state >> 16) % 401) / 1000.0 - 0.2;
+}
+
+static uint8_t profile_index(const char* name) {
+    for (uint8_t i = 0; i < get_num_profiles(); i++) {
+        if (strcmp(get_profile_name(i), name) == 0) return i;
+    }
+    return PROFILE_NONE;
+}
+
+static void setup(Loop_t* loop, const char* name, uint8_t addr, uint8_t pwm) {
+    uint8_t profile = profile_index(name);
+    CHECK(profile != PROFILE_NONE);
+
+    memset(loop, 0, sizeof(*loop));
+    loop->name = name;
+    loop->zone = zone_table_get(zone_table_add(0, addr));
+    loop->zone->assigned_profile = profile;
+    loop->zone->channel_count = 3;
+    loop->zone->pwm_mask = pwm ? (ACT_FAN | ACT_LIGHT1) : 0;
+    loop->profile = get_profile(profile);
+    loop->temp = T_START;
+    loop->settled_at[0] = loop->settled_at[1] = -1;
+    loop->tail_min = 1e9;
+    loop->tail_max = -1e9;
+}
+
+static void sample(Loop_t* loop) {
+    Zone_t* zone = loop->zone;
+
+    zone->values[ZONE_CH_HUMIDITY] = CAL_RH(75);        // Humidifier and light stay off
+    zone->values[ZONE_CH_TEMP] = (int16_t)lround((loop->temp + noise()) * CAL_DEG_C(1));
+    zone->values[ZONE_CH_LIGHT] = CAL_LUX(30000);
+}
+
+// As node_controller_update(): batch first, then each zone's rows
+static void control(Loop_t* loop, uint32_t now_ms) {
+    Zone_t* zone = loop->zone;
+    uint8_t mask = 0, value = 0;
+
+    control_rules_eval(loop->profile->rules, loop->profile->rule_count, zone, SWEEP_MS, &mask, &value);
+
+    if (zone->pwm_active & ACT_FAN) {
+        uint8_t duty = zone->duty[__builtin_ctz(ACT_FAN)];
+        if (duty != loop->duty) loop->duty_frames++;
+        if ((duty != 0) != loop->fan_on) loop->relay_switches++;
+        loop->duty = duty;
+        loop->fan_on = duty != 0;
+    } else if (mask & ACT_FAN) {
+        uint8_t want = (value & ACT_FAN) != 0;
+        if (want != loop->fan_on && now_ms - loop->fan_since_ms >= FAN_MIN_ON_OFF_MS) {
+            loop->fan_on = want;
+            loop->fan_since_ms = now_ms;
+            loop->relay_switches++;
+        }
+        loop->duty = loop->fan_on ? 255 : 0;
+    }
+}
+
+static void step(Loop_t* loop, uint32_t now_ms) {
+    double setpoint = loop->profile->rules[1].threshold / (double)CAL_DEG_C(1);
+    double load = (now_ms >= DISTURB_S * 1000UL) ? T_LOAD_SUN : T_LOAD;
+    double u = loop->duty / 255.0;
+    double dt = STEP_MS / 1000.0;
+    uint8_t half = now_ms >= DISTURB_S * 1000UL;
+
+    loop->temp += dt * ((load - loop->temp) / TAU_S - u * (loop->temp - T_OUTSIDE) * FAN_GAIN);
+
+    double error = loop->temp - setpoint;
+    if (half && fabs(error) > loop->peak_after_step) loop->peak_after_step = fabs(error);
+    if (fabs(error) > SETTLE_BAND) loop->settled_at[half] = -1;
+    else if (loop->settled_at[half] < 0) loop->settled_at[half] = now_ms / 1000.0 - (half ? DISTURB_S : 0);
+
+    if (now_ms >= (RUN_S - TAIL_S) * 1000UL) {
+        if (loop->temp < loop->tail_min) loop->tail_min = loop->temp;
+        if (loop->temp > loop->tail_max) loop->tail_max = loop->temp;
+        loop->tail_abs_error += fabs(error);
+        loop->tail_samples++;
+    }
+}
+
+static void report(const Loop_t* loop) {
+    char settle[2][16];
+    for (uint8_t h = 0; h < 2; h++) {
+        if (loop->settled_at[h] < 0) snprintf(settle[h], sizeof(settle[h]), "never");
+        else snprintf(settle[h], sizeof(settle[h]), "%.0f s", loop->settled_at[h]);
+    }
+    printf("  %-10s %9s %9s %6.2f %8.2f %8.2f %8u %8u\n", loop->name, settle[0], settle[1],
+           loop->peak_after_step, loop->tail_max - loop->tail_min, loop->tail_abs_error / loop->tail_samples,
+           loop->relay_switches, loop->duty_frames);
+}
+
+int main(void) {
+    Loop_t relay, pi;
+
+    plant_profiles_init();
+    zone_table_init();
+    setup(&relay, "TOMATO", 0x08, 0);
+    setup(&pi, "TOMATO PI", 0x09, 1);
+    CHECK(relay.profile->rules[1].cmp == RULE_ON_ABOVE && pi.profile->rules[1].cmp == RULE_PI_ABOVE);
+
+    for (uint32_t now = 0; now < RUN_S * 1000UL; now += STEP_MS) {
+        if (now % SWEEP_MS == 0) {
+            sample(&relay);
+            sample(&pi);
+            control_rules_batch();
+            control(&relay, now);
+            control(&pi, now);
+        }
+        step(&relay, now);
+        step(&pi, now);
+    }
+
+    printf("Fan loop, %.0f degC start, load %.0f -> %.0f degC at %u s, settle band +-%.1f degC\n",
+           T_START, T_LOAD, T_LOAD_SUN, DISTURB_S, SETTLE_BAND);
+    printf("  %-10s %9s %9s %6s %8s %8s %8s %8s\n", "", "settle", "re-settle", "peak", "ripple", "|error|", "switches", "duty frm");
+    report(&relay);
+    report(&pi);
+
+    CHECK(pi.settled_at[0] >= 0 && pi.settled_at[1] >= 0);
+    CHECK(pi.tail_max - pi.tail_min < relay.tail_max - relay.tail_min);
+    CHECK(pi.relay_switches < relay.relay_switches);
+    return test_result("sim_pi_control");
+}
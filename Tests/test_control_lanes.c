@@ -0,0 +1,128 @@
+/*
+ * test_control_lanes.c
+ *
+ * control_rules_batch() lanes against the row-by-row path of
+ * control_rules_eval(), for every default profile, one with rows at the
+ * int16 rails and random ones, on relay and PWM nodes, with values on
+ * and around each threshold and band edge, and anywhere.
+ */
+
+#include "host_test.h"
+#include "plant_profiles.h"
+#include "zone_table.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ZONES           ZONE_MAX
+#define ROUNDS          3000
+#define RANDOM_PROFILES 6
+
+static int16_t random_value(void) {
+    return (int16_t)(rand() & 0xFFFF);
+}
+
+static void add_random_profile(uint8_t index) {
+    PlantProfile_t p;
+
+    memset(&p, 0, sizeof(p));
+    snprintf(p.name, sizeof(p.name), "RANDOM %u", index);
+    p.rule_count = PROFILE_MAX_RULES;
+    p.irrigation_interval_sec = 30;
+    for (uint8_t i = 0; i < p.rule_count; i++) {
+        ControlRule_t* r = &p.rules[i];
+        r->channel = rand() % 4;                            // Channel 3 missing on most nodes
+        r->cmp = rand() % (RULE_PI_ABOVE + 1);
+        switch (rand() % 8) {
+            case 0:  r->threshold = random_value(); break;
+            case 1:  r->threshold = (rand() & 1) ? INT16_MIN + rand() % 3 : INT16_MAX - rand() % 3; break;
+            default: r->threshold = (int16_t)(rand() % 2000 - 1000); break;
+        }
+        r->band = (rand() % 4) ? rand() % 200 : (uint16_t)rand();
+        r->actuator = 1 << (rand() % ZONE_ACTUATOR_BITS);
+        r->ti_sec = rand() % 3 ? 60 : 0;
+    }
+    CHECK(plant_profiles_update(get_num_profiles(), &p));
+}
+
+// Thresholds and bands at the int16 rails, where negating -32768 saturates
+static void add_edge_profile(void) {
+    static const ControlRule_t edges[PROFILE_MAX_RULES] = {
+        { ZONE_CH_HUMIDITY, RULE_ON_ABOVE, INT16_MIN,     0,     ACT_HUMID,  0 },
+        { ZONE_CH_HUMIDITY, RULE_ON_BELOW, INT16_MAX,     65535, ACT_PUMP,   0 },
+        { ZONE_CH_TEMP,     RULE_ON_ABOVE, INT16_MIN + 1, 1,     ACT_FAN,    0 },
+        { ZONE_CH_TEMP,     RULE_PI_BELOW, INT16_MIN,     65535, ACT_LIGHT1, 60 },
+        { ZONE_CH_LIGHT,    RULE_PI_ABOVE, INT16_MAX,     65535, ACT_FAN,    0 },
+        { ZONE_CH_LIGHT,    RULE_ON_ABOVE, 0,             32768, ACT_PUMP,   0 },
+    };
+    PlantProfile_t p;
+
+    memset(&p, 0, sizeof(p));
+    snprintf(p.name, sizeof(p.name), "EDGES");
+    p.rule_count = PROFILE_MAX_RULES;
+    p.irrigation_interval_sec = 30;
+    memcpy(p.rules, edges, sizeof(edges));
+    CHECK(plant_profiles_update(get_num_profiles(), &p));
+}
+
+// Mostly on or next to a threshold or band edge of one of the zone's rows
+static int16_t pick_value(const PlantProfile_t* profile) {
+    if (rand() % 8 == 0 || profile->rule_count == 0) return random_value();
+
+    const ControlRule_t* r = &profile->rules[rand() % profile->rule_count];
+    int32_t edge = r->threshold;
+    if (rand() & 1) edge += (rand() & 1) ? r->band : -(int32_t)r->band;
+    edge += rand() % 5 - 2;
+    return (int16_t)((edge < INT16_MIN) ? INT16_MIN : (edge > INT16_MAX) ? INT16_MAX : edge);
+}
+
+int main(void) {
+    srand(21);
+    plant_profiles_init();
+    add_edge_profile();
+    for (uint8_t i = 0; i < RANDOM_PROFILES; i++) add_random_profile(i);
+
+    zone_table_init();
+    for (uint8_t i = 0; i < ZONES; i++) {
+        Zone_t* zone = zone_table_get(zone_table_add(i % 3, 0x07 + i));
+        zone->assigned_profile = i % get_num_profiles();
+        zone->channel_count = 3 + (i % 5 == 0);
+        zone->pwm_mask = (i % 2) ? (ACT_FAN | ACT_LIGHT1) : 0;
+    }
+    control_rules_invalidate();
+
+    uint32_t mismatches = 0, lane_zones = 0;
+    for (uint32_t round = 0; round < ROUNDS; round++) {
+        for (uint8_t i = 0; i < ZONES; i++) {
+            Zone_t* zone = zone_table_get(i);
+            const PlantProfile_t* profile = get_profile(zone->assigned_profile);
+            for (uint8_t ch = 0; ch < zone->channel_count; ch++) zone->values[ch] = pick_value(profile);
+        }
+        control_rules_batch();
+
+        for (uint8_t i = 0; i < ZONES; i++) {
+            Zone_t* zone = zone_table_get(i);
+            const PlantProfile_t* profile = get_profile(zone->assigned_profile);
+            Zone_t rows = *zone;
+            uint8_t prior = rand();
+            uint8_t mask_lanes = 0, value_lanes = prior;
+            uint8_t mask_rows = 0, value_rows = prior;
+
+            rows.flags &= ~ZONE_FLAG_LANES;
+            control_rules_eval(profile->rules, profile->rule_count, &rows, 1500, &mask_rows, &value_rows);
+            control_rules_eval(profile->rules, profile->rule_count, zone, 1500, &mask_lanes, &value_lanes);
+            if (zone->flags & ZONE_FLAG_LANES) lane_zones++;
+
+            if (mask_lanes != mask_rows || value_lanes != value_rows || zone->pwm_active != rows.pwm_active ||
+                memcmp(zone->duty, rows.duty, sizeof(zone->duty)) != 0) {
+                if (mismatches++ < 5) {
+                    printf("round %u zone %u (%s): lanes %02x/%02x rows %02x/%02x\n", round, i, profile->name,
+                           mask_lanes, value_lanes, mask_rows, value_rows);
+                }
+            }
+        }
+    }
+    CHECK(mismatches == 0);
+    CHECK(lane_zones == (uint32_t)ROUNDS * ZONES);      // Every zone fits in the lanes
+
+    return test_result("test_control_lanes");
+}
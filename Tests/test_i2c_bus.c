@@ -0,0 +1,225 @@
+/*
+ * test_i2c_bus.c
+ *
+ * i2c_bus.c on the simulated bus: ordering, retries, queue limits, the
+ * speed switch (never from the ISR, never over a transfer still on the
+ * wire), timeouts with bus recovery, and independent buses.
+ */
+
+#include "host_test.h"
+#include "fake_hal.h"
+#include "i2c_bus.h"
+#include <string.h>
+
+#define LOOP_US     100         // Superloop period between i2c_bus_process() calls
+
+static I2C_HandleTypeDef hi2c[I2C_BUS_COUNT];
+static const I2cBusPins_t pins = {GPIOB, GPIO_PIN_6, GPIOB, GPIO_PIN_7};
+
+static uint8_t order[64];
+static uint8_t order_count;
+static I2cXferStatus_t last_status;
+static uint8_t last_nacks;
+static uint8_t last_data[I2C_BUS_INLINE_BYTES];
+
+static void record(I2cXfer_t* xfer) {
+    if (order_count < sizeof(order)) order[order_count++] = (uint8_t)(uintptr_t)xfer->ctx;
+    last_status = xfer->status;
+    last_nacks = xfer->nacks;
+    memcpy(last_data, xfer->buf, (xfer->len < sizeof(last_data)) ? xfer->len : sizeof(last_data));
+}
+
+static void setup(void) {
+    fake_reset();
+    memset(hi2c, 0, sizeof(hi2c));
+    for (uint8_t bus = 0; bus < I2C_BUS_COUNT; bus++) {
+        hi2c[bus].Init.ClockSpeed = I2C_BUS_SPEED_FAST_HZ;
+        fake_i2c_attach(&hi2c[bus]);
+        i2c_bus_init(bus, &hi2c[bus], &pins);
+    }
+    order_count = 0;
+    last_status = I2C_XFER_QUEUED;
+}
+
+static void run_ms(uint32_t ms) {
+    for (uint32_t t = 0; t < ms * 1000; t += LOOP_US) {
+        fake_run_us(LOOP_US);
+        i2c_bus_process();
+    }
+}
+
+static void test_order_and_data(void) {
+    setup();
+    FakeI2cDevice_t* dev = fake_i2c_device(&hi2c[0], 0x08);
+    dev->present = 1;
+    for (uint8_t i = 0; i < sizeof(dev->data); i++) dev->data[i] = 0xA0 + i;
+
+    uint8_t frame[3] = {0x20, 0x0F, 0x05};
+    CHECK(i2c_bus_submit_write(I2C_BUS_1, 0x08 << 1, frame, sizeof(frame), record, (void*)1));
+    CHECK(i2c_bus_submit_mem_read(I2C_BUS_1, 0x08 << 1, 0x80, NULL, 4, record, (void*)2));
+    CHECK(i2c_bus_submit_read(I2C_BUS_1, 0x08 << 1, NULL, 2, record, (void*)3));
+    CHECK(i2c_bus_pending(I2C_BUS_1) == 3);
+    run_ms(2);
+
+    CHECK(order_count == 3);
+    CHECK(order[0] == 1 && order[1] == 2 && order[2] == 3);
+    CHECK(memcmp(dev->last_write, frame, sizeof(frame)) == 0);
+    CHECK(dev->last_mem_addr == 0x80);
+    CHECK(last_data[0] == 0xA0 && last_data[1] == 0xA1);
+    CHECK(i2c_bus_is_idle(I2C_BUS_1));
+    CHECK(i2c_bus_get_stats(I2C_BUS_1)->completed == 3);
+}
+
+static void test_nack_retries(void) {
+    setup();
+    FakeI2cDevice_t* dev = fake_i2c_device(&hi2c[0], 0x09);
+    dev->present = 1;
+    dev->nack_next = I2C_BUS_DEFAULT_ATTEMPTS - 1;
+
+    CHECK(i2c_bus_submit_read(I2C_BUS_1, 0x09 << 1, NULL, 1, record, NULL));
+    run_ms(2);
+    CHECK(last_status == I2C_XFER_OK);
+    CHECK(last_nacks == I2C_BUS_DEFAULT_ATTEMPTS - 1);
+
+    // Absent device: every attempt NACKs
+    CHECK(i2c_bus_submit_read(I2C_BUS_1, 0x30 << 1, NULL, 1, record, NULL));
+    run_ms(2);
+    CHECK(last_status == I2C_XFER_NACK);
+    CHECK(last_nacks == I2C_BUS_DEFAULT_ATTEMPTS);
+
+    // A probe takes the NACK as its answer
+    CHECK(i2c_bus_submit_probe(I2C_BUS_1, 0x30 << 1, record, NULL));
+    run_ms(2);
+    CHECK(last_status == I2C_XFER_NACK);
+    CHECK(last_nacks == 1);
+    CHECK(i2c_bus_get_stats(I2C_BUS_1)->recoveries == 0);
+}
+
+static void test_queue_full(void) {
+    setup();
+    uint8_t byte = 0;
+    uint8_t accepted = 0;
+
+    fake_i2c_device(&hi2c[0], 0x08)->present = 1;
+    for (uint8_t i = 0; i < I2C_BUS_QUEUE_LEN + 4; i++) {
+        accepted += i2c_bus_submit_write(I2C_BUS_1, 0x08 << 1, &byte, 1, NULL, NULL);
+    }
+    CHECK(accepted == I2C_BUS_QUEUE_LEN);
+    CHECK(i2c_bus_get_stats(I2C_BUS_1)->dropped == 4);
+
+    run_ms(5);
+    CHECK(i2c_bus_is_idle(I2C_BUS_1));
+    CHECK(i2c_bus_get_stats(I2C_BUS_1)->completed == I2C_BUS_QUEUE_LEN);
+}
+
+// Alternating fast and slow devices: every transfer runs at its device's
+// speed and the peripheral is only reset between transfers
+static void test_speed_switch(void) {
+    setup();
+    FakeI2cDevice_t* fast = fake_i2c_device(&hi2c[0], 0x08);
+    FakeI2cDevice_t* slow = fake_i2c_device(&hi2c[0], 0x07);
+    fast->present = 1;
+    slow->present = 1;
+    i2c_bus_set_device_slow(I2C_BUS_1, 0x07 << 1, 1);
+
+    for (uint8_t i = 0; i < 8; i++) {
+        uint8_t addr = (i & 1) ? 0x07 : 0x08;
+        CHECK(i2c_bus_submit_mem_read(I2C_BUS_1, addr << 1, 0x80, NULL, 16, NULL, NULL));
+    }
+    run_ms(20);
+
+    const FakeI2cCounters_t* counters = fake_i2c_counters(&hi2c[0]);
+    CHECK(fast->reads == 4 && slow->reads == 4);
+    CHECK(fast->last_clock_hz == I2C_BUS_SPEED_FAST_HZ);
+    CHECK(slow->last_clock_hz == I2C_BUS_SPEED_SLOW_HZ);
+    CHECK(i2c_bus_get_stats(I2C_BUS_1)->speed_switches == 7);     // The first one runs at the boot speed
+    CHECK(counters->inits_in_isr == 0);
+    CHECK(counters->inits_while_busy == 0);
+}
+
+// A slave stretching SCL forever: the watchdog fires, the bus is
+// recovered (SDA released after a few pulses) and the retry succeeds
+static void test_timeout_recovery(void) {
+    setup();
+    FakeI2cDevice_t* dev = fake_i2c_device(&hi2c[0], 0x08);
+    dev->present = 1;
+    dev->hang_next = 1;
+    fake_gpio_hold_sda(GPIOB, GPIO_PIN_7, 3);
+
+    CHECK(i2c_bus_submit_mem_read(I2C_BUS_1, 0x08 << 1, 0x80, NULL, 8, record, NULL));
+    run_ms(I2C_BUS_XFER_TIMEOUT_MS + 10);
+
+    const I2cBusStats_t* stats = i2c_bus_get_stats(I2C_BUS_1);
+    CHECK(last_status == I2C_XFER_OK);
+    CHECK(stats->timeouts == 1);
+    CHECK(stats->recoveries == 1);
+    CHECK(stats->recovery_failures == 0);
+    CHECK(fake_gpio_scl_pulses() >= 3);
+    CHECK(fake_i2c_counters(&hi2c[0])->inits_in_isr == 0);
+}
+
+// A slave holding a line low between transfers: BUSY stays set, so no
+// start may spin on it in the ISR or under the lock; the queued transfer
+// waits, the bus is recovered past the timeout and the transfer then runs
+static void test_held_bus(void) {
+    setup();
+    FakeI2cDevice_t* dev = fake_i2c_device(&hi2c[0], 0x08);
+    dev->present = 1;
+
+    CHECK(i2c_bus_submit_write(I2C_BUS_1, 0x08 << 1, (const uint8_t*)"\x20", 1, record, NULL));
+    fake_i2c_hold_lines(&hi2c[0]);
+    CHECK(i2c_bus_submit_read(I2C_BUS_1, 0x08 << 1, NULL, 4, record, NULL));
+    run_ms(I2C_BUS_XFER_TIMEOUT_MS + 10);
+
+    const I2cBusStats_t* stats = i2c_bus_get_stats(I2C_BUS_1);
+    const FakeI2cCounters_t* counters = fake_i2c_counters(&hi2c[0]);
+    CHECK(order_count == 2 && last_status == I2C_XFER_OK);
+    CHECK(stats->busy_deferrals > 0);
+    CHECK(stats->recoveries == 1);
+    CHECK(counters->busy_spins == 0);
+    CHECK(counters->busy_spins_masked == 0);
+}
+
+static void test_bus_error(void) {
+    setup();
+    FakeI2cDevice_t* dev = fake_i2c_device(&hi2c[0], 0x08);
+    dev->present = 1;
+    dev->berr_next = 1;
+
+    CHECK(i2c_bus_submit_read(I2C_BUS_1, 0x08 << 1, NULL, 4, record, NULL));
+    run_ms(2);
+    CHECK(last_status == I2C_XFER_OK);
+    CHECK(i2c_bus_get_stats(I2C_BUS_1)->recoveries == 1);
+}
+
+// A dead device on one bus holds nothing up on the others
+static void test_independent_buses(void) {
+    setup();
+    fake_i2c_device(&hi2c[0], 0x08)->hang_next = 1;
+    fake_i2c_device(&hi2c[0], 0x08)->present = 1;
+    fake_i2c_device(&hi2c[1], 0x08)->present = 1;
+    fake_i2c_device(&hi2c[2], 0x08)->present = 1;
+
+    for (uint8_t bus = 0; bus < I2C_BUS_COUNT; bus++) {
+        CHECK(i2c_bus_submit_read(bus, 0x08 << 1, NULL, 8, record, (void*)(uintptr_t)(bus + 1)));
+    }
+    run_ms(1);
+    CHECK(order_count == 2);
+    CHECK(!i2c_bus_is_idle(I2C_BUS_1));
+    CHECK(i2c_bus_is_idle(I2C_BUS_2) && i2c_bus_is_idle(I2C_BUS_3));
+
+    run_ms(I2C_BUS_XFER_TIMEOUT_MS + 10);
+    CHECK(order_count == 3 && order[2] == 1);
+}
+
+int main(void) {
+    test_order_and_data();
+    test_nack_retries();
+    test_queue_full();
+    test_speed_switch();
+    test_timeout_recovery();
+    test_held_bus();
+    test_bus_error();
+    test_independent_buses();
+    return test_result("test_i2c_bus");
+}
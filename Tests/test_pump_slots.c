@@ -0,0 +1,132 @@
+/*
+ * test_pump_slots.c
+ *
+ * node_controller.c pump slots against the circuit breaker, on the
+ * simulated bus: a zone that stops answering in the middle of its run
+ * gives its slot to the zones queued behind it, takes none while it stays
+ * quarantined, and irrigates again once it answers.
+ */
+
+#include "host_test.h"
+#include "fake_hal.h"
+#include "i2c_bus.h"
+#include "node_controller.h"
+#include "plant_profiles.h"
+#include "zone_table.h"
+#include "zone_link.h"
+#include <string.h>
+
+#define LOOP_MS         50          // Superloop period, as in main.c
+#define ZONES           3
+#define PUMP_CAP        2           // actuator_limits[] pump entry
+#define RUN_SEC         120
+
+static I2C_HandleTypeDef hi2c[I2C_BUS_COUNT];
+static const I2cBusPins_t pins = {GPIOB, GPIO_PIN_6, GPIOB, GPIO_PIN_7};
+static const uint8_t addrs[ZONES] = {0x10, 0x11, 0x12};
+static uint32_t last_poll;
+static uint8_t max_pumps;
+
+static Zone_t* zone_at(uint8_t i) {
+    return zone_table_lookup(addrs[i]);
+}
+
+static uint8_t pumps_on(void) {
+    uint8_t on = 0;
+    for (uint8_t i = 0; i < ZONES; i++) on += (zone_at(i)->desired & ACT_PUMP) != 0;
+    return on;
+}
+
+// Main loop of main.c, minus display and UART
+static void run_ms(uint32_t ms) {
+    for (uint32_t t = 0; t < ms; t += LOOP_MS) {
+        fake_run_us(LOOP_MS * 1000);
+        i2c_bus_process();
+        if (HAL_GetTick() - last_poll >= 1500) {
+            node_controller_poll_sensors();
+            last_poll = HAL_GetTick();
+        }
+        node_controller_process();
+        node_controller_update();
+        if (pumps_on() > max_pumps) max_pumps = pumps_on();
+    }
+}
+
+static void setup(void) {
+    PlantProfile_t p;
+
+    fake_reset();
+    memset(hi2c, 0, sizeof(hi2c));
+    for (uint8_t bus = 0; bus < I2C_BUS_COUNT; bus++) {
+        hi2c[bus].Init.ClockSpeed = I2C_BUS_SPEED_FAST_HZ;
+        fake_i2c_attach(&hi2c[bus]);
+        i2c_bus_init(bus, &hi2c[bus], &pins);
+    }
+    fake_i2c_device(&hi2c[0], 0)->present = 1;             // Latch general call
+
+    plant_profiles_init();
+    node_controller_init();
+
+    // Back-to-back runs, no sensor rules: only irrigation drives the pumps
+    memset(&p, 0, sizeof(p));
+    snprintf(p.name, sizeof(p.name), "PUMP TEST");
+    p.irrigation_interval_sec = 1;
+    p.irrigation_duration_sec = RUN_SEC;
+    CHECK(plant_profiles_update(get_num_profiles(), &p));
+
+    // Legacy nodes: no descriptor magic, so no PEC on their frames
+    for (uint8_t i = 0; i < ZONES; i++) {
+        fake_i2c_device(&hi2c[0], addrs[i])->present = 1;
+        CHECK(zone_table_add(I2C_BUS_1, addrs[i]) != ZONE_NONE);
+        node_controller_zone_added(addrs[i]);
+        node_controller_assign_profile(addrs[i], get_num_profiles() - 1);
+    }
+    last_poll = HAL_GetTick();
+    max_pumps = 0;
+}
+
+static void test_quarantined_run_frees_its_slot(void) {
+    uint8_t running[ZONES], n = 0, waiting = ZONES;
+
+    setup();
+
+    // Two runs under the cap, staggered; the third zone waits. Which two
+    // depends on the order the descriptors came back in.
+    run_ms(10000);
+    for (uint8_t i = 0; i < ZONES; i++) {
+        if (zone_at(i)->irrigation_active) {
+            running[n++] = i;
+        } else {
+            waiting = i;
+        }
+    }
+    CHECK(n == PUMP_CAP && waiting < ZONES);
+    if (n != PUMP_CAP || waiting >= ZONES) return;
+    Zone_t* lost = zone_at(running[0]);
+
+    // One runner stops answering well before its run ends: the waiting
+    // zone gets the slot
+    fake_i2c_device(&hi2c[0], lost->addr)->present = 0;
+    run_ms(15000);
+    CHECK(!zone_link_usable(lost));
+    CHECK(!lost->irrigation_active);
+    CHECK(!(lost->desired & ACT_PUMP));
+    CHECK(zone_at(waiting)->irrigation_active);
+
+    // Its starts keep coming due; none takes a slot while it is away
+    for (uint32_t t = 0; t < 2 * RUN_SEC * 1000; t += 1000) {
+        run_ms(1000);
+        CHECK(!lost->irrigation_active);
+    }
+
+    // Answering again, it queues for the next free slot like any zone
+    fake_i2c_device(&hi2c[0], lost->addr)->present = 1;
+    for (uint32_t t = 0; t < 3 * RUN_SEC * 1000 && !lost->irrigation_active; t += 1000) run_ms(1000);
+    CHECK(lost->irrigation_active);
+    CHECK(max_pumps <= PUMP_CAP);
+}
+
+int main(void) {
+    test_quarantined_run_frees_its_slot();
+    return test_result("test_pump_slots");
+}
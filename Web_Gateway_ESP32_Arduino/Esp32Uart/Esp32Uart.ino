@@ -29,10 +29,12 @@ struct NodeData {
   unsigned long lastIrrigationStart;
   unsigned long irrigationDuration;
   int irrigationCount24h;
+  long ageMs;                  // Master-side data age when the line arrived, -1 = never sampled
+  unsigned long receivedAt;    // millis() of that line
 };
 
-NodeData node1 = { 0, 0, 0, "None", false, false, false, false, false, 0, 0, 0 };
-NodeData node2 = { 0, 0, 0, "None", false, false, false, false, false, 0, 0, 0 };
+NodeData node1 = { 0, 0, 0, "None", false, false, false, false, false, 0, 0, 0, -1, 0 };
+NodeData node2 = { 0, 0, 0, "None", false, false, false, false, false, 0, 0, 0, -1, 0 };
 unsigned long lastUpdate = 0;
 
 // Sensor history (last 60 readings ~2min at 2s intervals)
@@ -126,7 +128,8 @@ void loop() {
     incoming.trim();
 
     if (incoming.length() > 10 && incoming.startsWith("{")) {
-      StaticJsonDocument<512> doc;
+      // Every STM32 line fits (budget next to format_zone() in uart_comm.c)
+      StaticJsonDocument<1024> doc;
       DeserializationError error = deserializeJson(doc, incoming);
 
       if (!error) {
@@ -141,6 +144,8 @@ void loop() {
           node1.profile = doc["node1"]["profile"].as<String>();
           node1.irrigation = doc["node1"]["irrigation"];
           node1.valid = true;
+          node1.ageMs = doc["node1"]["age"] | -1L;
+          node1.receivedAt = millis();
 
           // Actuator states
           node1.humid_active = doc["node1"]["humid"];  
@@ -168,6 +173,8 @@ void loop() {
           node2.profile = doc["node2"]["profile"].as<String>();
           node2.irrigation = doc["node2"]["irrigation"];
           node2.valid = true;
+          node2.ageMs = doc["node2"]["age"] | -1L;
+          node2.receivedAt = millis();
 
           node2.fan_active = (node2.temp > 250);
           node2.light1_active = (node2.light < 400);
@@ -222,6 +229,12 @@ void loop() {
   }
 }
 
+// Age of a node's readings now: the master's age plus time since the line arrived
+long dataAge(const NodeData& node) {
+  if (node.ageMs < 0) return -1;
+  return node.ageMs + (long)(millis() - node.receivedAt);
+}
+
 void sendJsonData(WiFiClient& client) {
   client.println("HTTP/1.1 200 OK");
   client.println("Content-type: application/json");
@@ -240,6 +253,7 @@ void sendJsonData(WiFiClient& client) {
   doc["node1"]["light1"] = node1.light1_active;
   doc["node1"]["humid"] = node1.humid_active;
   doc["node1"]["count24h"] = node1.irrigationCount24h;
+  doc["node1"]["age_ms"] = dataAge(node1);
   if (node1.irrigation) {
     doc["node1"]["irrigating_for"] = (millis() - node1.lastIrrigationStart) / 1000;
   }
@@ -254,6 +268,7 @@ void sendJsonData(WiFiClient& client) {
   doc["node2"]["light1"] = node2.light1_active;
   doc["node2"]["humid"] = node2.humid_active;
   doc["node2"]["count24h"] = node2.irrigationCount24h;
+  doc["node2"]["age_ms"] = dataAge(node2);
   if (node2.irrigation) {
     doc["node2"]["irrigating_for"] = (millis() - node2.lastIrrigationStart) / 1000;
   }